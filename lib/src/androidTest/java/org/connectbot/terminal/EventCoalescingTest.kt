@@ -0,0 +1,63 @@
+package org.connectbot.terminal
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Property changes and bells in one write reach Java once, with the final
+ * value of each property and the number of bells rung.
+ */
+@RunWith(AndroidJUnit4::class)
+class EventCoalescingTest {
+    // VTERM_PROP_TITLE
+    private val propTitle = 4
+
+    private val callbacks = RecordingCallbacks()
+
+    private fun titles() = callbacks.properties
+        .filter { it.first == propTitle }
+        .map { (it.second as TerminalProperty.StringValue).value }
+
+    /** Runs [block] on a fresh terminal, ignoring what its setup reported. */
+    private fun withTerminal(block: (TerminalNative) -> Unit) {
+        TerminalNative(callbacks, rows = 24, cols = 80).use { native ->
+            callbacks.properties.clear()
+            callbacks.bells.clear()
+            block(native)
+        }
+    }
+
+    @Test
+    fun testTitlesAndBellsInOneWrite() = withTerminal { native ->
+        val input = buildString {
+            for (i in 1..500) {
+                append("\u001B]2;progress $i%\u0007")
+                append("\u0007")
+            }
+        }
+        native.writeInput(input.toByteArray())
+
+        assertEquals(listOf("progress 500%"), titles())
+        assertEquals(listOf(500), callbacks.bells)
+    }
+
+    @Test
+    fun testQuietWriteReportsNothing() = withTerminal { native ->
+        native.writeInput("\u001B]2;first\u0007\u0007".toByteArray())
+        native.writeInput("plain text".toByteArray())
+
+        assertEquals(listOf("first"), titles())
+        assertEquals(listOf(1), callbacks.bells)
+    }
+
+    @Test
+    fun testTitleSplitAcrossWrites() = withTerminal { native ->
+        native.writeInput("\u001B]2;split ".toByteArray())
+        assertEquals(emptyList<String>(), titles())
+
+        native.writeInput("title\u001B\\".toByteArray())
+        assertEquals(listOf("split title"), titles())
+    }
+}
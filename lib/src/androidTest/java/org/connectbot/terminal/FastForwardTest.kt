@@ -0,0 +1,46 @@
+package org.connectbot.terminal
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * A dump far longer than the scrollback keeps leaves the same screen and
+ * history when the lines that would be evicted are skipped.
+ */
+@RunWith(AndroidJUnit4::class)
+class FastForwardTest {
+    private val lines = listOf("\u001B]0;dump\u0007\u001B[42mstart\r\n") + plainDumpLines(40_000) + "\u001B[0mend"
+
+    @Test
+    fun testMatchesLineByLineWrites() {
+        val lineByLine = createEmulator(rows = 24, cols = 80)
+        lineByLine.writeEach(lines)
+
+        val whole = createEmulator(rows = 24, cols = 80)
+        whole.write(lines.joinToString(""))
+
+        assertEquals(lineByLine.dumpCells(), whole.dumpCells())
+        assertEquals(lineByLine.snapshot.value.cursorRow, whole.snapshot.value.cursorRow)
+        assertEquals(lineByLine.snapshot.value.cursorCol, whole.snapshot.value.cursorCol)
+    }
+
+    @Test
+    fun testCountsSkippedRowsForRunningCommand() {
+        // OSC 133;C starts the command whose cost counts the scrolled rows
+        val command = listOf("\u001B]133;C\u0007") + lines
+
+        val lineByLine = createEmulator(rows = 24, cols = 80)
+        lineByLine.writeEach(command)
+
+        val whole = createEmulator(rows = 24, cols = 80)
+        whole.write(command.joinToString(""))
+
+        assertEquals(lineByLine.dumpCells(), whole.dumpCells())
+        assertEquals(
+            lineByLine.recentCommandCosts().single().scrolledLines,
+            whole.recentCommandCosts().single().scrolledLines,
+        )
+    }
+}
@@ -0,0 +1,58 @@
+package org.connectbot.terminal
+
+import androidx.compose.ui.graphics.Color
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Rows read from the shared grid mirror match what the terminal holds,
+ * including styles, wide characters and a screen that outgrew its mapping.
+ */
+@RunWith(AndroidJUnit4::class)
+class GridMirrorTest {
+    @Test
+    fun testStylesAndWideCharacters() {
+        val emulator = createEmulator(rows = 4, cols = 20)
+        emulator.write("\u001B[1;38;2;255;0;0mR\u001B[0m\u4E2Dx\u0301")
+
+        val cells = emulator.snapshot.value.lines[0].cells
+        assertEquals(20, cells.sumOf { it.width })
+        assertEquals('R', cells[0].char)
+        assertTrue(cells[0].bold)
+        assertEquals(Color(255, 0, 0), cells[0].fgColor)
+        assertEquals('\u4E2D', cells[1].char)
+        assertEquals(2, cells[1].width)
+        assertEquals('x', cells[2].char)
+        assertEquals(listOf('\u0301'), cells[2].combiningChars)
+    }
+
+    @Test
+    fun testDamageNextToWideCharacter() {
+        val emulator = createEmulator(rows = 4, cols = 20)
+        emulator.write("\u4E2Dab")
+        emulator.write("\u001B[1;3HZ")
+
+        val cells = emulator.snapshot.value.lines[0].cells
+        assertEquals(20, cells.sumOf { it.width })
+        assertEquals('\u4E2D', cells[0].char)
+        assertEquals('Z', cells[1].char)
+        assertEquals('b', cells[2].char)
+    }
+
+    @Test
+    fun testResizePastMapping() {
+        val emulator = createEmulator(rows = 4, cols = 20)
+        emulator.write("small")
+
+        emulator.resize(50, 300)
+        emulator.processPendingUpdates()
+        emulator.write("\u001B[50;300HE")
+
+        val snapshot = emulator.snapshot.value
+        assertEquals(300, snapshot.lines[49].cells.size)
+        assertEquals('E', snapshot.lines[49].cells[299].char)
+    }
+}
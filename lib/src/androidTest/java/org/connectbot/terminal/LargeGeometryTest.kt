@@ -0,0 +1,89 @@
+package org.connectbot.terminal
+
+import android.util.Log
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Export at desktop-sized geometries: runs have no length cap, and a frame's
+ * cost follows the damaged area rather than the terminal width.
+ */
+@RunWith(AndroidJUnit4::class)
+class LargeGeometryTest {
+    @Test
+    fun testFullWidthRunWithCombiningAndSurrogates() {
+        val emulator = createEmulator(rows = 4, cols = 1000)
+
+        // One style across the whole row: a single run far longer than 256 chars,
+        // with more UTF-16 units than columns
+        val unit = "e\u0301\uD83D\uDE00x"  // e + combining acute, wide emoji, x
+        emulator.write(unit.repeat(250))
+
+        val line = emulator.snapshot.value.lines[0]
+        assertEquals(1000, line.cells.sumOf { it.width })
+        assertEquals(750, line.cells.size)
+        assertEquals('e', line.cells[0].char)
+        assertEquals(listOf('\u0301'), line.cells[0].combiningChars)
+        assertEquals('x', line.cells[749].char)
+    }
+
+    @Test
+    fun testPartialDamageKeepsRestOfLine() {
+        val emulator = createEmulator(rows = 4, cols = 1000)
+        emulator.write("a".repeat(1000))
+        emulator.write("\u001B[1;500HZ")
+
+        val line = emulator.snapshot.value.lines[0]
+        assertEquals(1000, line.cells.size)
+        assertEquals('Z', line.cells[499].char)
+        assertEquals('a', line.cells[498].char)
+        assertEquals('a', line.cells[500].char)
+    }
+
+    /**
+     * Median time to apply a one-cell change, after filling every row.
+     */
+    private fun medianSmallUpdateNanos(rows: Int, cols: Int): Long {
+        val emulator = createEmulator(rows, cols)
+        val fill = buildString {
+            for (row in 1..rows) {
+                append("\u001B[$row;1H")
+                append("\u001B[3${row % 8}m")
+                append("x".repeat(cols))
+            }
+        }
+        emulator.write(fill)
+
+        val samples = LongArray(FRAMES)
+        for (i in 0 until WARMUP + FRAMES) {
+            val row = 1 + i % rows
+            val col = 1 + (i * 7) % cols
+            val start = System.nanoTime()
+            emulator.write("\u001B[$row;${col}H${'a' + i % 26}")
+            if (i >= WARMUP) {
+                samples[i - WARMUP] = System.nanoTime() - start
+            }
+        }
+        samples.sort()
+        return samples[FRAMES / 2]
+    }
+
+    @Test
+    fun testSmallUpdateCostDoesNotScaleWithWidth() {
+        val narrow = medianSmallUpdateNanos(rows = 300, cols = 80)
+        val wide = medianSmallUpdateNanos(rows = 300, cols = 1000)
+        Log.i(TAG, "one-cell update at 300x80: ${narrow / 1000}us, at 300x1000: ${wide / 1000}us")
+
+        // The width grows 12.5 times; a per-frame cost proportional to it would too
+        assertTrue("300x1000 took ${wide}ns vs ${narrow}ns at 300x80", wide < narrow * 4)
+    }
+
+    companion object {
+        private const val TAG = "LargeGeometryTest"
+        private const val WARMUP = 50
+        private const val FRAMES = 300
+    }
+}
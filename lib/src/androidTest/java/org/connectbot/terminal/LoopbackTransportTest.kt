@@ -0,0 +1,92 @@
+package org.connectbot.terminal
+
+import android.os.ParcelFileDescriptor
+import android.system.Os
+import android.system.OsConstants
+import android.system.StructPollfd
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+import java.io.ByteArrayOutputStream
+import java.io.FileDescriptor
+
+/**
+ * Input written to a loopback transport is parsed natively, and replies and
+ * keys come back out of it, including output queued while the peer was not
+ * reading.
+ */
+@RunWith(AndroidJUnit4::class)
+class LoopbackTransportTest {
+    private fun writeAll(fd: FileDescriptor, data: ByteArray) {
+        var offset = 0
+        while (offset < data.size) {
+            offset += Os.write(fd, data, offset, data.size - offset)
+        }
+    }
+
+    // Reads until `length` bytes arrived; fails if the transport goes quiet
+    private fun readExactly(fd: FileDescriptor, length: Int): ByteArray {
+        val out = ByteArrayOutputStream(length)
+        val buffer = ByteArray(64 * 1024)
+        val poll = StructPollfd().apply {
+            this.fd = fd
+            events = OsConstants.POLLIN.toShort()
+        }
+        while (out.size() < length) {
+            assertTrue("Timed out after ${out.size()} of $length bytes", Os.poll(arrayOf(poll), 5000) > 0)
+            val n = Os.read(fd, buffer, 0, minOf(buffer.size, length - out.size()))
+            assertTrue(n > 0)
+            out.write(buffer, 0, n)
+        }
+        return out.toByteArray()
+    }
+
+    @Test
+    fun testRoundTrip() {
+        val callbacks = RecordingCallbacks()
+        TerminalNative(callbacks, rows = 24, cols = 80).use { native ->
+            val peerFd = native.bindLoopback()
+            assertTrue(peerFd >= 0)
+            ParcelFileDescriptor.adoptFd(peerFd).use { peer ->
+                val fd = peer.fileDescriptor
+
+                // A cursor position report shows the text before it was parsed
+                writeAll(fd, "hello\r\n\u001B[6n".toByteArray())
+                assertEquals("\u001B[2;1R", String(readExactly(fd, 6)))
+
+                assertTrue(native.dispatchCharacter(0, 'x'.code))
+                assertTrue(native.dispatchKey(0, VTermKey.ENTER))
+                assertEquals("x\r", String(readExactly(fd, 2)))
+            }
+        }
+        assertEquals(0, callbacks.keyboardInputs)
+    }
+
+    @Test
+    fun testBacklogDrains() {
+        // Replies far past what the socket buffers hold while nobody reads them
+        val requests = 250_000
+        val reply = "\u001B[0n".toByteArray()
+
+        TerminalNative(RecordingCallbacks(), rows = 24, cols = 80).use { native ->
+            val peerFd = native.bindLoopback()
+            assertTrue(peerFd >= 0)
+            ParcelFileDescriptor.adoptFd(peerFd).use { peer ->
+                val fd = peer.fileDescriptor
+                writeAll(fd, "\u001B[5n".repeat(requests).toByteArray())
+                writeAll(fd, "\u001B[6n".toByteArray())
+
+                // Every queued reply arrives whole and in order, then the last one
+                val output = readExactly(fd, requests * reply.size + 6)
+                for (i in 0 until requests) {
+                    for (j in reply.indices) {
+                        assertEquals(reply[j], output[i * reply.size + j])
+                    }
+                }
+                assertEquals("\u001B[1;1R", String(output, requests * reply.size, 6))
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+package org.connectbot.terminal
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * The output text stream read for screen reader announcements: finished
+ * lines once each, the current line up to the cursor, and nothing from
+ * prompts, typed input or the alternate screen.
+ */
+@RunWith(AndroidJUnit4::class)
+class OutputTextTest {
+    private val emulator =
+        TerminalEmulatorFactory.create(initialRows = 5, initialCols = 20) as TerminalEmulatorImpl
+    private val cursor = longArrayOf(-1)
+
+    private fun write(text: String) {
+        emulator.writeInput(text.toByteArray())
+        emulator.processPendingUpdates()
+    }
+
+    private fun read(): String = emulator.readNewOutput(cursor)
+
+    @Test
+    fun testLinesOnce() {
+        write("before\r\n")
+        assertEquals("", read())
+
+        write("hello ")
+        assertEquals("hello", read())
+        write("world\r\nline2\r\n")
+        assertEquals(" world\nline2\n", read())
+        assertEquals("", read())
+    }
+
+    @Test
+    fun testProgressRewritesLine() {
+        read()
+        write("50%\r60%\r70%\r\n")
+        assertEquals("70%\n", read())
+    }
+
+    @Test
+    fun testSoftWrapIsOneLine() {
+        read()
+        write("0123456789012345678901234\r\n")
+        assertEquals("0123456789012345678901234\n", read())
+    }
+
+    @Test
+    fun testPromptsAndInputSkipped() {
+        read()
+        write("\u001B]133;A\u0007$ \u001B]133;B\u0007ls -l\r\n\u001B]133;C\u0007out1\r\nout2\r\n")
+        write("\u001B]133;D;0\u0007\u001B]133;A\u0007$ ")
+        assertEquals("out1\nout2\n", read())
+
+        write("typed")
+        assertEquals("", read())
+
+        write("\r\n\u001B]133;C\u0007result\r\n")
+        assertEquals("result\n", read())
+    }
+
+    @Test
+    fun testMultiScreenDumpInOneWrite() {
+        read()
+        val rows = (0 until 30).map { "row$it" }
+        write(rows.joinToString("") { "$it\r\n" })
+        assertEquals(rows.joinToString("") { "$it\n" }, read())
+    }
+
+    @Test
+    fun testAltScreenSkipped() {
+        read()
+        write("\u001B[?1049hfullscreen junk\u001B[5;1Hmore\u001B[?1049l")
+        assertEquals("", read())
+
+        write("after alt\r\n")
+        assertEquals("after alt\n", read())
+    }
+
+    @Test
+    fun testClear() {
+        read()
+        write("old\r\n")
+        write("\u001B[2J\u001B[3J\u001B[Hcleared\r\n")
+        assertEquals("old\ncleared\n", read())
+    }
+}
@@ -0,0 +1,27 @@
+package org.connectbot.terminal
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Plain text laid out on worker threads leaves the same screen and
+ * scrollback as parsing it in order.
+ */
+@RunWith(AndroidJUnit4::class)
+class ParallelParsingTest {
+    @Test
+    fun testMatchesSequentialParsing() {
+        val lines = listOf("\u001B[44mstart\r\n") + plainDumpLines(6_000) + "\u001B[0mend"
+
+        val sequential = createEmulator(rows = 24, cols = 80)
+        sequential.writeEach(lines)
+
+        val parallel = createEmulator(rows = 24, cols = 80)
+        parallel.setParallelParsing(4)
+        parallel.write(lines.joinToString(""))
+
+        assertEquals(sequential.dumpCells(), parallel.dumpCells())
+    }
+}
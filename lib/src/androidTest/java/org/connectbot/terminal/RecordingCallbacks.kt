@@ -0,0 +1,38 @@
+package org.connectbot.terminal
+
+/**
+ * Callbacks for tests that drive [TerminalNative] directly, recording the
+ * upcalls that tests check and ignoring the rest.
+ */
+internal class RecordingCallbacks : TerminalCallbacks {
+    val properties = mutableListOf<Pair<Int, TerminalProperty>>()
+    val bells = mutableListOf<Int>()
+
+    @Volatile var keyboardInputs = 0
+
+    override fun damage(startRow: Int, endRow: Int, startCol: Int, endCol: Int) = 0
+    override fun moverect(dest: TermRect, src: TermRect) = 0
+    override fun moveCursor(pos: CursorPosition, oldPos: CursorPosition, visible: Boolean) = 0
+
+    override fun setTermProp(prop: Int, value: TerminalProperty): Int {
+        properties.add(prop to value)
+        return 0
+    }
+
+    override fun bell(count: Int): Int {
+        bells.add(count)
+        return 0
+    }
+
+    override fun pushScrollbackLine(cols: Int, cells: Array<ScreenCell>, continuation: Boolean) = 0
+    override fun popScrollbackLine(cols: Int, cells: Array<ScreenCell>) = 0
+    override fun clearScrollback() = 0
+
+    override fun onKeyboardInput(data: ByteArray): Int {
+        keyboardInputs++
+        return 0
+    }
+
+    override fun onOscSequence(command: Int, payload: String) = 0
+    override fun onTransportClosed(exitCode: Int) = 0
+}
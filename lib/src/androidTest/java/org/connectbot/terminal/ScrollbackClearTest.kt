@@ -0,0 +1,46 @@
+package org.connectbot.terminal
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * CSI 3 J drops the scrollback as it stood when the sequence was parsed.
+ * Lines scrolled off later in the same write are kept.
+ */
+@RunWith(AndroidJUnit4::class)
+class ScrollbackClearTest {
+    private fun scrollbackAfterClear(linesBeforeClear: Int): List<String> {
+        val emulator = TerminalEmulatorFactory.create(initialRows = 24, initialCols = 80) as TerminalEmulatorImpl
+        emulator.writeInput((0 until 50).joinToString("") { "old $it\r\n" }.toByteArray())
+
+        val input = buildString {
+            repeat(linesBeforeClear) { append("a $it\r\n") }
+            append("\u001B[3J")
+            repeat(30) { append("new $it\r\n") }
+        }
+        emulator.writeInput(input.toByteArray())
+        emulator.processPendingUpdates()
+
+        return emulator.snapshot.value.scrollback.map { it.text.trimEnd() }
+    }
+
+    // The 23 rows above the cursor when the clear ran scroll off after it,
+    // followed by the first new lines
+    private fun expected(linesBeforeClear: Int): List<String> {
+        val written = (0 until 50).map { "old $it" } + (0 until linesBeforeClear).map { "a $it" }
+        return written.takeLast(23) + (0 until 7).map { "new $it" }
+    }
+
+    @Test
+    fun testLinesPushedAfterClearKept() {
+        assertEquals(expected(10), scrollbackAfterClear(10))
+    }
+
+    @Test
+    fun testLinesPushedAfterClearKeptInLongWrite() {
+        // Long enough for the write to skip lines the scrollback would evict
+        assertEquals(expected(20_000), scrollbackAfterClear(20_000))
+    }
+}
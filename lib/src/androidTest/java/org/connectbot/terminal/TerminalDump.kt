@@ -0,0 +1,40 @@
+package org.connectbot.terminal
+
+internal fun createEmulator(rows: Int, cols: Int): TerminalEmulatorImpl =
+    TerminalEmulatorFactory.create(initialRows = rows, initialCols = cols) as TerminalEmulatorImpl
+
+internal fun TerminalEmulatorImpl.write(text: String) {
+    writeInput(text.toByteArray())
+    processPendingUpdates()
+}
+
+/** Writes each piece on its own, short enough for the parser to see all of it. */
+internal fun TerminalEmulatorImpl.writeEach(pieces: List<String>) {
+    pieces.forEach { writeInput(it.toByteArray()) }
+    processPendingUpdates()
+}
+
+private val dumpPieces = listOf("word ", "\u4E2D", "\u00E9", "\uD83D\uDE00", "x")
+
+/**
+ * Numbered plain lines ending in CRLF, of lengths from 0 to 52 pieces of
+ * ASCII, wide, accented and surrogate-pair text.
+ */
+internal fun plainDumpLines(count: Int): List<String> = List(count) { line ->
+    buildString {
+        append(line)
+        repeat(line % 53) { append(dumpPieces[(line + it) % dumpPieces.size]) }
+        append("\r\n")
+    }
+}
+
+/**
+ * Scrollback and screen as one string per row, each cell written as its
+ * text, width and background, for comparing two terminals cell by cell.
+ */
+internal fun TerminalEmulatorImpl.dumpCells(): List<String> {
+    val current = snapshot.value
+    return (current.scrollback + current.lines).map { line ->
+        line.cells.joinToString("") { "${it.char}${it.combiningChars.joinToString("")}/${it.width}/${it.bgColor}" }
+    }
+}
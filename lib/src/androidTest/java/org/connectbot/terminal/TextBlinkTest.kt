@@ -0,0 +1,45 @@
+package org.connectbot.terminal
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertFalse
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * The blink tick flips the phase that blinking text is drawn with, and
+ * reports when there is nothing left to blink.
+ */
+@RunWith(AndroidJUnit4::class)
+class TextBlinkTest {
+    @Test
+    fun testTickFlipsPhase() {
+        val emulator = createEmulator(rows = 4, cols = 20)
+        emulator.write("plain \u001B[5mblink\u001B[25m\r\n\u001B[5mmore")
+
+        assertEquals(2, emulator.blinkTick())
+        emulator.processPendingUpdates()
+        assertFalse(emulator.snapshot.value.textBlinkVisible)
+        assertTrue(emulator.snapshot.value.lines[0].cells[6].blink)
+
+        assertEquals(2, emulator.blinkTick())
+        emulator.processPendingUpdates()
+        assertTrue(emulator.snapshot.value.textBlinkVisible)
+    }
+
+    @Test
+    fun testNoBlinkingText() {
+        val emulator = createEmulator(rows = 4, cols = 20)
+        emulator.write("\u001B[5mblink\u001B[25m")
+        emulator.blinkTick()
+        emulator.processPendingUpdates()
+        assertFalse(emulator.snapshot.value.textBlinkVisible)
+
+        // Erasing the blinking text leaves it shown for the next time
+        emulator.write("\u001B[2J")
+        assertEquals(0, emulator.blinkTick())
+        emulator.write("x")
+        assertTrue(emulator.snapshot.value.textBlinkVisible)
+    }
+}
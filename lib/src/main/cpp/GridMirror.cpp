@@ -0,0 +1,249 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "GridMirror.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <new>
+
+static_assert(sizeof(GridMirror::Cell) == GridMirror::CELL_BYTES, "cell layout is shared with Java");
+static_assert(sizeof(GridMirror::Style) == GridMirror::STYLE_BYTES, "style layout is shared with Java");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the sequence word is read from Java's mapping");
+
+// Style IDs are 16 bits; a full screen of distinct styles fits below that
+static constexpr int MAX_STYLES = 1 << 16;
+static constexpr int MIN_STYLES = 256;
+
+GridMirror::GridMirror(int rows, int cols) {
+    resize(rows, cols);
+}
+
+size_t GridMirror::StyleHash::operator()(const Style& style) const {
+    uint64_t colors = (static_cast<uint64_t>(static_cast<uint32_t>(style.fgRgb)) << 32) |
+                      static_cast<uint32_t>(style.bgRgb);
+    uint64_t rest = (static_cast<uint64_t>(static_cast<uint16_t>(style.fgIndex)) << 48) |
+                    (static_cast<uint64_t>(static_cast<uint16_t>(style.bgIndex)) << 32) |
+                    static_cast<uint32_t>(style.attrs);
+    return std::hash<uint64_t>()(colors ^ (rest * 0x9E3779B97F4A7C15ULL));
+}
+
+void GridMirror::resize(int rows, int cols) {
+    mRows = std::max(rows, 1);
+    mCols = std::max(cols, 1);
+    mDirtyStart.assign(mRows, 0);
+    mDirtyEnd.assign(mRows, 0);
+    markAllDirty();
+}
+
+void GridMirror::markDirty(int startRow, int endRow, int startCol, int endCol) {
+    startRow = std::max(startRow, 0);
+    endRow = std::min(endRow, mRows);
+    startCol = std::max(startCol, 0);
+    endCol = std::min(endCol, mCols);
+    if (startRow >= endRow || startCol >= endCol) {
+        return;
+    }
+
+    for (int row = startRow; row < endRow; row++) {
+        if (mDirtyStart[row] < mDirtyEnd[row]) {
+            mDirtyStart[row] = std::min(mDirtyStart[row], startCol);
+            mDirtyEnd[row] = std::max(mDirtyEnd[row], endCol);
+        } else {
+            mDirtyStart[row] = startCol;
+            mDirtyEnd[row] = endCol;
+        }
+    }
+    mDirty = true;
+}
+
+void GridMirror::markAllDirty() {
+    markDirty(0, mRows, 0, mCols);
+}
+
+std::vector<GridMirror::Damage> GridMirror::takeDamage() {
+    std::vector<Damage> damage;
+
+    for (int row = 0; row < mRows; row++) {
+        int start = mDirtyStart[row];
+        int end = mDirtyEnd[row];
+        if (start >= end) {
+            continue;
+        }
+
+        if (!damage.empty() && damage.back().endRow == row &&
+                damage.back().startCol == start && damage.back().endCol == end) {
+            damage.back().endRow = row + 1;
+        } else {
+            damage.push_back({row, row + 1, start, end});
+        }
+        mDirtyStart[row] = 0;
+        mDirtyEnd[row] = 0;
+    }
+
+    mDirty = false;
+    return damage;
+}
+
+// Called as a frame starts, so the retired block keeps the last whole frame
+bool GridMirror::ensureCapacity() {
+    if (mBlock && mRows <= mBlock->rowCapacity && mCols <= mBlock->colCapacity) {
+        return true;
+    }
+
+    // Grow by half again, so a window dragged wider retires few blocks
+    auto block = std::make_unique<Block>();
+    block->rowCapacity = mRows;
+    block->colCapacity = mCols;
+    if (mBlock) {
+        block->rowCapacity = std::max(mRows, mBlock->rowCapacity * 3 / 2);
+        block->colCapacity = std::max(mCols, mBlock->colCapacity * 3 / 2);
+    }
+    int64_t cells = static_cast<int64_t>(block->rowCapacity) * block->colCapacity;
+    block->styleCapacity = static_cast<int>(std::clamp<int64_t>(cells, MIN_STYLES, MAX_STYLES));
+
+    block->stylesOffset = HEADER_BYTES;
+    block->rowsOffset = block->stylesOffset + block->styleCapacity * STYLE_BYTES;
+    block->textOffset = (block->colCapacity * CELL_BYTES + 7) & ~7;
+    block->rowStride = (block->textOffset + block->colCapacity * TEXT_UNITS_PER_CELL * sizeof(uint16_t) + 7) & ~7;
+    block->size = block->rowsOffset + block->rowCapacity * block->rowStride;
+
+    // Java addresses the mapping with int offsets
+    if (block->size > INT32_MAX) {
+        return false;
+    }
+    block->memory.reset(new (std::nothrow) uint8_t[block->size]());
+    if (!block->memory) {
+        return false;
+    }
+
+    int32_t* header = block->header();
+    header[GRID_ROW_STRIDE] = static_cast<int32_t>(block->rowStride);
+    header[GRID_ROWS_OFFSET] = static_cast<int32_t>(block->rowsOffset);
+    header[GRID_TEXT_OFFSET] = static_cast<int32_t>(block->textOffset);
+    header[GRID_STYLES_OFFSET] = static_cast<int32_t>(block->stylesOffset);
+
+    // The sequence carries on, already odd for the frame being started, so
+    // neither block validates for a reader caught across the switch
+    if (mBlock) {
+        block->sequence()->store(mBlock->sequence()->load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+        mBlock->header()[GRID_RETIRED] = 1;
+        mRetired.push_back(std::move(mBlock));
+    }
+    mBlock = std::move(block);
+    mCurrent.store(mBlock.get(), std::memory_order_release);
+
+    // Nothing in the new block is valid yet
+    mStyleIds.clear();
+    mStyleCount = 0;
+    markAllDirty();
+    return true;
+}
+
+bool GridMirror::beginFrame() {
+    if (!ensureCapacity()) {
+        return false;
+    }
+
+    std::atomic<uint64_t>* sequence = mBlock->sequence();
+    uint64_t value = sequence->load(std::memory_order_relaxed);
+    if ((value & 1) == 0) {
+        sequence->store(value + 1, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int32_t* header = mBlock->header();
+    header[GRID_ROWS] = mRows;
+    header[GRID_COLS] = mCols;
+    return true;
+}
+
+void GridMirror::endFrame() {
+    mBlock->header()[GRID_STYLE_COUNT] = mStyleCount;
+
+    std::atomic<uint64_t>* sequence = mBlock->sequence();
+    sequence->store(sequence->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+int GridMirror::internStyle(const Style& style) {
+    auto it = mStyleIds.find(style);
+    if (it != mStyleIds.end()) {
+        return it->second;
+    }
+
+    int id = mStyleCount;
+    if (id >= mBlock->styleCapacity) {
+        return -1;
+    }
+
+    std::memcpy(mBlock->memory.get() + mBlock->stylesOffset + id * STYLE_BYTES, &style, STYLE_BYTES);
+    mStyleIds.emplace(style, static_cast<uint16_t>(id));
+    mStyleCount++;
+    return id;
+}
+
+void GridMirror::resetStyles() {
+    mStyleIds.clear();
+    mStyleCount = 0;
+    markAllDirty();
+}
+
+void GridMirror::recolorStyles(const std::function<void(Style&)>& recolor) {
+    std::unordered_map<Style, uint16_t, StyleHash> styleIds;
+    styleIds.reserve(mStyleIds.size());
+    for (const auto& entry : mStyleIds) {
+        Style recolored = entry.first;
+        recolor(recolored);
+        std::memcpy(mBlock->memory.get() + mBlock->stylesOffset + entry.second * STYLE_BYTES, &recolored,
+                    STYLE_BYTES);
+        styleIds.emplace(recolored, entry.second);
+    }
+    mStyleIds = std::move(styleIds);
+}
+
+void GridMirror::writeCells(int row, int startCol, int count, const Cell* cells, const uint16_t* text) {
+    if (row < 0 || row >= mRows || startCol < 0 || count <= 0 || startCol + count > mCols) {
+        return;
+    }
+
+    uint8_t* base = mBlock->memory.get() + mBlock->rowsOffset + row * mBlock->rowStride;
+    std::memcpy(base + startCol * CELL_BYTES, cells, count * CELL_BYTES);
+    std::memcpy(base + mBlock->textOffset + startCol * TEXT_UNITS_PER_CELL * sizeof(uint16_t), text,
+                count * TEXT_UNITS_PER_CELL * sizeof(uint16_t));
+}
+
+uint8_t* GridMirror::data() const {
+    return mBlock ? mBlock->memory.get() : nullptr;
+}
+
+size_t GridMirror::size() const {
+    return mBlock ? mBlock->size : 0;
+}
+
+uint64_t GridMirror::readBegin() const {
+    Block* block = mCurrent.load(std::memory_order_acquire);
+    if (!block) {
+        return 1;
+    }
+    return block->sequence()->load(std::memory_order_acquire);
+}
+
+bool GridMirror::readValidate(uint64_t sequence) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    Block* block = mCurrent.load(std::memory_order_relaxed);
+    return block && block->sequence()->load(std::memory_order_relaxed) == sequence;
+}
@@ -0,0 +1,189 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TERMSCREEN_GRIDMIRROR_H
+#define TERMSCREEN_GRIDMIRROR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Render-ready copy of the visible grid, kept in one block of memory that
+ * Java maps once as a direct ByteBuffer and reads without JNI calls.
+ *
+ * Frames are published under a seqlock: the sequence word is odd while rows
+ * are rewritten and advances by two per frame, so a reader that sees the
+ * same even value before and after copying rows got one consistent frame.
+ *
+ * A block is never freed while the mirror lives. Growing past its capacity
+ * moves to a larger block and marks the old one retired, so a reader still
+ * holding it reads stale but valid memory until it asks for the new one.
+ *
+ * Layout, in native byte order (must match GridMirror.kt):
+ *   header  HEADER_BYTES of 32-bit words, indexed by HeaderField
+ *   styles  style table, STYLE_BYTES per entry: int32 fg 0xRRGGBB,
+ *           int32 bg, int16 fg palette slot, int16 bg slot, int32 attrs
+ *   rows    row stride apart: one CELL_BYTES cell per column (uint16
+ *           style, uint8 width, uint8 UTF-16 length), then from the text
+ *           offset a slot of TEXT_UNITS_PER_CELL UTF-16 units per column
+ *
+ * Every column has its own text slot, so damaged cells are rewritten in
+ * place without touching the rest of the row. Wide characters take width
+ * 2, and the column they cover has width 0 and no text. Attrs hold
+ * Terminal::CellRunFlags in bits 0-7, the underline style in bits 8-11,
+ * double height in bits 12-15 and the font from bit 16.
+ */
+class GridMirror {
+public:
+    enum HeaderField {
+        GRID_SEQUENCE = 0,      // 64 bits, words 0 and 1
+        GRID_ROWS = 2,
+        GRID_COLS,
+        GRID_ROW_STRIDE,        // bytes
+        GRID_ROWS_OFFSET,       // bytes from the start of the block
+        GRID_TEXT_OFFSET,       // bytes from the start of a row to its text slots
+        GRID_STYLES_OFFSET,
+        GRID_STYLE_COUNT,
+        GRID_RETIRED,           // 1 once a larger block has replaced this one
+    };
+    static constexpr size_t HEADER_BYTES = 16 * sizeof(int32_t);
+    static constexpr size_t STYLE_BYTES = 16;
+    static constexpr size_t CELL_BYTES = 4;
+    static constexpr int TEXT_UNITS_PER_CELL = 12;  // 6 code points, each maybe a surrogate pair
+
+    struct Style {
+        int32_t fgRgb;
+        int32_t bgRgb;
+        int16_t fgIndex;
+        int16_t bgIndex;
+        int32_t attrs;
+
+        bool operator==(const Style& other) const {
+            return fgRgb == other.fgRgb && bgRgb == other.bgRgb && fgIndex == other.fgIndex &&
+                   bgIndex == other.bgIndex && attrs == other.attrs;
+        }
+    };
+
+    struct Cell {
+        uint16_t style;
+        uint8_t width;
+        uint8_t textLength;  // UTF-16 units used in the column's text slot
+    };
+
+    // Rows with a column range in common, end exclusive
+    struct Damage {
+        int startRow;
+        int endRow;
+        int startCol;
+        int endCol;
+    };
+
+    GridMirror(int rows, int cols);
+
+    GridMirror(const GridMirror&) = delete;
+    GridMirror& operator=(const GridMirror&) = delete;
+
+    // Writer side, serialized by the owner's lock
+
+    // Applied with the next frame; every row becomes dirty
+    void resize(int rows, int cols);
+
+    void markDirty(int startRow, int endRow, int startCol, int endCol);
+    void markAllDirty();
+    bool dirty() const { return mDirty; }
+
+    // Dirty rows, merged into spans with the same column range, then cleared
+    std::vector<Damage> takeDamage();
+
+    // Rows are only written between these. beginFrame() returns false if
+    // the block could not grow to the current size; the frame is skipped.
+    bool beginFrame();
+    void endFrame();
+
+    // Style ID for the frame, or -1 when the table is full
+    int internStyle(const Style& style);
+
+    // Forget all style IDs so the rows can be written again from scratch
+    void resetStyles();
+
+    // Rewrite each style's colors in place, keeping its ID; rows are untouched
+    void recolorStyles(const std::function<void(Style&)>& recolor);
+
+    // Cells from startCol on, with TEXT_UNITS_PER_CELL units of text each
+    void writeCells(int row, int startCol, int count, const Cell* cells, const uint16_t* text);
+
+    int rows() const { return mRows; }
+    int cols() const { return mCols; }
+
+    // The block Java should map, or nullptr before the first frame
+    uint8_t* data() const;
+    size_t size() const;
+
+    // Reader side, safe from any thread without the owner's lock
+
+    // Sequence of the frame to read; odd while one is being written
+    uint64_t readBegin() const;
+
+    // Whether rows read since readBegin() belong to that frame
+    bool readValidate(uint64_t sequence) const;
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size = 0;
+        int rowCapacity = 0;
+        int colCapacity = 0;
+        int styleCapacity = 0;
+        size_t stylesOffset = 0;
+        size_t rowsOffset = 0;
+        size_t rowStride = 0;
+        size_t textOffset = 0;
+
+        std::atomic<uint64_t>* sequence() const {
+            return reinterpret_cast<std::atomic<uint64_t>*>(memory.get());
+        }
+        int32_t* header() const { return reinterpret_cast<int32_t*>(memory.get()); }
+    };
+
+    struct StyleHash {
+        size_t operator()(const Style& style) const;
+    };
+
+    bool ensureCapacity();
+
+    int mRows;
+    int mCols;
+
+    // Per row, the damaged column range; empty when start >= end
+    std::vector<int> mDirtyStart;
+    std::vector<int> mDirtyEnd;
+    bool mDirty = false;
+
+    std::unique_ptr<Block> mBlock;
+    std::vector<std::unique_ptr<Block>> mRetired;
+    std::atomic<Block*> mCurrent{nullptr};
+
+    // Styles recolored into the same value share a key, so IDs are counted apart
+    std::unordered_map<Style, uint16_t, StyleHash> mStyleIds;
+    int mStyleCount = 0;
+};
+
+#endif // TERMSCREEN_GRIDMIRROR_H
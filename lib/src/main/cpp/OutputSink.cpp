@@ -0,0 +1,202 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "OutputSink.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void OutputRing::push(const uint8_t* data, size_t length) {
+    if (mSize + length > mBuffer.size()) {
+        // Grow and unwrap so the queued bytes start at index 0
+        std::vector<uint8_t> grown(std::max(mBuffer.size() * 2, mSize + length));
+        size_t first = std::min(mSize, mBuffer.size() - mHead);
+        std::copy_n(mBuffer.begin() + mHead, first, grown.begin());
+        std::copy_n(mBuffer.begin(), mSize - first, grown.begin() + first);
+        mBuffer.swap(grown);
+        mHead = 0;
+    }
+
+    size_t tail = (mHead + mSize) % mBuffer.size();
+    size_t first = std::min(length, mBuffer.size() - tail);
+    std::memcpy(mBuffer.data() + tail, data, first);
+    std::memcpy(mBuffer.data(), data + first, length - first);
+    mSize += length;
+}
+
+const uint8_t* OutputRing::front(size_t* length) const {
+    *length = std::min(mSize, mBuffer.size() - mHead);
+    return mBuffer.data() + mHead;
+}
+
+void OutputRing::consume(size_t length) {
+    length = std::min(length, mSize);
+    mSize -= length;
+    mHead = mSize == 0 ? 0 : (mHead + length) % mBuffer.size();
+}
+
+void OutputRing::clear() {
+    mHead = 0;
+    mSize = 0;
+}
+
+std::unique_ptr<OutputSink> OutputSink::create(int fd) {
+    if (fd < 0) {
+        errno = EBADF;
+        return nullptr;
+    }
+
+    int type;
+    socklen_t typeLength = sizeof(type);
+    bool socket = getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) == 0;
+    if (!socket && errno != ENOTSOCK) {
+        return nullptr;  // EBADF and friends
+    }
+
+    int wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd < 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<OutputSink> sink(new OutputSink(fd, wakeFd, socket));
+    sink->mThread = std::thread(&OutputSink::run, sink.get());
+    return sink;
+}
+
+OutputSink::OutputSink(int fd, int wakeFd, bool socket)
+    : mFd(fd), mWakeFd(wakeFd), mSocket(socket) {
+}
+
+OutputSink::~OutputSink() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    eventfd_write(mWakeFd, 1);
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    close(mWakeFd);
+}
+
+ssize_t OutputSink::writeOnce(const uint8_t* data, size_t length) {
+    if (mSocket) {
+        return send(mFd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    struct pollfd pfd = { mFd, POLLOUT, 0 };
+    int ready = poll(&pfd, 1, 0);
+    if (ready < 0) {
+        return -1;
+    }
+    if (ready == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    // A writable pipe or terminal takes PIPE_BUF bytes without blocking
+    return ::write(mFd, data, std::min(length, static_cast<size_t>(PIPE_BUF)));
+}
+
+bool OutputSink::write(const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (mFailed) {
+        return false;
+    }
+
+    // Anything already queued goes first
+    size_t done = 0;
+    while (mBacklog.empty() && done < length) {
+        ssize_t n = writeOnce(data + done, length - done);
+        if (n > 0) {
+            done += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            mFailed = true;
+            return false;
+        }
+    }
+
+    if (done < length) {
+        bool wasEmpty = mBacklog.empty();
+        mBacklog.push(data + done, length - done);
+        if (wasEmpty) {
+            eventfd_write(mWakeFd, 1);  // start watching for POLLOUT
+        }
+    }
+
+    return true;
+}
+
+// Called with mLock held
+void OutputSink::flushLocked() {
+    while (!mBacklog.empty()) {
+        size_t length;
+        const uint8_t* data = mBacklog.front(&length);
+        ssize_t n = writeOnce(data, length);
+        if (n > 0) {
+            mBacklog.consume(static_cast<size_t>(n));
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            mFailed = true;
+            mBacklog.clear();
+        }
+    }
+}
+
+void OutputSink::run() {
+    std::unique_lock<std::mutex> lock(mLock);
+
+    while (!mStopping) {
+        bool backlog = !mBacklog.empty();
+        lock.unlock();
+
+        struct pollfd fds[2] = {
+            { mWakeFd, POLLIN, 0 },
+            { mFd, POLLOUT, 0 },
+        };
+        int ready = poll(fds, backlog ? 2 : 1, -1);
+
+        lock.lock();
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            eventfd_t value;
+            eventfd_read(mWakeFd, &value);
+        }
+        if (backlog && fds[1].revents) {
+            flushLocked();
+        }
+    }
+}
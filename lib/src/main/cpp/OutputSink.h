@@ -0,0 +1,94 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TERMSCREEN_OUTPUTSINK_H
+#define TERMSCREEN_OUTPUTSINK_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Byte queue for output a descriptor would not take yet. Grows as needed
+ * and hands out the oldest bytes as one contiguous span at a time.
+ */
+class OutputRing {
+public:
+    void push(const uint8_t* data, size_t length);
+
+    // Oldest queued bytes; may be fewer than size() when the ring wraps
+    const uint8_t* front(size_t* length) const;
+    void consume(size_t length);
+    void clear();
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+private:
+    std::vector<uint8_t> mBuffer;
+    size_t mHead = 0;
+    size_t mSize = 0;
+};
+
+/*
+ * Writes terminal output (keys and replies) straight to a descriptor the
+ * caller registered, e.g. the socket of a transport that still reads in
+ * Java. The descriptor stays the caller's: it is never closed here, and its
+ * blocking mode is left alone. Sockets are written with MSG_DONTWAIT; other
+ * descriptors only after poll reports them writable.
+ *
+ * write() never blocks. What the descriptor does not take is queued and
+ * flushed in order by a small thread that wakes only while a backlog exists.
+ */
+class OutputSink {
+public:
+    // Returns nullptr with errno set on failure
+    static std::unique_ptr<OutputSink> create(int fd);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // Returns false once the descriptor has failed
+    bool write(const uint8_t* data, size_t length);
+
+    int fd() const { return mFd; }
+
+private:
+    OutputSink(int fd, int wakeFd, bool socket);
+
+    // One nonblocking attempt; -1 with errno EAGAIN when it would block
+    ssize_t writeOnce(const uint8_t* data, size_t length);
+    void flushLocked();
+    void run();
+
+    int mFd;
+    int mWakeFd;
+    bool mSocket;
+
+    std::mutex mLock;
+    OutputRing mBacklog;
+    bool mFailed = false;
+    bool mStopping = false;
+
+    std::thread mThread;
+};
+
+#endif // TERMSCREEN_OUTPUTSINK_H
@@ -0,0 +1,350 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "ParallelLayout.h"
+#include <algorithm>
+#include <cstring>
+
+// Cells a worker lays out per share, bounding the rows held between emits
+static constexpr size_t SHARE_CELLS = 64 * 1024;
+
+// Workers only report the rows they scroll off
+const VTermScreenCallbacks ParallelLayout::sWorkerCallbacks = {
+    .damage = nullptr,
+    .moverect = nullptr,
+    .movecursor = nullptr,
+    .settermprop = nullptr,
+    .bell = nullptr,
+    .resize = nullptr,
+    .sb_pushline = nullptr,
+    .sb_popline = nullptr,
+    .sb_clear = nullptr,
+    .sb_pushline4 = ParallelLayout::pushRow
+};
+
+ParallelLayout::ParallelLayout(int threads)
+        : mThreads(std::max(threads, 1)) {
+}
+
+ParallelLayout::~ParallelLayout() {
+    {
+        std::lock_guard<std::mutex> lock(mPoolLock);
+        mStopping = true;
+    }
+    mSetReady.notify_all();
+    for (std::thread& thread : mPool) {
+        thread.join();
+    }
+
+    freeWorkers();
+}
+
+// Length of the UTF-8 character at data, or 0 unless it is whole, valid and
+// not a C1 control
+static size_t utf8Length(const uint8_t* data, size_t length) {
+    uint8_t c = data[0];
+    size_t size;
+    uint8_t low = 0x80;
+    uint8_t high = 0xBF;
+
+    if (c >= 0xC2 && c <= 0xDF) {
+        size = 2;
+        if (c == 0xC2) {
+            low = 0xA0;
+        }
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        size = 3;
+        if (c == 0xE0) {
+            low = 0xA0;
+        } else if (c == 0xED) {
+            high = 0x9F;  // surrogates
+        }
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        size = 4;
+        if (c == 0xF0) {
+            low = 0x90;
+        } else if (c == 0xF4) {
+            high = 0x8F;
+        }
+    } else {
+        return 0;
+    }
+
+    if (length < size || data[1] < low || data[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < size; i++) {
+        if (data[i] < 0x80 || data[i] > 0xBF) {
+            return 0;
+        }
+    }
+    return size;
+}
+
+size_t ParallelLayout::plainLines(const uint8_t* data, size_t length) {
+    size_t pos = 0;
+    size_t end = 0;
+
+    while (pos < length) {
+        uint8_t c = data[pos];
+        if (c >= 0x20 && c < 0x7F) {
+            pos++;
+        } else if (c == '\r') {
+            if (pos + 1 >= length || data[pos + 1] != '\n') {
+                break;
+            }
+            pos += 2;
+            end = pos;
+        } else if (c >= 0x80) {
+            size_t size = utf8Length(data + pos, length - pos);
+            if (size == 0) {
+                break;
+            }
+            pos += size;
+        } else {
+            break;
+        }
+    }
+
+    return end;
+}
+
+size_t ParallelLayout::lineStartAfter(const uint8_t* data, size_t length, size_t from, int lines) {
+    size_t pos = from;
+
+    for (int seen = 0; seen < lines || (pos < length && data[pos] >= 0x80); seen++) {
+        const void* lf = pos < length ? memchr(data + pos, '\n', length - pos) : nullptr;
+        if (!lf) {
+            return length;
+        }
+        pos = static_cast<const uint8_t*>(lf) - data + 1;
+    }
+
+    return pos;
+}
+
+size_t ParallelLayout::lineStartBefore(const uint8_t* data, size_t length, int lines) {
+    if (lines <= 0) {
+        return length;
+    }
+
+    size_t start = length;
+    for (int seen = 1; start > 0; seen++) {
+        // Back over one line, whose LF is just before start
+        start--;
+        while (start > 0 && data[start - 1] != '\n') {
+            start--;
+        }
+        if (seen >= lines && data[start] < 0x80) {
+            return start;
+        }
+    }
+
+    return 0;
+}
+
+bool ParallelLayout::prepare(int cols) {
+    if (cols == mCols && !mWorkers.empty()) {
+        return true;
+    }
+
+    freeWorkers();
+    mWorkers.resize(2 * mThreads);
+
+    // Two rows: the one being written and the one about to scroll off
+    for (Worker& worker : mWorkers) {
+        worker.vt = vterm_new(2, cols);
+        if (!worker.vt) {
+            freeWorkers();
+            return false;
+        }
+        vterm_set_utf8(worker.vt, 1);
+
+        vterm_screen_set_callbacks(vterm_obtain_screen(worker.vt), &sWorkerCallbacks, &worker);
+    }
+
+    mCols = cols;
+    startThreads();
+    return true;
+}
+
+void ParallelLayout::startThreads() {
+    if (!mPool.empty()) {
+        return;
+    }
+
+    mPool.reserve(mThreads);
+    for (int i = 0; i < mThreads; i++) {
+        mPool.emplace_back(&ParallelLayout::threadMain, this, static_cast<size_t>(i));
+    }
+}
+
+void ParallelLayout::threadMain(size_t slot) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mPoolLock);
+
+    for (;;) {
+        mSetReady.wait(lock, [&] { return mStopping || mGeneration != seen; });
+        if (mStopping) {
+            return;
+        }
+        seen = mGeneration;
+        if (slot >= mSetSize) {
+            continue;
+        }
+
+        Worker* worker = &mSet[slot];
+        lock.unlock();
+        run(worker);
+        lock.lock();
+
+        if (--mRunning == 0) {
+            mSetDone.notify_one();
+        }
+    }
+}
+
+void ParallelLayout::startSet(Worker* workers, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mPoolLock);
+        mSet = workers;
+        mSetSize = count;
+        mRunning = count;
+        mGeneration++;
+    }
+    mSetReady.notify_all();
+}
+
+void ParallelLayout::waitForSet() {
+    std::unique_lock<std::mutex> lock(mPoolLock);
+    mSetDone.wait(lock, [&] { return mRunning == 0; });
+}
+
+void ParallelLayout::freeWorkers() {
+    for (Worker& worker : mWorkers) {
+        if (worker.vt) {
+            vterm_free(worker.vt);
+        }
+    }
+    mWorkers.clear();
+    mCols = 0;
+}
+
+int ParallelLayout::pushRow(int cols, const VTermScreenCell* cells, bool continuation, void* user) {
+    auto* worker = static_cast<Worker*>(user);
+    if (worker->skip > 0) {
+        worker->skip--;
+        return 1;
+    }
+
+    worker->cells.insert(worker->cells.end(), cells, cells + cols);
+    worker->continuation.push_back(continuation);
+    return 1;
+}
+
+size_t ParallelLayout::assign(Worker* workers, const VTermState* state, const uint8_t* data, size_t length,
+                              size_t* pos) {
+    size_t budget = std::max<size_t>(SHARE_CELLS / mCols, 1);
+    size_t count = 0;
+
+    while (count < static_cast<size_t>(mThreads) && *pos < length) {
+        // A share ends after a line, once its rows might fill the budget;
+        // a line of n bytes takes at most n / cols + 1 rows
+        size_t start = *pos;
+        size_t end = start;
+        size_t rows = 0;
+        while (end < length) {
+            const void* lf = memchr(data + end, '\n', length - end);
+            size_t next = lf ? static_cast<const uint8_t*>(lf) - data + 1 : length;
+            rows += (next - end) / mCols + 1;
+            end = next;
+            if (rows >= budget && (end >= length || data[end] < 0x80)) {
+                break;
+            }
+        }
+
+        Worker& worker = workers[count++];
+        worker.data = data + start;
+        worker.length = end - start;
+        worker.cells.clear();
+        worker.continuation.clear();
+        worker.cells.reserve(std::min(rows, budget) * mCols);
+
+        // Copied here rather than on the worker, while nothing else reads state
+        vterm_screen_reset(vterm_obtain_screen(worker.vt), 1);
+        vterm_state_copy_pen(vterm_obtain_state(worker.vt), state);
+
+        *pos = end;
+    }
+
+    return count;
+}
+
+void ParallelLayout::run(Worker* worker) {
+    // The first line feed moves to the bottom row, and the second scrolls in
+    // a row cleared with the pen. Both rows that were on the screen before
+    // the share are pushed out ahead of its own.
+    worker->skip = 2;
+    vterm_input_write(worker->vt, "\r\n\r\n", 4);
+
+    vterm_input_write(worker->vt, reinterpret_cast<const char*>(worker->data), worker->length);
+
+    // The share's last row only leaves the screen with one more line feed
+    vterm_input_write(worker->vt, "\r\n", 2);
+}
+
+void ParallelLayout::emitRows(Worker* workers, size_t count, RowCallback emit, void* user) {
+    for (size_t i = 0; i < count; i++) {
+        const Worker& worker = workers[i];
+        for (size_t row = 0; row < worker.continuation.size(); row++) {
+            emit(mCols, worker.cells.data() + row * mCols, worker.continuation[row], user);
+        }
+    }
+}
+
+void ParallelLayout::layout(const VTermState* state, const uint8_t* data, size_t length, RowCallback emit,
+                            void* user) {
+    Worker* sets[2] = {mWorkers.data(), mWorkers.data() + mThreads};
+
+    size_t pos = 0;
+    int current = 0;
+    size_t ready = assign(sets[current], state, data, length, &pos);
+    startSet(sets[current], ready);
+
+    while (ready > 0) {
+        waitForSet();
+
+        // Lay out the next shares while this set's rows are handed over
+        int next = 1 - current;
+        size_t pending = assign(sets[next], state, data, length, &pos);
+        startSet(sets[next], pending);
+
+        emitRows(sets[current], ready, emit, user);
+
+        current = next;
+        ready = pending;
+    }
+
+    // Rows are only held for the length of a run
+    for (Worker& worker : mWorkers) {
+        worker.cells = {};
+        worker.continuation = {};
+    }
+}
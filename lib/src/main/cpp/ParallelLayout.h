@@ -0,0 +1,120 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TERMSCREEN_PARALLELLAYOUT_H
+#define TERMSCREEN_PARALLELLAYOUT_H
+
+#include <vterm.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Lays out long runs of plain lines into rows on worker threads.
+ *
+ * A plain line holds only printable ASCII and whole UTF-8 characters and
+ * ends in CRLF. Starting at the left of a fresh row with the parser in the
+ * ground state, such lines wrap into the same rows wherever they appear, so
+ * each worker feeds its share to a private two-row VTerm carrying the same
+ * pen and keeps the rows that scroll off it. The rows are then handed over
+ * in order, as a screen would have pushed them to scrollback.
+ *
+ * Shares only split before lines that start with an ASCII byte; a line that
+ * starts with a combining character would depend on the glyph before it.
+ *
+ * The worker threads are started by the first prepare() and kept until the
+ * layout is destroyed, waiting for the next set of shares in between.
+ */
+class ParallelLayout {
+public:
+    // Shorter runs are not worth handing out
+    static constexpr size_t MIN_BYTES = 128 * 1024;
+
+    using RowCallback = int (*)(int cols, const VTermScreenCell* cells, bool continuation, void* user);
+
+    explicit ParallelLayout(int threads);
+    ~ParallelLayout();
+
+    ParallelLayout(const ParallelLayout&) = delete;
+    ParallelLayout& operator=(const ParallelLayout&) = delete;
+
+    // Length of the plain lines at the start of data, up to the end of the
+    // last whole one
+    static size_t plainLines(const uint8_t* data, size_t length);
+
+    // Offset just past at least `lines` CRLFs, moved on to the first line
+    // that starts with an ASCII byte; length if there is none
+    static size_t lineStartAfter(const uint8_t* data, size_t length, size_t from, int lines);
+
+    // Start of a line that starts with an ASCII byte and has at least
+    // `lines` whole lines after it; 0 if there is none
+    static size_t lineStartBefore(const uint8_t* data, size_t length, int lines);
+
+    // Makes workers for rows cols wide, and starts the threads that run
+    // them. Returns false if they could not be allocated, in which case
+    // layout() must not be called.
+    bool prepare(int cols);
+
+    // Lays out plain lines (see plainLines()) from the left of a fresh row
+    // with the pen of state, and passes every row to emit in order
+    void layout(const VTermState* state, const uint8_t* data, size_t length, RowCallback emit, void* user);
+
+private:
+    struct Worker {
+        VTerm* vt = nullptr;
+        const uint8_t* data = nullptr;
+        size_t length = 0;
+        std::vector<VTermScreenCell> cells;
+        std::vector<uint8_t> continuation;
+        int skip = 0;  // priming rows still to be dropped
+    };
+
+    static int pushRow(int cols, const VTermScreenCell* cells, bool continuation, void* user);
+    static const VTermScreenCallbacks sWorkerCallbacks;
+
+    // Hands out the next shares to one set of workers; returns how many
+    size_t assign(Worker* workers, const VTermState* state, const uint8_t* data, size_t length, size_t* pos);
+    void run(Worker* worker);
+    void emitRows(Worker* workers, size_t count, RowCallback emit, void* user);
+    void freeWorkers();
+
+    // Pool threads: each runs its own slot of every set handed out
+    void startThreads();
+    void threadMain(size_t slot);
+    void startSet(Worker* workers, size_t count);
+    void waitForSet();
+
+    int mThreads;
+    int mCols = 0;
+
+    // Two sets of mThreads, so one set lays out while the other is emitted
+    std::vector<Worker> mWorkers;
+
+    std::vector<std::thread> mPool;
+    std::mutex mPoolLock;
+    std::condition_variable mSetReady;
+    std::condition_variable mSetDone;
+    Worker* mSet = nullptr;
+    size_t mSetSize = 0;
+    size_t mRunning = 0;
+    uint64_t mGeneration = 0;
+    bool mStopping = false;
+};
+
+#endif // TERMSCREEN_PARALLELLAYOUT_H
@@ -0,0 +1,176 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "PtyTransport.h"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <pty.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+// Shell convention: 128 + signal for a child killed by a signal
+int exitCodeOf(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
+std::vector<char*> toArgv(const std::vector<std::string>& strings) {
+    std::vector<char*> result;
+    result.reserve(strings.size() + 1);
+    for (const auto& s : strings) {
+        result.push_back(const_cast<char*>(s.c_str()));
+    }
+    result.push_back(nullptr);
+    return result;
+}
+
+// Runs in the forked child: only async-signal-safe calls from here on
+[[noreturn]] void execChild(char* const* argv, char** envp, const char* cwd) {
+    // The VM blocks and handles signals of its own; the child starts clean
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, nullptr);
+
+    struct sigaction dfl = {};
+    dfl.sa_handler = SIG_DFL;
+    for (int sig = 1; sig < NSIG; sig++) {
+        sigaction(sig, &dfl, nullptr);
+    }
+
+    if (cwd && chdir(cwd) != 0) {
+        _exit(126);
+    }
+    if (envp) {
+        environ = envp;
+    }
+
+    execvp(argv[0], argv);
+    _exit(127);
+}
+
+} // namespace
+
+std::unique_ptr<PtyTransport> PtyTransport::spawn(const std::vector<std::string>& argv,
+                                                  const std::vector<std::string>& env,
+                                                  const std::string& cwd,
+                                                  int rows, int cols) {
+    if (argv.empty() || rows <= 0 || cols <= 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    // Everything the child needs is built before fork
+    std::vector<char*> childArgv = toArgv(argv);
+    std::vector<char*> childEnv = toArgv(env);
+    char** envp = env.empty() ? nullptr : childEnv.data();
+    const char* dir = cwd.empty() ? nullptr : cwd.c_str();
+
+    struct winsize size = {};
+    size.ws_row = static_cast<unsigned short>(rows);
+    size.ws_col = static_cast<unsigned short>(cols);
+
+    int masterFd;
+    pid_t pid = forkpty(&masterFd, nullptr, nullptr, &size);
+    if (pid < 0) {
+        return nullptr;
+    }
+    if (pid == 0) {
+        execChild(childArgv.data(), envp, dir);
+    }
+
+    fcntl(masterFd, F_SETFD, FD_CLOEXEC);
+    fcntl(masterFd, F_SETFL, fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+
+    return std::unique_ptr<PtyTransport>(new PtyTransport(pid, masterFd));
+}
+
+PtyTransport::~PtyTransport() {
+    if (!mReaped) {
+        // login_tty made the child a session leader, so its pid is the group
+        kill(-mPid, SIGHUP);
+
+        // Reap without holding up the caller if the child takes its time
+        if (waitpid(mPid, nullptr, WNOHANG) == 0) {
+            pid_t pid = mPid;
+            std::thread([pid] { waitpid(pid, nullptr, 0); }).detach();
+        }
+    }
+
+    close(mMasterFd);
+}
+
+ssize_t PtyTransport::read(uint8_t* buffer, size_t length) {
+    ssize_t n = ::read(mMasterFd, buffer, length);
+    if (n < 0 && errno == EIO) {
+        return 0;  // every slave descriptor is closed, the child is gone
+    }
+    return n;
+}
+
+ssize_t PtyTransport::write(const uint8_t* data, size_t length) {
+    return ::write(mMasterFd, data, length);
+}
+
+void PtyTransport::setWindowSize(int rows, int cols) {
+    struct winsize size = {};
+    size.ws_row = static_cast<unsigned short>(rows);
+    size.ws_col = static_cast<unsigned short>(cols);
+    ioctl(mMasterFd, TIOCSWINSZ, &size);
+}
+
+pid_t PtyTransport::reap(int options, int* status) {
+    pid_t reaped;
+    do {
+        reaped = waitpid(mPid, status, options);
+    } while (reaped < 0 && errno == EINTR);
+    return reaped;
+}
+
+int PtyTransport::finish() {
+    // The master ends once every slave descriptor is closed, which the child
+    // can do without exiting. Don't wait on it until its group is hung up.
+    int status = 0;
+    pid_t reaped = reap(WNOHANG, &status);
+    if (reaped == 0) {
+        kill(-mPid, SIGHUP);
+        for (int i = 0; i < HANGUP_GRACE_POLLS && reaped == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(HANGUP_POLL_MS));
+            reaped = reap(WNOHANG, &status);
+        }
+    }
+    if (reaped == 0) {
+        // SIGHUP can be ignored; SIGKILL can't, so this wait is short
+        kill(-mPid, SIGKILL);
+        reaped = reap(0, &status);
+    }
+
+    mReaped = true;
+    return reaped == mPid ? exitCodeOf(status) : -1;
+}
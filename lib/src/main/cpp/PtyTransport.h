@@ -0,0 +1,69 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TERMSCREEN_PTYTRANSPORT_H
+#define TERMSCREEN_PTYTRANSPORT_H
+
+#include "Transport.h"
+#include <string>
+#include <vector>
+
+/*
+ * A child process on a local pseudo-terminal, read and written through
+ * its nonblocking master descriptor.
+ */
+class PtyTransport : public Transport {
+public:
+    // Fork and exec argv[0] (searched on PATH) on a new PTY. An empty env
+    // keeps the parent's environment; an empty cwd keeps its directory.
+    // Returns nullptr with errno set on failure.
+    static std::unique_ptr<PtyTransport> spawn(const std::vector<std::string>& argv,
+                                               const std::vector<std::string>& env,
+                                               const std::string& cwd,
+                                               int rows, int cols);
+
+    // Hangs up the child if it has not been reaped by finish()
+    ~PtyTransport() override;
+
+    pid_t pid() const { return mPid; }
+
+    int fd() const override { return mMasterFd; }
+    ssize_t read(uint8_t* buffer, size_t length) override;
+    ssize_t write(const uint8_t* data, size_t length) override;
+
+    // TIOCSWINSZ; the kernel sends SIGWINCH to the foreground process group
+    void setWindowSize(int rows, int cols) override;
+
+    // Reaps the child: its exit status, 128 + signal if it was killed. A
+    // child still running is hung up first, then killed if it stays.
+    int finish() override;
+
+private:
+    // How long finish() lets a hung-up child exit on its own
+    static constexpr int HANGUP_GRACE_POLLS = 50;
+    static constexpr int HANGUP_POLL_MS = 10;
+
+    PtyTransport(pid_t pid, int masterFd) : mPid(pid), mMasterFd(masterFd) {}
+
+    // waitpid() on the child, retried on EINTR
+    pid_t reap(int options, int* status);
+
+    pid_t mPid;
+    int mMasterFd;
+    bool mReaped = false;
+};
+
+#endif // TERMSCREEN_PTYTRANSPORT_H
@@ -15,173 +15,236 @@
  * limitations under the License.
  */
 #include "Terminal.h"
+#include "PtyTransport.h"
 #include "mutf8.h"
 #include <android/log.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <vector>
+#include <sys/system_properties.h>
+#include <unistd.h>
 
 #define LOG_TAG "TermNative"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
-// Thread-local CharArray pool to eliminate per-frame allocations
-// Each thread gets one reusable CharArray, sized to handle typical cell runs
-static thread_local jcharArray tls_charArray = nullptr;
-static thread_local jsize tls_charArraySize = 0;
+// Native threads (the PTY reader) attach to the VM on first use so callbacks
+// reach Java, and detach when the thread exits
+namespace {
+struct VmAttachment {
+    JavaVM* vm = nullptr;
+    ~VmAttachment() {
+        if (vm) {
+            vm->DetachCurrentThread();
+        }
+    }
+};
+thread_local VmAttachment tls_vmAttachment;
 
-// Terminal implementation
-Terminal::Terminal(JNIEnv* env, jobject callbacks, int rows, int cols)
-    : mRows(rows), mCols(cols) {
+void attachToVm(JavaVM* vm) {
+    if (tls_vmAttachment.vm) {
+        return;
+    }
+    JNIEnv* env;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+        return;  // a VM thread, or attached elsewhere
+    }
+    if (vm->AttachCurrentThread(&env, nullptr) == JNI_OK) {
+        tls_vmAttachment.vm = vm;
+    }
+}
+}
 
-    LOGD("Terminal constructor: rows=%d, cols=%d", rows, cols);
+// Process-wide JNI cache. Class and member IDs stay valid as long as the
+// classes stay loaded, so every session shares one lookup at library load.
+Terminal::JniCache Terminal::sJni{};
 
-    // Get JavaVM for callback invocations from any thread
-    env->GetJavaVM(&mJavaVM);
+// Lookups for loadJniCache(). A failed lookup leaves an exception pending,
+// which is logged and cleared here so the next lookup and JNI_OnLoad can run.
+namespace {
+jclass findClass(JNIEnv* env, const char* name) {
+    jclass local = env->FindClass(name);
+    if (!local || env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGE("Failed to find class %s", name);
+        return nullptr;
+    }
+    auto global = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
 
-    // Store global reference to callbacks
-    mCallbacks = env->NewGlobalRef(callbacks);
+jmethodID findMethod(JNIEnv* env, jclass cls, const char* name, const char* sig) {
+    jmethodID id = cls ? env->GetMethodID(cls, name, sig) : nullptr;
+    if (!id || env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGE("Failed to find method %s%s", name, sig);
+        return nullptr;
+    }
+    return id;
+}
 
-    // Cache method IDs
-    jclass callbacksClass = env->GetObjectClass(callbacks);
-    mDamageMethod = env->GetMethodID(callbacksClass, "damage", "(IIII)I");
-    if (!mDamageMethod || env->ExceptionCheck()) {
-        LOGE("Failed to find damage method");
+jmethodID findStaticMethod(JNIEnv* env, jclass cls, const char* name, const char* sig) {
+    jmethodID id = cls ? env->GetStaticMethodID(cls, name, sig) : nullptr;
+    if (!id || env->ExceptionCheck()) {
         env->ExceptionClear();
+        LOGE("Failed to find static method %s%s", name, sig);
+        return nullptr;
     }
-    mMoverectMethod = env->GetMethodID(callbacksClass, "moverect",
-        "(Lorg/connectbot/terminal/TermRect;Lorg/connectbot/terminal/TermRect;)I");
-    if (!mMoverectMethod) {
-        LOGE("Failed to find moverect method");
+    return id;
+}
+
+jfieldID findField(JNIEnv* env, jclass cls, const char* name, const char* sig) {
+    jfieldID id = cls ? env->GetFieldID(cls, name, sig) : nullptr;
+    if (!id || env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGE("Failed to find field %s %s", name, sig);
+        return nullptr;
     }
-    mMoveCursorMethod = env->GetMethodID(callbacksClass, "moveCursor",
+    return id;
+}
+}
+
+// Every ID is required; the library does not load if one is missing
+bool Terminal::loadJniCache(JNIEnv* env) {
+    // TerminalCallbacks methods, looked up on the interface so they dispatch to
+    // whichever implementation a session passes in
+    jclass callbacks = findClass(env, "org/connectbot/terminal/TerminalCallbacks");
+    sJni.damageMethod = findMethod(env, callbacks, "damage", "(IIII)I");
+    sJni.moverectMethod = findMethod(env, callbacks, "moverect",
+        "(Lorg/connectbot/terminal/TermRect;Lorg/connectbot/terminal/TermRect;)I");
+    sJni.moveCursorMethod = findMethod(env, callbacks, "moveCursor",
         "(Lorg/connectbot/terminal/CursorPosition;Lorg/connectbot/terminal/CursorPosition;Z)I");
-    if (!mMoveCursorMethod) {
-        LOGE("Failed to find moveCursor method");
-    }
-    mSetTermPropMethod = env->GetMethodID(callbacksClass, "setTermProp",
+    sJni.setTermPropMethod = findMethod(env, callbacks, "setTermProp",
         "(ILorg/connectbot/terminal/TerminalProperty;)I");
-    if (!mSetTermPropMethod) {
-        LOGE("Failed to find setTermProp method");
-    }
-    mBellMethod = env->GetMethodID(callbacksClass, "bell", "()I");
-    if (!mBellMethod) {
-        LOGE("Failed to find bell method");
-    }
-    mPushScrollbackMethod = env->GetMethodID(callbacksClass, "pushScrollbackLine",
+    sJni.bellMethod = findMethod(env, callbacks, "bell", "(I)I");
+    sJni.pushScrollbackMethod = findMethod(env, callbacks, "pushScrollbackLine",
+        "(I[Lorg/connectbot/terminal/ScreenCell;Z)I");
+    sJni.popScrollbackMethod = findMethod(env, callbacks, "popScrollbackLine",
         "(I[Lorg/connectbot/terminal/ScreenCell;)I");
-    if (!mPushScrollbackMethod) {
-        LOGE("Failed to find pushScrollbackLine method");
+    sJni.clearScrollbackMethod = findMethod(env, callbacks, "clearScrollback", "()I");
+    sJni.keyboardInputMethod = findMethod(env, callbacks, "onKeyboardInput", "([B)I");
+    sJni.oscSequenceMethod = findMethod(env, callbacks, "onOscSequence", "(ILjava/lang/String;)I");
+    sJni.transportClosedMethod = findMethod(env, callbacks, "onTransportClosed", "(I)I");
+    if (callbacks) {
+        env->DeleteGlobalRef(callbacks);
     }
-    mPopScrollbackMethod = env->GetMethodID(callbacksClass, "popScrollbackLine",
-        "(I[Lorg/connectbot/terminal/ScreenCell;)I");
-    if (!mPopScrollbackMethod) {
-        LOGE("Failed to find popScrollbackLine method");
-    }
-    mKeyboardInputMethod = env->GetMethodID(callbacksClass, "onKeyboardInput", "([B)I");
-    if (!mKeyboardInputMethod) {
-        LOGE("Failed to find onKeyboardInput method");
-    }
-    mOscSequenceMethod = env->GetMethodID(callbacksClass, "onOscSequence", "(ILjava/lang/String;)I");
-    if (!mOscSequenceMethod) {
-        LOGE("Failed to find onOscSequence method");
-    }
-
-    // Cache CellRun class and field IDs
-    mCellRunClass = (jclass)env->NewGlobalRef(
-        env->FindClass("org/connectbot/terminal/CellRun"));
-
-    mFgRedField = env->GetFieldID(mCellRunClass, "fgRed", "I");
-    mFgGreenField = env->GetFieldID(mCellRunClass, "fgGreen", "I");
-    mFgBlueField = env->GetFieldID(mCellRunClass, "fgBlue", "I");
-    mBgRedField = env->GetFieldID(mCellRunClass, "bgRed", "I");
-    mBgGreenField = env->GetFieldID(mCellRunClass, "bgGreen", "I");
-    mBgBlueField = env->GetFieldID(mCellRunClass, "bgBlue", "I");
-    mBoldField = env->GetFieldID(mCellRunClass, "bold", "Z");
-    mUnderlineField = env->GetFieldID(mCellRunClass, "underline", "I");
-    mItalicField = env->GetFieldID(mCellRunClass, "italic", "Z");
-    mBlinkField = env->GetFieldID(mCellRunClass, "blink", "Z");
-    mReverseField = env->GetFieldID(mCellRunClass, "reverse", "Z");
-    mStrikeField = env->GetFieldID(mCellRunClass, "strike", "Z");
-    mFontField = env->GetFieldID(mCellRunClass, "font", "I");
-    mDwlField = env->GetFieldID(mCellRunClass, "dwl", "Z");
-    mDhlField = env->GetFieldID(mCellRunClass, "dhl", "I");
-    mCharsField = env->GetFieldID(mCellRunClass, "chars", "[C");
-    mRunLengthField = env->GetFieldID(mCellRunClass, "runLength", "I");
-
-    // Cache all callback-related classes and methods to avoid repeated FindClass/GetMethodID
-    LOGD("Caching callback classes and methods...");
-
-    // TermRect
-    jclass termRectLocal = env->FindClass("org/connectbot/terminal/TermRect");
-    mTermRectClass = (jclass)env->NewGlobalRef(termRectLocal);
-    mTermRectConstructor = env->GetMethodID(mTermRectClass, "<init>", "(IIII)V");
-    env->DeleteLocalRef(termRectLocal);
-
-    // CursorPosition
-    jclass cursorPosLocal = env->FindClass("org/connectbot/terminal/CursorPosition");
-    mCursorPositionClass = (jclass)env->NewGlobalRef(cursorPosLocal);
-    mCursorPositionConstructor = env->GetMethodID(mCursorPositionClass, "<init>", "(II)V");
-    env->DeleteLocalRef(cursorPosLocal);
-
-    // ScreenCell
-    jclass screenCellLocal = env->FindClass("org/connectbot/terminal/ScreenCell");
-    mScreenCellClass = (jclass)env->NewGlobalRef(screenCellLocal);
-    mScreenCellConstructor = env->GetMethodID(mScreenCellClass, "<init>",
+
+    // Classes built for callbacks and queries
+    sJni.termRectClass = findClass(env, "org/connectbot/terminal/TermRect");
+    sJni.termRectConstructor = findMethod(env, sJni.termRectClass, "<init>", "(IIII)V");
+
+    sJni.cursorPositionClass = findClass(env, "org/connectbot/terminal/CursorPosition");
+    sJni.cursorPositionConstructor = findMethod(env, sJni.cursorPositionClass, "<init>", "(II)V");
+
+    sJni.screenCellClass = findClass(env, "org/connectbot/terminal/ScreenCell");
+    sJni.screenCellConstructor = findMethod(env, sJni.screenCellClass, "<init>",
         "(CLjava/util/List;IIIIIIZZIZZI)V");
-    env->DeleteLocalRef(screenCellLocal);
-
-    // ArrayList
-    jclass arrayListLocal = env->FindClass("java/util/ArrayList");
-    mArrayListClass = (jclass)env->NewGlobalRef(arrayListLocal);
-    mArrayListConstructor = env->GetMethodID(mArrayListClass, "<init>", "()V");
-    mArrayListAdd = env->GetMethodID(mArrayListClass, "add", "(Ljava/lang/Object;)Z");
-    env->DeleteLocalRef(arrayListLocal);
-
-    // Character
-    jclass charLocal = env->FindClass("java/lang/Character");
-    mCharacterClass = (jclass)env->NewGlobalRef(charLocal);
-    mCharacterValueOf = env->GetStaticMethodID(mCharacterClass, "valueOf", "(C)Ljava/lang/Character;");
-    env->DeleteLocalRef(charLocal);
-
-    // TerminalProperty classes
-    jclass boolLocal = env->FindClass("org/connectbot/terminal/TerminalProperty$BoolValue");
-    mTerminalPropertyBoolClass = (jclass)env->NewGlobalRef(boolLocal);
-    mTerminalPropertyBoolConstructor = env->GetMethodID(mTerminalPropertyBoolClass, "<init>", "(Z)V");
-    env->DeleteLocalRef(boolLocal);
-
-    jclass intLocal = env->FindClass("org/connectbot/terminal/TerminalProperty$IntValue");
-    mTerminalPropertyIntClass = (jclass)env->NewGlobalRef(intLocal);
-    mTerminalPropertyIntConstructor = env->GetMethodID(mTerminalPropertyIntClass, "<init>", "(I)V");
-    env->DeleteLocalRef(intLocal);
-
-    jclass stringLocal = env->FindClass("org/connectbot/terminal/TerminalProperty$StringValue");
-    mTerminalPropertyStringClass = (jclass)env->NewGlobalRef(stringLocal);
-    mTerminalPropertyStringConstructor = env->GetMethodID(mTerminalPropertyStringClass, "<init>", "(Ljava/lang/String;)V");
-    env->DeleteLocalRef(stringLocal);
-
-    jclass colorLocal = env->FindClass("org/connectbot/terminal/TerminalProperty$ColorValue");
-    mTerminalPropertyColorClass = (jclass)env->NewGlobalRef(colorLocal);
-    mTerminalPropertyColorConstructor = env->GetMethodID(mTerminalPropertyColorClass, "<init>", "(III)V");
-    env->DeleteLocalRef(colorLocal);
+
+    sJni.arrayListClass = findClass(env, "java/util/ArrayList");
+    sJni.arrayListConstructor = findMethod(env, sJni.arrayListClass, "<init>", "()V");
+    sJni.arrayListAdd = findMethod(env, sJni.arrayListClass, "add", "(Ljava/lang/Object;)Z");
+
+    sJni.characterClass = findClass(env, "java/lang/Character");
+    sJni.characterValueOf = findStaticMethod(env, sJni.characterClass, "valueOf", "(C)Ljava/lang/Character;");
+    sJni.characterCharValue = findMethod(env, sJni.characterClass, "charValue", "()C");
+
+    sJni.terminalPropertyBoolClass = findClass(env, "org/connectbot/terminal/TerminalProperty$BoolValue");
+    sJni.terminalPropertyBoolConstructor = findMethod(env, sJni.terminalPropertyBoolClass, "<init>", "(Z)V");
+    sJni.terminalPropertyIntClass = findClass(env, "org/connectbot/terminal/TerminalProperty$IntValue");
+    sJni.terminalPropertyIntConstructor = findMethod(env, sJni.terminalPropertyIntClass, "<init>", "(I)V");
+    sJni.terminalPropertyStringClass = findClass(env, "org/connectbot/terminal/TerminalProperty$StringValue");
+    sJni.terminalPropertyStringConstructor = findMethod(env, sJni.terminalPropertyStringClass, "<init>",
+        "(Ljava/lang/String;)V");
+    sJni.terminalPropertyColorClass = findClass(env, "org/connectbot/terminal/TerminalProperty$ColorValue");
+    sJni.terminalPropertyColorConstructor = findMethod(env, sJni.terminalPropertyColorClass, "<init>", "(III)V");
+
+    sJni.commandCostClass = findClass(env, "org/connectbot/terminal/CommandCost");
+    sJni.commandCostConstructor = findMethod(env, sJni.commandCostClass, "<init>",
+        "(JLjava/lang/String;JJJJJJIZ)V");
+
+    // Read back from the cells a popScrollbackLine callback fills in
+    jclass screenCell = sJni.screenCellClass;
+    sJni.screenCellChar = findField(env, screenCell, "char", "C");
+    sJni.screenCellCombiningChars = findField(env, screenCell, "combiningChars", "Ljava/util/List;");
+    sJni.screenCellFgRed = findField(env, screenCell, "fgRed", "I");
+    sJni.screenCellFgGreen = findField(env, screenCell, "fgGreen", "I");
+    sJni.screenCellFgBlue = findField(env, screenCell, "fgBlue", "I");
+    sJni.screenCellBgRed = findField(env, screenCell, "bgRed", "I");
+    sJni.screenCellBgGreen = findField(env, screenCell, "bgGreen", "I");
+    sJni.screenCellBgBlue = findField(env, screenCell, "bgBlue", "I");
+    sJni.screenCellBold = findField(env, screenCell, "bold", "Z");
+    sJni.screenCellItalic = findField(env, screenCell, "italic", "Z");
+    sJni.screenCellUnderline = findField(env, screenCell, "underline", "I");
+    sJni.screenCellReverse = findField(env, screenCell, "reverse", "Z");
+    sJni.screenCellStrike = findField(env, screenCell, "strike", "Z");
+    sJni.screenCellWidth = findField(env, screenCell, "width", "I");
+
+    jclass list = findClass(env, "java/util/List");
+    sJni.listSize = findMethod(env, list, "size", "()I");
+    sJni.listGet = findMethod(env, list, "get", "(I)Ljava/lang/Object;");
+    if (list) {
+        env->DeleteGlobalRef(list);
+    }
+
+    // Classes are held as global refs, so a missing member shows as a null
+    // ID here even if its class was the lookup that failed
+    const void* required[] = {
+        sJni.damageMethod, sJni.moverectMethod, sJni.moveCursorMethod, sJni.setTermPropMethod,
+        sJni.bellMethod, sJni.pushScrollbackMethod, sJni.popScrollbackMethod, sJni.clearScrollbackMethod,
+        sJni.keyboardInputMethod, sJni.oscSequenceMethod, sJni.transportClosedMethod,
+        sJni.termRectConstructor, sJni.cursorPositionConstructor, sJni.screenCellConstructor,
+        sJni.arrayListConstructor, sJni.arrayListAdd, sJni.characterValueOf, sJni.characterCharValue,
+        sJni.terminalPropertyBoolConstructor, sJni.terminalPropertyIntConstructor,
+        sJni.terminalPropertyStringConstructor, sJni.terminalPropertyColorConstructor,
+        sJni.commandCostConstructor,
+        sJni.screenCellChar, sJni.screenCellCombiningChars, sJni.screenCellFgRed, sJni.screenCellFgGreen,
+        sJni.screenCellFgBlue, sJni.screenCellBgRed, sJni.screenCellBgGreen, sJni.screenCellBgBlue,
+        sJni.screenCellBold, sJni.screenCellItalic, sJni.screenCellUnderline, sJni.screenCellReverse,
+        sJni.screenCellStrike, sJni.screenCellWidth, sJni.listSize, sJni.listGet,
+    };
+    for (const void* id : required) {
+        if (!id) {
+            LOGE("loadJniCache: a required class or member is missing");
+            return false;
+        }
+    }
 
     LOGD("All callback classes and methods cached successfully");
+    return true;
+}
 
-    // Create VTerm instance
-    mVt = vterm_new(mRows, mCols);
+// Terminal implementation
+Terminal::Terminal(JNIEnv* env, jobject callbacks, int rows, int cols)
+    : mRows(rows), mCols(cols) {
+
+    LOGD("Terminal constructor: rows=%d, cols=%d", rows, cols);
+
+    // Get JavaVM for callback invocations from any thread
+    env->GetJavaVM(&mJavaVM);
+
+    // Store global reference to callbacks
+    mCallbacks = env->NewGlobalRef(callbacks);
+
+    // Take a pre-built VTerm if one was pooled at this size
+    mVt = takePooled(mRows, mCols);
+    if (!mVt) {
+        mVt = newVTerm(mRows, mCols);
+    }
     if (!mVt) {
         LOGE("Failed to create VTerm instance");
         return;
     }
 
-    vterm_set_utf8(mVt, 1);
-
     // Set up output handler for keyboard input
     vterm_output_set_callback(mVt, termOutput, this);
 
     // Get screen and set up callbacks
     mVts = vterm_obtain_screen(mVt);
-    vterm_screen_enable_altscreen(mVts, 1);
 
     // Initialize callback structure as member variable so it doesn't go out of scope
     mScreenCallbacks = {
@@ -191,9 +254,10 @@ Terminal::Terminal(JNIEnv* env, jobject callbacks, int rows, int cols)
         .settermprop = termSettermprop,
         .bell = termBell,
         .resize = nullptr,  // We handle resize explicitly
-        .sb_pushline = termSbPushline,
+        .sb_pushline = nullptr,  // sb_pushline4 also reports wrapped lines
         .sb_popline = termSbPopline,
-        .sb_clear = nullptr  // Not needed
+        .sb_clear = termSbClear,
+        .sb_pushline4 = termSbPushline
     };
     vterm_screen_set_callbacks(mVts, &mScreenCallbacks, this);
 
@@ -211,17 +275,99 @@ Terminal::Terminal(JNIEnv* env, jobject callbacks, int rows, int cols)
     mStateFallbacks = fallbacks;
     vterm_state_set_unrecognised_fallbacks(state, &mStateFallbacks, this);
 
-    // Configure damage merging
-    vterm_screen_set_damage_merge(mVts, VTERM_DAMAGE_SCROLL);
-
+    // The buffers are already allocated; resetting again only replays the
+    // initial termprops and damage to this session's callbacks
     vterm_screen_reset(mVts, 1);
+    flushEvents();
 
     LOGD("Terminal initialized successfully");
 }
 
+// Everything about a VTerm that does not depend on the session using it
+VTerm* Terminal::newVTerm(int rows, int cols) {
+    VTerm* vt = vterm_new(rows, cols);
+    if (!vt) {
+        return nullptr;
+    }
+
+    vterm_set_utf8(vt, 1);
+
+    VTermScreen* vts = vterm_obtain_screen(vt);
+    vterm_screen_enable_altscreen(vts, 1);
+
+    // Wrapped lines rewrap on resize; history is rewrapped on the Java side
+    vterm_screen_enable_reflow(vts, true);
+
+    // Configure damage merging
+    vterm_screen_set_damage_merge(vts, VTERM_DAMAGE_SCROLL);
+
+    vterm_screen_reset(vts, 1);
+
+    return vt;
+}
+
+namespace {
+std::mutex sPoolLock;
+std::vector<VTerm*> sPool;
+}
+
+// Build up to count VTerm instances at this size ahead of time. Only fresh
+// instances are pooled; closed sessions are freed, not recycled, so no
+// parser or mode state can leak between sessions.
+int Terminal::prewarm(int rows, int cols, int count) {
+    if (rows <= 0 || cols <= 0) {
+        return 0;
+    }
+
+    int added = 0;
+    while (added < count) {
+        {
+            std::lock_guard<std::mutex> lock(sPoolLock);
+            if (static_cast<int>(sPool.size()) >= POOL_MAX) {
+                break;
+            }
+        }
+
+        // Build outside the lock so sessions can still take from the pool
+        VTerm* vt = newVTerm(rows, cols);
+        if (!vt) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(sPoolLock);
+        if (static_cast<int>(sPool.size()) >= POOL_MAX) {
+            vterm_free(vt);
+            break;
+        }
+        sPool.push_back(vt);
+        added++;
+    }
+
+    return added;
+}
+
+VTerm* Terminal::takePooled(int rows, int cols) {
+    std::lock_guard<std::mutex> lock(sPoolLock);
+
+    for (auto it = sPool.begin(); it != sPool.end(); ++it) {
+        int pooledRows, pooledCols;
+        vterm_get_size(*it, &pooledRows, &pooledCols);
+        if (pooledRows == rows && pooledCols == cols) {
+            VTerm* vt = *it;
+            sPool.erase(it);
+            return vt;
+        }
+    }
+
+    return nullptr;
+}
+
 Terminal::~Terminal() {
     LOGD("Terminal destructor");
 
+    // Before taking the lock: the transport thread may be waiting on it to parse
+    mTransport.reset();
+
     std::lock_guard<std::recursive_mutex> lock(mLock);
 
     if (mVt) {
@@ -236,20 +382,6 @@ Terminal::~Terminal() {
             env->DeleteGlobalRef(mCallbacks);
             mCallbacks = nullptr;
         }
-        if (mCellRunClass) {
-            env->DeleteGlobalRef(mCellRunClass);
-            mCellRunClass = nullptr;
-        }
-        // Clean up cached callback classes
-        if (mTermRectClass) env->DeleteGlobalRef(mTermRectClass);
-        if (mCursorPositionClass) env->DeleteGlobalRef(mCursorPositionClass);
-        if (mScreenCellClass) env->DeleteGlobalRef(mScreenCellClass);
-        if (mArrayListClass) env->DeleteGlobalRef(mArrayListClass);
-        if (mCharacterClass) env->DeleteGlobalRef(mCharacterClass);
-        if (mTerminalPropertyBoolClass) env->DeleteGlobalRef(mTerminalPropertyBoolClass);
-        if (mTerminalPropertyIntClass) env->DeleteGlobalRef(mTerminalPropertyIntClass);
-        if (mTerminalPropertyStringClass) env->DeleteGlobalRef(mTerminalPropertyStringClass);
-        if (mTerminalPropertyColorClass) env->DeleteGlobalRef(mTerminalPropertyColorClass);
     }
 }
 
@@ -262,12 +394,28 @@ int Terminal::writeInput(const uint8_t* data, size_t length) {
         return 0;
     }
 
+    mWriteStart = std::chrono::steady_clock::now();
+    mWriteLength = length;
+    mWriteCharged = false;
+
     // Feed data to libvterm for processing
-    size_t written = vterm_input_write(mVt, (const char*)data, length);
+    size_t written = (mLayout || mScrollbackLimit > 0) && length >= ParallelLayout::MIN_BYTES
+            ? writeInputRuns(data, length)
+            : vterm_input_write(mVt, (const char*)data, length);
 
     // Flush screen state to trigger callbacks
     vterm_screen_flush_damage(mVts);
 
+    if (mCommandRunning) {
+        chargeCommand(std::chrono::steady_clock::now());
+    }
+
+    if (mOutputTextEnabled) {
+        commitOutputText();
+    }
+
+    flushEvents();
+
     return static_cast<int>(written);
 }
 
@@ -275,17 +423,740 @@ int Terminal::writeInput(const uint8_t* data, size_t length) {
 int Terminal::resize(int rows, int cols) {
     std::lock_guard<std::recursive_mutex> lock(mLock);
 
+    if (mSizeLocked) {
+        mPendingRows = rows;
+        mPendingCols = cols;
+        return 1;
+    }
+
     mRows = rows;
     mCols = cols;
 
+    // Reflow moves rows around; give up on capturing the pending command line
+    mCommandInputPos = {-1, -1};
+
+    if (mGrid) {
+        mGrid->resize(rows, cols);
+    }
+
     if (mVt) {
         vterm_set_size(mVt, rows, cols);
         vterm_screen_flush_damage(mVts);
+        flushEvents();
+
+        // Likewise the output text picks up again at the cursor
+        if (mOutputTextEnabled) {
+            resumeOutputText();
+        }
+    }
+
+    if (mTransport) {
+        mTransport->transport().setWindowSize(rows, cols);
     }
 
     return 0;
 }
 
+// Size lock - the logical size stays put while the view zooms
+int Terminal::setSizeLocked(bool locked) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    mSizeLocked = locked;
+    if (locked) {
+        return 0;
+    }
+
+    int rows = mPendingRows;
+    int cols = mPendingCols;
+    mPendingRows = 0;
+    mPendingCols = 0;
+    if (rows <= 0 || cols <= 0 || (rows == mRows && cols == mCols)) {
+        return 0;
+    }
+
+    resize(rows, cols);
+    return 1;
+}
+
+// Character encoding - legacy encodings decode natively, no transcoding pass
+int Terminal::setEncoding(int encoding) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVt || encoding < 0 || encoding >= VTERM_N_LEGACY_ENCODINGS) {
+        return -1;
+    }
+
+    if (encoding == VTERM_LEGACY_NONE) {
+        vterm_set_utf8(mVt, 1);
+    } else {
+        vterm_set_legacy_encoding(mVt, static_cast<VTermLegacyEncoding>(encoding));
+    }
+
+    return 0;
+}
+
+// Transport binding - the binding thread feeds writeInput from its own buffer,
+// so neither direction of the data path touches the Java heap
+int Terminal::bindTransport(std::unique_ptr<Transport> transport) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVt) {
+        LOGE("bindTransport: VTerm not initialized");
+        return -EINVAL;
+    }
+    if (mTransport && !mTransport->closed()) {
+        return -EBUSY;
+    }
+    mTransport.reset();
+
+    transport->setWindowSize(mRows, mCols);
+
+    mTransport = TransportBinding::start(std::move(transport),
+        [this](const uint8_t* data, size_t length) {
+            attachToVm(mJavaVM);
+            writeInput(data, length);
+        },
+        [this](int exitCode) {
+            attachToVm(mJavaVM);
+            invokeTransportClosed(exitCode);
+        });
+    if (!mTransport) {
+        int error = errno;
+        LOGE("bindTransport: %s", strerror(error));
+        return -error;
+    }
+
+    return 0;
+}
+
+int Terminal::startProcess(const std::vector<std::string>& argv,
+                           const std::vector<std::string>& env,
+                           const std::string& cwd) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (mTransport && !mTransport->closed()) {
+        return -EBUSY;
+    }
+
+    auto pty = PtyTransport::spawn(argv, env, cwd, mRows, mCols);
+    if (!pty) {
+        int error = errno;
+        LOGE("startProcess: failed to spawn %s: %s", argv.empty() ? "" : argv[0].c_str(), strerror(error));
+        return -error;
+    }
+
+    pid_t pid = pty->pid();
+    int result = bindTransport(std::move(pty));
+    if (result < 0) {
+        return result;
+    }
+
+    LOGD("startProcess: pid=%d", pid);
+    return pid;
+}
+
+int Terminal::bindLoopback() {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    auto loopback = LoopbackTransport::create();
+    if (!loopback) {
+        return -errno;
+    }
+
+    int peerFd = loopback->takePeerFd();
+    int result = bindTransport(std::move(loopback));
+    if (result < 0) {
+        close(peerFd);
+        return result;
+    }
+
+    return peerFd;
+}
+
+// Output sink - saves the jbyteArray and Handler hop per key
+int Terminal::setOutputFd(int fd) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    mOutputSink.reset();
+    if (fd < 0) {
+        return 0;
+    }
+
+    mOutputSink = OutputSink::create(fd);
+    if (!mOutputSink) {
+        int error = errno;
+        LOGE("setOutputFd: %s", strerror(error));
+        return -error;
+    }
+
+    return 0;
+}
+
+void Terminal::setOutputCallback(OutputCallback callback, void* user) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    mOutputCallback = callback;
+    mOutputCallbackUser = user;
+}
+
+// Blink tick - redraw rows with blinking text, leave the rest alone
+int Terminal::blinkTick() {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVts) {
+        return 0;
+    }
+
+    int rows = vterm_screen_damage_blink(mVts);
+    vterm_screen_flush_damage(mVts);
+    publishGrid();
+
+    return rows;
+}
+
+// Selection - extent of the unit under a cell as {startRow, startCol, endRow, endCol}
+bool Terminal::getSelectExtent(int row, int col, int mode, int* extent) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVts || mode < 0 || mode >= VTERM_N_SELECTS) {
+        return false;
+    }
+
+    VTermPos pos = {row, col};
+    VTermPos start, end;
+    if (!vterm_screen_get_select_extent(mVts, pos, static_cast<VTermSelectMode>(mode), &start, &end)) {
+        return false;
+    }
+
+    extent[0] = start.row;
+    extent[1] = start.col;
+    extent[2] = end.row;
+    extent[3] = end.col;
+    return true;
+}
+
+// Command profiler
+void Terminal::setProfiling(int sampleEvery) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (mVt) {
+        vterm_profile_enable(mVt, sampleEvery);
+    }
+}
+
+void Terminal::setParallelParsing(int threads) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (threads <= 0) {
+        mLayout.reset();
+    } else {
+        mLayout = std::make_unique<ParallelLayout>(threads);
+    }
+}
+
+void Terminal::setScrollbackLimit(int lines) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    mScrollbackLimit = std::max(lines, 0);
+}
+
+size_t Terminal::writeInputRuns(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    size_t scan = 0;
+
+    // Runs are looked for from the start of each line; what comes before a
+    // long enough one goes through the parser as usual
+    while (scan < length) {
+        const void* lf = memchr(data + scan, '\n', length - scan);
+        if (!lf) {
+            break;
+        }
+        size_t start = static_cast<const uint8_t*>(lf) - data + 1;
+        size_t run = ParallelLayout::plainLines(data + start, length - start);
+
+        if (run >= ParallelLayout::MIN_BYTES) {
+            vterm_input_write(mVt, reinterpret_cast<const char*>(data + written), start - written);
+            writePlainLines(data + start, run);
+            written = start + run;
+        }
+        scan = start + run;
+    }
+
+    vterm_input_write(mVt, reinterpret_cast<const char*>(data + written), length - written);
+    return length;
+}
+
+// The parser sees enough lines at the start of the run to leave the cursor
+// at the left of a fresh bottom row, and enough at the end to fill the
+// screen. Everything between is laid out on the workers and goes straight
+// to scrollback, leaving the screen, cursor and history as if the parser had
+// seen it all.
+//
+// Lines followed by a full history and a screenful more within the run are
+// fast-forwarded: each of the lines after them takes at least one logical
+// line of history, so their rows would be evicted before the write returns.
+// They are skipped, with only their rows counted for a running command,
+// unless the output text stream reads them; then they are laid out without
+// being handed to scrollback.
+void Terminal::writePlainLines(const uint8_t* data, size_t length) {
+    size_t lead = ParallelLayout::lineStartAfter(data, length, 0, mRows);
+    size_t tail = ParallelLayout::lineStartBefore(data, length, mRows - 1);
+    size_t evicted = mScrollbackLimit > 0
+            ? ParallelLayout::lineStartBefore(data, length, mScrollbackLimit + mRows)
+            : 0;
+    bool parallel = mLayout && lead < tail;
+    // A one-row screen never pushes its row to scrollback. On one or two
+    // columns a glyph can fill a row from its start, and whether the line
+    // feed after it cancels the pending wrap depends on the row it is on.
+    if (mRows < 2 || mCols < 3 || (!parallel && evicted <= lead) || (parallel && !mLayout->prepare(mCols))) {
+        vterm_input_write(mVt, reinterpret_cast<const char*>(data), length);
+        return;
+    }
+
+    vterm_input_write(mVt, reinterpret_cast<const char*>(data), lead);
+
+    VTermState* state = vterm_obtain_state(mVt);
+    VTermPos cursor;
+    vterm_state_get_cursorpos(state, &cursor);
+    if (!vterm_state_plain_text_ready(state) || cursor.row != mRows - 1 || cursor.col != 0) {
+        vterm_input_write(mVt, reinterpret_cast<const char*>(data + lead), length - lead);
+        return;
+    }
+
+    size_t pos = lead;
+    bool cleared = false;
+
+    // Only the output text stream reads rows on their way to scrollback,
+    // and only while a row is pending. A running command just counts them.
+    if (evicted > lead && mOutputTextPos.row < 0) {
+        if (mCommandRunning) {
+            mCommand.scrolledLines += static_cast<int64_t>(vterm_state_plain_text_rows(
+                    state, reinterpret_cast<const char*>(data + lead), evicted - lead));
+        }
+        clearForRun();
+        cleared = true;
+        if (mCommandInputPos.row >= 0) {
+            mCommandInputPos.row = -1;
+        }
+        pos = evicted;
+    }
+
+    if (parallel && pos < tail) {
+        if (!cleared) {
+            clearForRun();
+        }
+        if (pos < evicted) {
+            mDropScrollback = true;
+            mLayout->layout(state, data + pos, evicted - pos, termSbPushline, this);
+            mDropScrollback = false;
+            pos = evicted;
+        }
+        mLayout->layout(state, data + pos, tail - pos, termSbPushline, this);
+        pos = tail;
+    } else if (pos < evicted) {
+        // Rows still on the screen at the end of these lines are pushed
+        // after them, but at most a screenful, so they are evicted as well
+        mDropScrollback = true;
+        vterm_input_write(mVt, reinterpret_cast<const char*>(data + pos), evicted - pos);
+        mDropScrollback = false;
+        pos = evicted;
+    }
+
+    // After clearForRun() the rest is written from the top. It fills the
+    // screen, so the rows it leaves there are the same.
+    vterm_input_write(mVt, reinterpret_cast<const char*>(data + pos), length - pos);
+}
+
+// The rows laid out next would push everything above the cursor off the
+// screen, so it goes first, leaving the cursor at the top of a blank screen
+void Terminal::clearForRun() {
+    char scroll[24];
+    int len = snprintf(scroll, sizeof(scroll), "\x1b[%dS\x1b[H", mRows - 1);
+    vterm_input_write(mVt, scroll, len);
+}
+
+// One line per command, most expensive first:
+// "<command> count=<n> sampled=<n> avg_ns=<n> est_total_ms=<n>"
+std::string Terminal::getProfileReport() {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVt) {
+        return {};
+    }
+
+    int total = vterm_profile_get(mVt, nullptr, 0);
+    std::vector<VTermProfileEntry> entries(total);
+    vterm_profile_get(mVt, entries.data(), total);
+
+    auto averageNs = [](const VTermProfileEntry& e) {
+        return e.sampled ? e.sampled_ns / e.sampled : 0;
+    };
+    std::sort(entries.begin(), entries.end(), [&](const auto& a, const auto& b) {
+        return averageNs(a) * a.count > averageNs(b) * b.count;
+    });
+
+    std::string report;
+    for (const auto& entry : entries) {
+        static const char* const kinds[] = {
+            "text", "C0/C1", "ESC", "CSI", "OSC", "DCS", "APC", "PM", "SOS",
+        };
+
+        std::string name = kinds[entry.kind];
+        switch (entry.kind) {
+            case VTERM_PROFILE_CONTROL: {
+                char hex[8];
+                snprintf(hex, sizeof(hex), " 0x%02x", entry.command);
+                name += hex;
+                break;
+            }
+            case VTERM_PROFILE_ESCAPE:
+            case VTERM_PROFILE_CSI:
+            case VTERM_PROFILE_DCS:
+                for (int shift = 16; shift >= 0; shift -= 8) {
+                    char c = static_cast<char>((entry.command >> shift) & 0xff);
+                    if (c) {
+                        name += ' ';
+                        name += c;
+                    }
+                }
+                break;
+            case VTERM_PROFILE_OSC:
+                name += ' ' + std::to_string(entry.command);
+                break;
+            default:
+                break;
+        }
+
+        char line[160];
+        snprintf(line, sizeof(line), "%s count=%" PRIu64 " sampled=%" PRIu64 " avg_ns=%" PRIu64
+                 " est_total_ms=%" PRIu64 "\n",
+                 name.c_str(), entry.count, entry.sampled, averageNs(entry),
+                 averageNs(entry) * entry.count / 1000000);
+        report += line;
+    }
+
+    return report;
+}
+
+// Per-command costs
+// Charge the running command for the current write up to now. A write's bytes
+// go to the command once, even if its time is split around a mark
+void Terminal::chargeCommand(std::chrono::steady_clock::time_point now) {
+    mCommand.parseNs += std::chrono::duration_cast<std::chrono::nanoseconds>(now - mWriteStart).count();
+    mWriteStart = now;
+
+    if (!mWriteCharged) {
+        mCommand.bytes += static_cast<int64_t>(mWriteLength);
+        mWriteCharged = true;
+    }
+}
+
+void Terminal::recordCommand() {
+    mCommandHistory.push_back(mCommand);
+    if (mCommandHistory.size() > COMMAND_HISTORY_SIZE) {
+        mCommandHistory.pop_front();
+    }
+    mCommandRunning = false;
+}
+
+// OSC 133 shell integration marks: B = command input starts, C = command
+// output starts, D[;exit] = command finished
+void Terminal::onShellIntegrationMark(const VTermStringFragment& frag) {
+    if (!frag.initial || frag.len == 0 || (frag.len > 1 && frag.str[1] != ';')) {
+        return;
+    }
+
+    VTermState* state = vterm_obtain_state(mVt);
+    auto now = std::chrono::steady_clock::now();
+
+    switch (frag.str[0]) {
+        case 'A':
+            // Output so far is final; the prompt and input are not output
+            if (mOutputTextEnabled) {
+                commitOutputText();
+            }
+            mOutputTextInPrompt = true;
+            break;
+
+        case 'B':
+            vterm_state_get_cursorpos(state, &mCommandInputPos);
+            break;
+
+        case 'C': {
+            // Damage so far belongs to the prompt, not the command
+            vterm_screen_flush_damage(mVts);
+
+            VTermPos cursor;
+            vterm_state_get_cursorpos(state, &cursor);
+
+            // A command that never reported D is kept, marked unfinished
+            if (mCommandRunning) {
+                chargeCommand(now);
+                mCommand.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - mCommandStart).count();
+                recordCommand();
+            }
+
+            mCommand = CommandStats{};
+            mCommand.id = mNextCommandId++;
+            mCommand.startTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            if (mCommandInputPos.row >= 0) {
+                mCommand.commandLine = readCommandLine(mCommandInputPos, cursor);
+            }
+            mCommandInputPos = {-1, -1};
+
+            mCommandRunning = true;
+            mCommandStart = now;
+            mWriteStart = now;
+            mWriteCharged = false;
+
+            mOutputTextInPrompt = false;
+            if (mOutputTextEnabled) {
+                resumeOutputText();
+            }
+            break;
+        }
+
+        case 'D': {
+            if (!mCommandRunning) {
+                break;
+            }
+
+            // The command's last output is still pending as damage
+            vterm_screen_flush_damage(mVts);
+            chargeCommand(now);
+
+            mCommand.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - mCommandStart).count();
+            mCommand.finished = true;
+            if (frag.len > 2) {
+                mCommand.exitCode = atoi(std::string(frag.str + 2, frag.len - 2).c_str());
+            }
+
+            recordCommand();
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// Text of the command line, joining soft-wrapped rows
+std::string Terminal::readCommandLine(VTermPos from, VTermPos to) {
+    static constexpr size_t MAX_COMMAND_LINE = 256;
+
+    VTermState* state = vterm_obtain_state(mVt);
+    std::string text;
+    char buf[MAX_COMMAND_LINE];
+
+    int lastRow = to.col > 0 ? to.row : to.row - 1;
+    for (int row = std::max(from.row, 0); row <= lastRow && row < mRows; row++) {
+        if (row > from.row && !vterm_state_get_lineinfo(state, row)->continuation) {
+            text += ' ';
+        }
+
+        VTermRect rect = {
+            .start_row = row,
+            .end_row = row + 1,
+            .start_col = row == from.row ? from.col : 0,
+            .end_col = row == to.row ? to.col : mCols,
+        };
+        size_t len = vterm_screen_get_text(mVts, buf, sizeof(buf), rect);
+        text.append(buf, std::min(len, sizeof(buf)));
+
+        if (text.size() >= MAX_COMMAND_LINE) {
+            text.resize(MAX_COMMAND_LINE);
+            break;
+        }
+    }
+
+    while (!text.empty() && text.back() == ' ') {
+        text.pop_back();
+    }
+    return text;
+}
+
+// Report the final value of each property changed since the last flush, then
+// the bells. A title rewritten by every progress update costs one upcall.
+void Terminal::flushEvents() {
+    publishGrid();
+
+    while (mChangedProps) {
+        int prop = __builtin_ctz(mChangedProps);
+        mChangedProps &= mChangedProps - 1;
+
+        // Copied first; Java may write to the terminal from the callback
+        PendingProp pending = mPendingProps[prop];
+        if (vterm_get_prop_type(static_cast<VTermProp>(prop)) == VTERM_VALUETYPE_STRING) {
+            pending.value.string.str = pending.text.c_str();
+            pending.value.string.len = pending.text.size();
+            pending.value.string.initial = true;
+            pending.value.string.final = true;
+        }
+        invokeSetTermProp(static_cast<VTermProp>(prop), &pending.value);
+    }
+
+    if (mPendingBells > 0) {
+        int count = mPendingBells;
+        mPendingBells = 0;
+        invokeBell(count);
+    }
+}
+
+// Output text stream. Text is appended up to the cursor at the end of each
+// write, and rows scrolling off the top are taken from the scrollback push,
+// so the cost follows the amount of new output rather than the screen size.
+void Terminal::commitOutputText() {
+    if (mOutputTextPos.row < 0 || mOutputTextInPrompt || mOutputTextInAltScreen) {
+        return;
+    }
+
+    VTermState* state = vterm_obtain_state(mVt);
+    VTermPos cursor;
+    vterm_state_get_cursorpos(state, &cursor);
+
+    if (cursor.row < mOutputTextPos.row) {
+        resumeOutputText();
+        return;
+    }
+
+    if (mOutputTextCells.size() < static_cast<size_t>(mCols)) {
+        mOutputTextCells.resize(mCols);
+    }
+
+    for (int row = mOutputTextPos.row; row <= cursor.row && row < mRows; row++) {
+        if (row > mOutputTextPos.row) {
+            if (!vterm_state_get_lineinfo(state, row)->continuation) {
+                appendOutputChar('\n');
+            }
+            mOutputTextPos = {row, 0};
+        }
+
+        int from = mOutputTextPos.col;
+        int to = row == cursor.row ? std::min(cursor.col, mCols) : mCols;
+        if (to <= from) {
+            continue;
+        }
+
+        for (int col = from; col < to; col++) {
+            vterm_screen_get_cell(mVts, {row, col}, &mOutputTextCells[col]);
+        }
+        mOutputTextPos.col = appendOutputCells(mOutputTextCells.data(), from, to);
+    }
+}
+
+// Start the stream again at the cursor, on a line of its own
+void Terminal::resumeOutputText() {
+    vterm_state_get_cursorpos(vterm_obtain_state(mVt), &mOutputTextPos);
+    if (!mOutputText.empty() && mOutputText.back() != u'\n') {
+        appendOutputChar('\n');
+    }
+}
+
+// Appends cells [from, to) up to the last non-blank one and returns the column
+// after it. Trailing blanks are left for the next commit, which includes them
+// only if something is written after them.
+int Terminal::appendOutputCells(const VTermScreenCell* cells, int from, int to) {
+    int end = to;
+    while (end > from && (cells[end - 1].chars[0] == 0 || cells[end - 1].chars[0] == ' ')) {
+        end--;
+    }
+
+    for (int col = from; col < end; col++) {
+        const VTermScreenCell& cell = cells[col];
+        if (cell.chars[0] == static_cast<uint32_t>(-1)) {
+            continue;  // right half of a wide character
+        }
+        if (cell.chars[0] == 0) {
+            appendOutputChar(' ');
+            continue;
+        }
+        for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL && cell.chars[i]; i++) {
+            appendOutputChar(cell.chars[i]);
+        }
+    }
+
+    return end;
+}
+
+void Terminal::appendOutputChar(uint32_t codepoint) {
+    if (codepoint >= 0x10000) {
+        codepoint -= 0x10000;
+        mOutputText += static_cast<char16_t>(0xD800 + (codepoint >> 10));
+        mOutputText += static_cast<char16_t>(0xDC00 + (codepoint & 0x3FF));
+    } else {
+        mOutputText += static_cast<char16_t>(codepoint);
+    }
+
+    // Drop the oldest half, never splitting a surrogate pair
+    if (mOutputText.size() > OUTPUT_TEXT_CAPACITY) {
+        size_t drop = mOutputText.size() - OUTPUT_TEXT_CAPACITY / 2;
+        if (drop < mOutputText.size() && (mOutputText[drop] & 0xFC00) == 0xDC00) {
+            drop++;
+        }
+        mOutputText.erase(0, drop);
+        mOutputTextStart += drop;
+    }
+}
+
+jstring Terminal::readOutputText(JNIEnv* env, jlong* cursor) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVt) {
+        return nullptr;
+    }
+
+    if (!mOutputTextEnabled) {
+        mOutputTextEnabled = true;
+        vterm_state_get_cursorpos(vterm_obtain_state(mVt), &mOutputTextPos);
+    }
+
+    uint64_t end = mOutputTextStart + mOutputText.size();
+    uint64_t from = *cursor < 0 ? end : std::max(static_cast<uint64_t>(*cursor), mOutputTextStart);
+    from = std::min(from, end);
+    *cursor = static_cast<jlong>(end);
+
+    return env->NewString(reinterpret_cast<const jchar*>(mOutputText.data() + (from - mOutputTextStart)),
+                          static_cast<jsize>(end - from));
+}
+
+// Recent commands oldest first, followed by the running one if any
+jobjectArray Terminal::getCommandStats(JNIEnv* env) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    std::deque<CommandStats> commands = mCommandHistory;
+    if (mCommandRunning) {
+        CommandStats running = mCommand;
+        running.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - mCommandStart).count();
+        commands.push_back(running);
+    }
+
+    jobjectArray result = env->NewObjectArray(static_cast<jsize>(commands.size()), sJni.commandCostClass, nullptr);
+    if (!result) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < commands.size(); i++) {
+        const CommandStats& command = commands[i];
+
+        jstring commandLine = env->NewStringUTF(command.commandLine.c_str());
+        jobject cost = env->NewObject(sJni.commandCostClass, sJni.commandCostConstructor,
+            static_cast<jlong>(command.id), commandLine,
+            static_cast<jlong>(command.startTimeMs), static_cast<jlong>(command.durationNs),
+            static_cast<jlong>(command.parseNs), static_cast<jlong>(command.bytes),
+            static_cast<jlong>(command.scrolledLines), static_cast<jlong>(command.damagedCells),
+            command.exitCode, static_cast<jboolean>(command.finished));
+
+        env->SetObjectArrayElement(result, static_cast<jsize>(i), cost);
+        env->DeleteLocalRef(cost);
+        env->DeleteLocalRef(commandLine);
+    }
+
+    return result;
+}
+
 // Color configuration
 int Terminal::setPaletteColors(const uint32_t* colors, int count) {
     std::lock_guard<std::recursive_mutex> lock(mLock);
@@ -316,6 +1187,8 @@ int Terminal::setPaletteColors(const uint32_t* colors, int count) {
         vterm_state_set_palette_color(state, i, &vtColor);
     }
 
+    recolorGrid();
+
     return colorCount;
 }
 
@@ -349,6 +1222,8 @@ int Terminal::setDefaultColors(uint32_t fgColor, uint32_t bgColor) {
 
     vterm_screen_set_default_colors(screen, &vtFg, &vtBg);
 
+    recolorGrid();
+
     return 0;
 }
 
@@ -385,143 +1260,368 @@ bool Terminal::dispatchCharacter(int modifiers, int codepoint) {
     return true;
 }
 
-// Cell run retrieval
-int Terminal::getCellRun(JNIEnv* env, int row, int col, jobject runObject) {
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+// Cell run retrieval
+int Terminal::setCellRunBuffer(void* address, size_t capacity) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (address && capacity < CELL_RUN_MIN_BYTES) {
+        return -1;
+    }
+    mCellRunBuffer = static_cast<uint8_t*>(address);
+    mCellRunCapacity = address ? capacity : 0;
+    return 0;
+}
+
+int Terminal::getCellRun(int row, int col, int endCol) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    endCol = std::min(endCol, mCols);
+    if (!mVts || !mCellRunBuffer || row < 0 || row >= mRows || col < 0 || col >= endCol) {
+        return 0;
+    }
+
+    auto* header = reinterpret_cast<int32_t*>(mCellRunBuffer);
+    auto* chars = reinterpret_cast<uint16_t*>(mCellRunBuffer + CELL_RUN_HEADER_BYTES);
+    size_t maxChars = (mCellRunCapacity - CELL_RUN_HEADER_BYTES) / sizeof(uint16_t);
+
+    // Get first cell
+    VTermPos pos = { row, col };
+    VTermScreenCell cell;
+    vterm_screen_get_cell(mVts, pos, &cell);
+
+    // Collect cells with same attributes; the run length is in columns and
+    // the char count in UTF-16 units, which differ for wide and combining chars.
+    // A run that would overflow the buffer ends early and the caller continues
+    // from where it stopped.
+    int runLength = 0;
+    size_t charCount = 0;
+
+    for (int c = col; c < endCol; c++) {
+        VTermPos currentPos = { row, c };
+        VTermScreenCell currentCell;
+        vterm_screen_get_cell(mVts, currentPos, &currentCell);
+
+        // Check if attributes match (skip for first cell)
+        if (c > col && !cellStyleEqual(cell, currentCell)) {
+            break;
+        }
+        if (charCount + VTERM_MAX_CHARS_PER_CELL * 2 > maxChars) {
+            break;
+        }
+
+        // Add character(s) to run
+        if (currentCell.chars[0] == 0) {
+            // Empty cell
+            chars[charCount++] = ' ';
+        } else {
+            // Convert UTF-32 to UTF-16 (handle surrogate pairs)
+            for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL && currentCell.chars[i]; i++) {
+                uint32_t codepoint = currentCell.chars[i];
+
+                if (codepoint <= 0xFFFF) {
+                    chars[charCount++] = static_cast<uint16_t>(codepoint);
+                } else {
+                    // Surrogate pair for codepoints > U+FFFF
+                    codepoint -= 0x10000;
+                    chars[charCount++] = static_cast<uint16_t>(0xD800 + (codepoint >> 10));
+                    chars[charCount++] = static_cast<uint16_t>(0xDC00 + (codepoint & 0x3FF));
+                }
+            }
+        }
+        runLength++;
+
+        // Skip next column if this is a wide character
+        if (currentCell.width == 2 && c + 1 < mCols) {
+            c++;
+            runLength++;
+        }
+    }
+
+    // Resolve colors
+    uint8_t fgRed, fgGreen, fgBlue;
+    uint8_t bgRed, bgGreen, bgBlue;
+    resolveColor(cell.fg, fgRed, fgGreen, fgBlue);
+    resolveColor(cell.bg, bgRed, bgGreen, bgBlue);
+
+    header[CELL_RUN_LENGTH] = runLength;
+    header[CELL_RUN_CHAR_COUNT] = static_cast<int32_t>(charCount);
+    header[CELL_RUN_FG_RGB] = (fgRed << 16) | (fgGreen << 8) | fgBlue;
+    header[CELL_RUN_BG_RGB] = (bgRed << 16) | (bgGreen << 8) | bgBlue;
+    header[CELL_RUN_FG_INDEX] = paletteIndex(cell.fg);
+    header[CELL_RUN_BG_INDEX] = paletteIndex(cell.bg);
+    header[CELL_RUN_FLAGS] = cellFlags(cell);
+    header[CELL_RUN_UNDERLINE] = cell.attrs.underline;
+    header[CELL_RUN_FONT] = cell.attrs.font;
+    header[CELL_RUN_DHL] = cell.attrs.dhl;
+
+    return runLength;
+}
+
+// Shared grid
+bool Terminal::enableGrid(uint8_t** data, size_t* size) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVts) {
+        return false;
+    }
+
+    if (!mGrid) {
+        mGrid = std::make_unique<GridMirror>(mRows, mCols);
+        publishGrid();
+    }
+
+    *data = mGrid->data();
+    *size = mGrid->size();
+    return *data != nullptr;
+}
+
+// Damage collected since the last frame is reported only after its rows
+// are in the mirror, so Java never reads a row older than its damage
+void Terminal::publishGrid() {
+    if (!mGrid || !mGrid->dirty()) {
+        return;
+    }
+
+    if (!mGrid->beginFrame()) {
+        LOGE("publishGrid: cannot map a %dx%d grid", mRows, mCols);
+        for (const auto& damage : mGrid->takeDamage()) {
+            invokeDamage(damage.startRow, damage.endRow, damage.startCol, damage.endCol);
+        }
+        return;
+    }
+
+    auto writeCells = [this](const std::vector<GridMirror::Damage>& damage) {
+        bool complete = true;
+        for (const auto& rect : damage) {
+            // One more column each side, so a wide character is never split
+            int startCol = std::max(rect.startCol - 1, 0);
+            int endCol = std::min(rect.endCol + 1, mGrid->cols());
+            for (int row = rect.startRow; row < rect.endRow; row++) {
+                complete &= writeGridCells(row, startCol, endCol);
+            }
+        }
+        return complete;
+    };
+
+    std::vector<GridMirror::Damage> damage = mGrid->takeDamage();
+    if (!writeCells(damage)) {
+        // Out of style IDs: number them again from the whole screen
+        mGrid->resetStyles();
+        damage = mGrid->takeDamage();
+        writeCells(damage);
+    }
+
+    mGrid->endFrame();
+
+    for (const auto& rect : damage) {
+        invokeDamage(rect.startRow, rect.endRow, rect.startCol, rect.endCol);
+    }
+}
+
+// The mirror's styles hold resolved colors. A palette change rewrites them
+// in a frame of its own; Java repaints from palette slots, so no row is
+// rewritten and no damage is sent.
+void Terminal::recolorGrid() {
+    if (!mGrid) {
+        return;
+    }
+
+    // Rows still waiting for a frame go out first, in case the block grows
+    publishGrid();
+    if (!mGrid->beginFrame()) {
+        return;
+    }
+
+    VTermState* state = vterm_obtain_state(mVt);
+    VTermColor defaultFg, defaultBg;
+    vterm_state_get_default_colors(state, &defaultFg, &defaultBg);
+
+    auto resolve = [&](int index, int32_t rgb) {
+        VTermColor color;
+        if (index == PALETTE_DEFAULT_FG) {
+            color = defaultFg;
+        } else if (index == PALETTE_DEFAULT_BG) {
+            color = defaultBg;
+        } else if (index >= 0) {
+            vterm_state_get_palette_color(state, index, &color);
+        } else {
+            return rgb;
+        }
+        return (color.rgb.red << 16) | (color.rgb.green << 8) | color.rgb.blue;
+    };
+
+    mGrid->recolorStyles([&](GridMirror::Style& style) {
+        style.fgRgb = resolve(style.fgIndex, style.fgRgb);
+        style.bgRgb = resolve(style.bgIndex, style.bgRgb);
+    });
+    mGrid->endFrame();
+}
+
+static_assert(GridMirror::TEXT_UNITS_PER_CELL == 2 * VTERM_MAX_CHARS_PER_CELL,
+              "a cell's text must fit the mirror");
 
-    if (!mVts || row < 0 || row >= mRows || col < 0 || col >= mCols) {
-        return 0;
-    }
+// Returns false if the style table filled up; the cells are written anyway,
+// with the overflowing ones in style 0
+bool Terminal::writeGridCells(int row, int startCol, int endCol) {
+    int count = endCol - startCol;
+    mGridCells.resize(count);
+    mGridText.assign(count * GridMirror::TEXT_UNITS_PER_CELL, 0);
 
-    // Get first cell
-    VTermPos pos = { row, col };
-    VTermScreenCell cell;
-    vterm_screen_get_cell(mVts, pos, &cell);
+    bool complete = true;
+    for (int i = 0; i < count; i++) {
+        VTermPos pos = { row, startCol + i };
+        VTermScreenCell cell;
+        vterm_screen_get_cell(mVts, pos, &cell);
 
-    // Collect cells with same attributes
-    int runLength = 0;
-    jchar chars[256];  // Max run length
+        uint8_t fgRed, fgGreen, fgBlue;
+        uint8_t bgRed, bgGreen, bgBlue;
+        resolveColor(cell.fg, fgRed, fgGreen, fgBlue);
+        resolveColor(cell.bg, bgRed, bgGreen, bgBlue);
 
-    for (int c = col; c < mCols && runLength < 256; c++) {
-        VTermPos currentPos = { row, c };
-        VTermScreenCell currentCell;
-        vterm_screen_get_cell(mVts, currentPos, &currentCell);
+        GridMirror::Style style = {
+            (fgRed << 16) | (fgGreen << 8) | fgBlue,
+            (bgRed << 16) | (bgGreen << 8) | bgBlue,
+            static_cast<int16_t>(paletteIndex(cell.fg)),
+            static_cast<int16_t>(paletteIndex(cell.bg)),
+            cellFlags(cell) | (cell.attrs.underline << 8) | (cell.attrs.dhl << 12) | (cell.attrs.font << 16),
+        };
+        int id = mGrid->internStyle(style);
+        if (id < 0) {
+            complete = false;
+            id = 0;
+        }
 
-        // Check if attributes match (skip for first cell)
-        if (c > col && !cellStyleEqual(cell, currentCell)) {
-            break;
+        // Right half of a wide character starting before the damage
+        if (cell.chars[0] == static_cast<uint32_t>(-1)) {
+            mGridCells[i] = { static_cast<uint16_t>(id), 0, 0 };
+            continue;
         }
 
-        // Add character(s) to run
-        if (currentCell.chars[0] == 0) {
-            // Empty cell
-            chars[runLength++] = ' ';
+        uint16_t* text = mGridText.data() + i * GridMirror::TEXT_UNITS_PER_CELL;
+        int length = 0;
+        if (cell.chars[0] == 0) {
+            text[length++] = ' ';
         } else {
-            // Convert UTF-32 to UTF-16 (handle surrogate pairs)
-            for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL && currentCell.chars[i]; i++) {
-                uint32_t codepoint = currentCell.chars[i];
-
+            for (int c = 0; c < VTERM_MAX_CHARS_PER_CELL && cell.chars[c]; c++) {
+                uint32_t codepoint = cell.chars[c];
                 if (codepoint <= 0xFFFF) {
-                    chars[runLength++] = (jchar)codepoint;
+                    text[length++] = static_cast<uint16_t>(codepoint);
                 } else {
-                    // Surrogate pair for codepoints > U+FFFF
                     codepoint -= 0x10000;
-                    chars[runLength++] = (jchar)(0xD800 + (codepoint >> 10));
-                    chars[runLength++] = (jchar)(0xDC00 + (codepoint & 0x3FF));
+                    text[length++] = static_cast<uint16_t>(0xD800 + (codepoint >> 10));
+                    text[length++] = static_cast<uint16_t>(0xDC00 + (codepoint & 0x3FF));
                 }
             }
         }
+        mGridCells[i] = { static_cast<uint16_t>(id), static_cast<uint8_t>(cell.width), static_cast<uint8_t>(length) };
 
-        // Skip next column if this is a wide character
-        if (currentCell.width == 2) {
-            c++;
-        }
-    }
-
-    // Resolve colors
-    uint8_t fgRed, fgGreen, fgBlue;
-    uint8_t bgRed, bgGreen, bgBlue;
-    resolveColor(cell.fg, fgRed, fgGreen, fgBlue);
-    resolveColor(cell.bg, bgRed, bgGreen, bgBlue);
-
-    // Set fields
-    env->SetIntField(runObject, mFgRedField, fgRed);
-    env->SetIntField(runObject, mFgGreenField, fgGreen);
-    env->SetIntField(runObject, mFgBlueField, fgBlue);
-    env->SetIntField(runObject, mBgRedField, bgRed);
-    env->SetIntField(runObject, mBgGreenField, bgGreen);
-    env->SetIntField(runObject, mBgBlueField, bgBlue);
-
-    env->SetBooleanField(runObject, mBoldField, cell.attrs.bold);
-    env->SetIntField(runObject, mUnderlineField, cell.attrs.underline);
-    env->SetBooleanField(runObject, mItalicField, cell.attrs.italic);
-    env->SetBooleanField(runObject, mBlinkField, cell.attrs.blink);
-    env->SetBooleanField(runObject, mReverseField, cell.attrs.reverse);
-    env->SetBooleanField(runObject, mStrikeField, cell.attrs.strike);
-    env->SetIntField(runObject, mFontField, cell.attrs.font);
-    env->SetBooleanField(runObject, mDwlField, cell.attrs.dwl);
-    env->SetIntField(runObject, mDhlField, cell.attrs.dhl);
-
-    // Set character array using thread-local pool to eliminate allocations
-    // If this is the first call on this thread, or array is too small, allocate/resize
-    if (tls_charArray == nullptr || tls_charArraySize < runLength) {
-        // Clean up old array if it exists
-        if (tls_charArray != nullptr) {
-            env->DeleteGlobalRef(tls_charArray);
+        // The column a wide character covers has no text of its own
+        if (cell.width == 2 && i + 1 < count) {
+            i++;
+            mGridCells[i] = { static_cast<uint16_t>(id), 0, 0 };
         }
-
-        // Allocate new array with some headroom (round up to nearest 64)
-        jsize newSize = ((runLength + 63) / 64) * 64;
-        jcharArray localArray = env->NewCharArray(newSize);
-        tls_charArray = (jcharArray)env->NewGlobalRef(localArray);
-        env->DeleteLocalRef(localArray);
-        tls_charArraySize = newSize;
-
-        LOGD("Allocated thread-local CharArray: size=%d", newSize);
     }
 
-    // Reuse the thread-local array
-    env->SetCharArrayRegion(tls_charArray, 0, runLength, chars);
-    env->SetObjectField(runObject, mCharsField, tls_charArray);
-
-    env->SetIntField(runObject, mRunLengthField, runLength);
-
-    return runLength;
+    mGrid->writeCells(row, startCol, count, mGridCells.data(), mGridText.data());
+    return complete;
 }
 
 // Callback implementations
 int Terminal::termDamage(VTermRect rect, void* user) {
     auto* term = static_cast<Terminal*>(user);
-    term->invokeDamage(rect.start_row, rect.end_row, rect.start_col, rect.end_col);
+    if (term->mCommandRunning) {
+        term->mCommand.damagedCells += (rect.end_row - rect.start_row) * (rect.end_col - rect.start_col);
+    }
+    if (term->mGrid) {
+        term->mGrid->markDirty(rect.start_row, rect.end_row, rect.start_col, rect.end_col);
+    } else {
+        term->invokeDamage(rect.start_row, rect.end_row, rect.start_col, rect.end_col);
+    }
     return 1;
 }
 
 int Terminal::termMoverect(VTermRect dest, VTermRect src, void* user) {
     auto* term = static_cast<Terminal*>(user);
+    if (term->mGrid) {
+        return 0;  // libvterm damages the destination instead
+    }
     return term->invokeMoverect(dest, src);
 }
 
 int Terminal::termMovecursor(VTermPos pos, VTermPos oldpos, int visible, void* user) {
     auto* term = static_cast<Terminal*>(user);
+    // Moving above the stream's position means the screen was cleared or is
+    // being redrawn; what gets written there next is new output
+    if (term->mOutputTextEnabled && pos.row < term->mOutputTextPos.row &&
+        !term->mOutputTextInPrompt && !term->mOutputTextInAltScreen) {
+        term->resumeOutputText();
+    }
     term->invokeMoveCursor(pos.row, pos.col, oldpos.row, oldpos.col, visible != 0);
     return 1;
 }
 
 int Terminal::termSettermprop(VTermProp prop, VTermValue* val, void* user) {
     auto* term = static_cast<Terminal*>(user);
-    term->invokeSetTermProp(prop, val);
+    if (prop == VTERM_PROP_ALTSCREEN && term->mOutputTextEnabled) {
+        // Full-screen programs redraw in place; their screens are not output.
+        // Leaving restores the cursor to where the stream stopped.
+        if (val->boolean) {
+            term->commitOutputText();
+        }
+        term->mOutputTextInAltScreen = val->boolean;
+    }
+
+    // Strings can arrive in fragments; only a complete one replaces the value
+    PendingProp& pending = term->mPendingProps[prop];
+    if (vterm_get_prop_type(prop) == VTERM_VALUETYPE_STRING) {
+        if (val->string.initial) {
+            pending.partial.clear();
+        }
+        if (val->string.str) {
+            pending.partial.append(val->string.str, val->string.len);
+        }
+        if (!val->string.final) {
+            return 1;
+        }
+        pending.text.swap(pending.partial);
+    } else {
+        pending.value = *val;
+    }
+    term->mChangedProps |= 1u << prop;
     return 1;
 }
 
 int Terminal::termBell(void* user) {
     auto* term = static_cast<Terminal*>(user);
-    term->invokeBell();
+    term->mPendingBells++;
     return 1;
 }
 
-int Terminal::termSbPushline(int cols, const VTermScreenCell* cells, void* user) {
+int Terminal::termSbPushline(int cols, const VTermScreenCell* cells, bool continuation, void* user) {
     auto* term = static_cast<Terminal*>(user);
-    term->invokePushScrollbackLine(cols, cells);
+    if (term->mCommandRunning) {
+        term->mCommand.scrolledLines++;
+    }
+    if (term->mCommandInputPos.row >= 0) {
+        term->mCommandInputPos.row--;
+    }
+    if (term->mOutputTextPos.row > 0) {
+        term->mOutputTextPos.row--;
+    } else if (term->mOutputTextPos.row == 0) {
+        // The row leaves the screen before the next commit. Its lineinfo has
+        // already been scrolled away, so a full row is taken to wrap.
+        if (!term->mOutputTextInPrompt && !term->mOutputTextInAltScreen) {
+            term->appendOutputCells(cells, term->mOutputTextPos.col, cols);
+            uint32_t last = cells[cols - 1].chars[0];
+            if (last == 0 || last == ' ') {
+                term->appendOutputChar('\n');
+            }
+        }
+        term->mOutputTextPos.col = 0;
+    }
+    if (!term->mDropScrollback) {
+        term->invokePushScrollbackLine(cols, cells, continuation);
+    }
     return 1;
 }
 
@@ -530,15 +1630,38 @@ int Terminal::termSbPopline(int cols, VTermScreenCell* cells, void* user) {
     return term->invokePopScrollbackLine(cols, cells);
 }
 
+// CSI 3 J - the scrollback lives on the Java side, so this is a single upcall.
+// It is not deferred to flushEvents(): lines pushed later in the same write
+// must survive it.
+int Terminal::termSbClear(void* user) {
+    auto* term = static_cast<Terminal*>(user);
+    term->invokeClearScrollback();
+    return 1;
+}
+
 void Terminal::termOutput(const char* s, size_t len, void* user) {
     auto* term = static_cast<Terminal*>(user);
-    term->invokeKeyboardOutput(s, len);
+    const auto* data = reinterpret_cast<const uint8_t*>(s);
+
+    if (term->mTransport) {
+        term->mTransport->write(data, len);
+    } else if (term->mOutputCallback) {
+        term->mOutputCallback(data, len, term->mOutputCallbackUser);
+    } else if (term->mOutputSink) {
+        term->mOutputSink->write(data, len);
+    } else {
+        term->invokeKeyboardOutput(s, len);
+    }
 }
 
 // OSC sequence fallback handler
 int Terminal::termOscFallback(int command, VTermStringFragment frag, void* user) {
     auto* term = static_cast<Terminal*>(user);
 
+    if (command == 133) {
+        term->onShellIntegrationMark(frag);
+    }
+
     // Convert VTermStringFragment to std::string
     std::string payload(frag.str, frag.len);
 
@@ -547,7 +1670,7 @@ int Terminal::termOscFallback(int command, VTermStringFragment frag, void* user)
 
 // Java callback invocations
 void Terminal::invokeDamage(int startRow, int endRow, int startCol, int endCol) {
-    if (!mDamageMethod) {
+    if (!sJni.damageMethod) {
         return;
     }
 
@@ -556,11 +1679,11 @@ void Terminal::invokeDamage(int startRow, int endRow, int startCol, int endCol)
         return;
     }
 
-    env->CallIntMethod(mCallbacks, mDamageMethod, startRow, endRow, startCol, endCol);
+    env->CallIntMethod(mCallbacks, sJni.damageMethod, startRow, endRow, startCol, endCol);
 }
 
 int Terminal::invokeMoverect(VTermRect dest, VTermRect src) {
-    if (!mMoverectMethod) {
+    if (!sJni.moverectMethod) {
         return 0;
     }
 
@@ -570,13 +1693,13 @@ int Terminal::invokeMoverect(VTermRect dest, VTermRect src) {
     }
 
     // Create dest and src TermRect objects using cached class/constructor
-    jobject destObj = env->NewObject(mTermRectClass, mTermRectConstructor,
+    jobject destObj = env->NewObject(sJni.termRectClass, sJni.termRectConstructor,
         dest.start_row, dest.end_row, dest.start_col, dest.end_col);
-    jobject srcObj = env->NewObject(mTermRectClass, mTermRectConstructor,
+    jobject srcObj = env->NewObject(sJni.termRectClass, sJni.termRectConstructor,
         src.start_row, src.end_row, src.start_col, src.end_col);
 
     // Call the moverect callback
-    jint result = env->CallIntMethod(mCallbacks, mMoverectMethod, destObj, srcObj);
+    jint result = env->CallIntMethod(mCallbacks, sJni.moverectMethod, destObj, srcObj);
 
     // Clean up
     env->DeleteLocalRef(destObj);
@@ -586,7 +1709,7 @@ int Terminal::invokeMoverect(VTermRect dest, VTermRect src) {
 }
 
 void Terminal::invokeMoveCursor(int row, int col, int oldRow, int oldCol, bool visible) {
-    if (!mMoveCursorMethod) {
+    if (!sJni.moveCursorMethod) {
         return;
     }
 
@@ -596,17 +1719,17 @@ void Terminal::invokeMoveCursor(int row, int col, int oldRow, int oldCol, bool v
     }
 
     // Create CursorPosition objects using cached class/constructor
-    jobject posObj = env->NewObject(mCursorPositionClass, mCursorPositionConstructor, row, col);
-    jobject oldPosObj = env->NewObject(mCursorPositionClass, mCursorPositionConstructor, oldRow, oldCol);
+    jobject posObj = env->NewObject(sJni.cursorPositionClass, sJni.cursorPositionConstructor, row, col);
+    jobject oldPosObj = env->NewObject(sJni.cursorPositionClass, sJni.cursorPositionConstructor, oldRow, oldCol);
 
-    env->CallIntMethod(mCallbacks, mMoveCursorMethod, posObj, oldPosObj, visible);
+    env->CallIntMethod(mCallbacks, sJni.moveCursorMethod, posObj, oldPosObj, visible);
 
     env->DeleteLocalRef(posObj);
     env->DeleteLocalRef(oldPosObj);
 }
 
 void Terminal::invokeSetTermProp(VTermProp prop, VTermValue* val) {
-    if (!mSetTermPropMethod) {
+    if (!sJni.setTermPropMethod) {
         return;
     }
 
@@ -619,11 +1742,11 @@ void Terminal::invokeSetTermProp(VTermProp prop, VTermValue* val) {
 
     switch (vterm_get_prop_type(prop)) {
         case VTERM_VALUETYPE_BOOL:
-            propValue = env->NewObject(mTerminalPropertyBoolClass, mTerminalPropertyBoolConstructor, val->boolean);
+            propValue = env->NewObject(sJni.terminalPropertyBoolClass, sJni.terminalPropertyBoolConstructor, val->boolean);
             break;
 
         case VTERM_VALUETYPE_INT:
-            propValue = env->NewObject(mTerminalPropertyIntClass, mTerminalPropertyIntConstructor, val->number);
+            propValue = env->NewObject(sJni.terminalPropertyIntClass, sJni.terminalPropertyIntConstructor, val->number);
             break;
 
         case VTERM_VALUETYPE_STRING:
@@ -631,7 +1754,7 @@ void Terminal::invokeSetTermProp(VTermProp prop, VTermValue* val) {
                 // VTermStringFragment has str and len fields
                 char* utf8_str = mutf8_to_utf8(val->string.str, val->string.len, nullptr);
                 jstring str = env->NewStringUTF(utf8_str);
-                propValue = env->NewObject(mTerminalPropertyStringClass, mTerminalPropertyStringConstructor, str);
+                propValue = env->NewObject(sJni.terminalPropertyStringClass, sJni.terminalPropertyStringConstructor, str);
                 env->DeleteLocalRef(str);
                 free(utf8_str);
             }
@@ -641,7 +1764,7 @@ void Terminal::invokeSetTermProp(VTermProp prop, VTermValue* val) {
             // Resolve color to RGB
             uint8_t r, g, b;
             resolveColor(val->color, r, g, b);
-            propValue = env->NewObject(mTerminalPropertyColorClass, mTerminalPropertyColorConstructor, r, g, b);
+            propValue = env->NewObject(sJni.terminalPropertyColorClass, sJni.terminalPropertyColorConstructor, r, g, b);
             break;
         }
 
@@ -651,13 +1774,13 @@ void Terminal::invokeSetTermProp(VTermProp prop, VTermValue* val) {
     }
 
     if (propValue) {
-        env->CallIntMethod(mCallbacks, mSetTermPropMethod, prop, propValue);
+        env->CallIntMethod(mCallbacks, sJni.setTermPropMethod, prop, propValue);
         env->DeleteLocalRef(propValue);
     }
 }
 
-void Terminal::invokeBell() {
-    if (!mBellMethod) {
+void Terminal::invokeBell(int count) {
+    if (!sJni.bellMethod) {
         return;
     }
 
@@ -666,11 +1789,11 @@ void Terminal::invokeBell() {
         return;
     }
 
-    env->CallIntMethod(mCallbacks, mBellMethod);
+    env->CallIntMethod(mCallbacks, sJni.bellMethod, count);
 }
 
-void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells) {
-    if (!mPushScrollbackMethod) {
+void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells, bool continuation) {
+    if (!sJni.pushScrollbackMethod) {
         return;
     }
 
@@ -679,15 +1802,28 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
         return;
     }
 
-    // Build a list to hold actual cells (excluding fullwidth placeholders)
-    std::vector<jobject> screenCells;
-
+    // One element per character, excluding fullwidth placeholders
+    int actualCells = 0;
     for (int i = 0; i < cols; i++) {
+        actualCells++;
+        if (cells[i].width == 2) {
+            i++;
+        }
+    }
+
+    // Cells are stored as they are built, so wide rows never hold more than
+    // a few local references at once
+    jobjectArray actualCellArray = env->NewObjectArray(actualCells, sJni.screenCellClass, nullptr);
+    if (!actualCellArray) {
+        return;
+    }
+
+    for (int i = 0, index = 0; i < cols; i++) {
         const VTermScreenCell& cell = cells[i];
 
         // Get the primary character and handle surrogate pairs
         jchar primaryChar = ' ';
-        jobject combiningList = env->NewObject(mArrayListClass, mArrayListConstructor);
+        jobject combiningList = env->NewObject(sJni.arrayListClass, sJni.arrayListConstructor);
 
         if (cell.chars[0] != 0) {
             uint32_t codepoint = cell.chars[0];
@@ -702,8 +1838,8 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
                 jchar lowSurrogate = (jchar)(0xDC00 + (codepoint & 0x3FF));  // Low surrogate
 
                 // Add low surrogate to combining chars
-                jobject lowSurrogateObj = env->CallStaticObjectMethod(mCharacterClass, mCharacterValueOf, lowSurrogate);
-                env->CallBooleanMethod(combiningList, mArrayListAdd, lowSurrogateObj);
+                jobject lowSurrogateObj = env->CallStaticObjectMethod(sJni.characterClass, sJni.characterValueOf, lowSurrogate);
+                env->CallBooleanMethod(combiningList, sJni.arrayListAdd, lowSurrogateObj);
                 env->DeleteLocalRef(lowSurrogateObj);
             }
 
@@ -712,8 +1848,8 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
                 uint32_t combiningCodepoint = cell.chars[j];
 
                 if (combiningCodepoint <= 0xFFFF) {
-                    jobject charObj = env->CallStaticObjectMethod(mCharacterClass, mCharacterValueOf, (jchar)combiningCodepoint);
-                    env->CallBooleanMethod(combiningList, mArrayListAdd, charObj);
+                    jobject charObj = env->CallStaticObjectMethod(sJni.characterClass, sJni.characterValueOf, (jchar)combiningCodepoint);
+                    env->CallBooleanMethod(combiningList, sJni.arrayListAdd, charObj);
                     env->DeleteLocalRef(charObj);
                 } else {
                     // Combining character is also a surrogate pair
@@ -721,12 +1857,12 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
                     jchar highSurr = (jchar)(0xD800 + (combiningCodepoint >> 10));
                     jchar lowSurr = (jchar)(0xDC00 + (combiningCodepoint & 0x3FF));
 
-                    jobject highObj = env->CallStaticObjectMethod(mCharacterClass, mCharacterValueOf, highSurr);
-                    env->CallBooleanMethod(combiningList, mArrayListAdd, highObj);
+                    jobject highObj = env->CallStaticObjectMethod(sJni.characterClass, sJni.characterValueOf, highSurr);
+                    env->CallBooleanMethod(combiningList, sJni.arrayListAdd, highObj);
                     env->DeleteLocalRef(highObj);
 
-                    jobject lowObj = env->CallStaticObjectMethod(mCharacterClass, mCharacterValueOf, lowSurr);
-                    env->CallBooleanMethod(combiningList, mArrayListAdd, lowObj);
+                    jobject lowObj = env->CallStaticObjectMethod(sJni.characterClass, sJni.characterValueOf, lowSurr);
+                    env->CallBooleanMethod(combiningList, sJni.arrayListAdd, lowObj);
                     env->DeleteLocalRef(lowObj);
                 }
             }
@@ -742,7 +1878,7 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
         // Signature: (CLjava/util/List;IIIIIIZZIZZI)V
         // Parameters: char, combiningChars, fgRed, fgGreen, fgBlue, bgRed, bgGreen, bgBlue,
         //             bold, italic, underline, reverse, strike, width
-        jobject screenCell = env->NewObject(mScreenCellClass, mScreenCellConstructor,
+        jobject screenCell = env->NewObject(sJni.screenCellClass, sJni.screenCellConstructor,
             primaryChar,                    // char
             combiningList,                  // combiningChars: List<Char>
             (jint)fgRed,                    // fgRed
@@ -759,8 +1895,8 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
             (jint)cell.width                // width (I)
         );
 
-        // Add to vector (will be converted to array later)
-        screenCells.push_back(screenCell);
+        env->SetObjectArrayElement(actualCellArray, index++, screenCell);
+        env->DeleteLocalRef(screenCell);
         env->DeleteLocalRef(combiningList);
 
         // Skip next cell if this is a fullwidth character
@@ -769,79 +1905,53 @@ void Terminal::invokePushScrollbackLine(int cols, const VTermScreenCell* cells)
         }
     }
 
-    // Create array with actual cell count
-    int actualCells = screenCells.size();
-    jobjectArray actualCellArray = env->NewObjectArray(actualCells, mScreenCellClass, nullptr);
-    for (int i = 0; i < actualCells; i++) {
-        env->SetObjectArrayElement(actualCellArray, i, screenCells[i]);
-        env->DeleteLocalRef(screenCells[i]);
-    }
-
     // Call the Java callback with actual cell count
-    env->CallIntMethod(mCallbacks, mPushScrollbackMethod, actualCells, actualCellArray);
+    env->CallIntMethod(mCallbacks, sJni.pushScrollbackMethod, actualCells, actualCellArray,
+                       static_cast<jboolean>(continuation));
 
     // Clean up only the array (classes are cached globally)
     env->DeleteLocalRef(actualCellArray);
 }
 
-int Terminal::invokePopScrollbackLine(int cols, VTermScreenCell* cells) {
-    if (!mPopScrollbackMethod) {
-        return 0;
+void Terminal::invokeClearScrollback() {
+    if (!sJni.clearScrollbackMethod) {
+        return;
     }
 
     JNIEnv* env;
     if (mJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return;
+    }
+
+    env->CallIntMethod(mCallbacks, sJni.clearScrollbackMethod);
+}
+
+int Terminal::invokePopScrollbackLine(int cols, VTermScreenCell* cells) {
+    if (!sJni.popScrollbackMethod) {
         return 0;
     }
 
-    // Find ScreenCell class
-    jclass screenCellClass = env->FindClass("org/connectbot/terminal/ScreenCell");
-    if (!screenCellClass) {
-        LOGE("Failed to find ScreenCell class");
+    JNIEnv* env;
+    if (mJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
         return 0;
     }
 
     // Create array for cells
-    jobjectArray cellArray = env->NewObjectArray(cols, screenCellClass, nullptr);
+    jobjectArray cellArray = env->NewObjectArray(cols, sJni.screenCellClass, nullptr);
     if (!cellArray) {
         LOGE("Failed to create cell array");
-        env->DeleteLocalRef(screenCellClass);
         return 0;
     }
 
     // Call the Java callback to fill the array
-    jint result = env->CallIntMethod(mCallbacks, mPopScrollbackMethod, cols, cellArray);
+    jint result = env->CallIntMethod(mCallbacks, sJni.popScrollbackMethod, cols, cellArray);
 
     if (result == 0) {
         // No scrollback available
         env->DeleteLocalRef(cellArray);
-        env->DeleteLocalRef(screenCellClass);
         return 0;
     }
 
-    // Get field IDs for ScreenCell
-    jfieldID charField = env->GetFieldID(screenCellClass, "char", "C");
-    jfieldID combiningCharsField = env->GetFieldID(screenCellClass, "combiningChars", "Ljava/util/List;");
-    jfieldID fgRedField = env->GetFieldID(screenCellClass, "fgRed", "I");
-    jfieldID fgGreenField = env->GetFieldID(screenCellClass, "fgGreen", "I");
-    jfieldID fgBlueField = env->GetFieldID(screenCellClass, "fgBlue", "I");
-    jfieldID bgRedField = env->GetFieldID(screenCellClass, "bgRed", "I");
-    jfieldID bgGreenField = env->GetFieldID(screenCellClass, "bgGreen", "I");
-    jfieldID bgBlueField = env->GetFieldID(screenCellClass, "bgBlue", "I");
-    jfieldID boldField = env->GetFieldID(screenCellClass, "bold", "Z");
-    jfieldID italicField = env->GetFieldID(screenCellClass, "italic", "Z");
-    jfieldID underlineField = env->GetFieldID(screenCellClass, "underline", "I");
-    jfieldID reverseField = env->GetFieldID(screenCellClass, "reverse", "Z");
-    jfieldID strikeField = env->GetFieldID(screenCellClass, "strike", "Z");
-    jfieldID widthField = env->GetFieldID(screenCellClass, "width", "I");
-
-    // Get List methods for combining chars
-    jclass listClass = env->FindClass("java/util/List");
-    jmethodID listSize = env->GetMethodID(listClass, "size", "()I");
-    jmethodID listGet = env->GetMethodID(listClass, "get", "(I)Ljava/lang/Object;");
-    jclass charClass = env->FindClass("java/lang/Character");
-    jmethodID charValue = env->GetMethodID(charClass, "charValue", "()C");
-
     // Convert Java ScreenCell array to VTermScreenCell
     for (int i = 0; i < cols; i++) {
         jobject screenCell = env->GetObjectArrayElement(cellArray, i);
@@ -866,18 +1976,18 @@ int Terminal::invokePopScrollbackLine(int cols, VTermScreenCell* cells) {
         VTermScreenCell& cell = cells[i];
 
         // Get primary character
-        jchar primaryChar = env->GetCharField(screenCell, charField);
+        jchar primaryChar = env->GetCharField(screenCell, sJni.screenCellChar);
         cell.chars[0] = primaryChar;
 
         // Get combining characters
-        jobject combiningList = env->GetObjectField(screenCell, combiningCharsField);
+        jobject combiningList = env->GetObjectField(screenCell, sJni.screenCellCombiningChars);
         int charIndex = 1;
         if (combiningList) {
-            jint listLen = env->CallIntMethod(combiningList, listSize);
+            jint listLen = env->CallIntMethod(combiningList, sJni.listSize);
             for (int j = 0; j < listLen && charIndex < VTERM_MAX_CHARS_PER_CELL; j++) {
-                jobject charObj = env->CallObjectMethod(combiningList, listGet, j);
+                jobject charObj = env->CallObjectMethod(combiningList, sJni.listGet, j);
                 if (charObj) {
-                    jchar ch = env->CallCharMethod(charObj, charValue);
+                    jchar ch = env->CallCharMethod(charObj, sJni.characterCharValue);
                     cell.chars[charIndex++] = ch;
                     env->DeleteLocalRef(charObj);
                 }
@@ -889,37 +1999,34 @@ int Terminal::invokePopScrollbackLine(int cols, VTermScreenCell* cells) {
         }
 
         // Get colors
-        uint8_t fgRed = env->GetIntField(screenCell, fgRedField);
-        uint8_t fgGreen = env->GetIntField(screenCell, fgGreenField);
-        uint8_t fgBlue = env->GetIntField(screenCell, fgBlueField);
-        uint8_t bgRed = env->GetIntField(screenCell, bgRedField);
-        uint8_t bgGreen = env->GetIntField(screenCell, bgGreenField);
-        uint8_t bgBlue = env->GetIntField(screenCell, bgBlueField);
+        uint8_t fgRed = env->GetIntField(screenCell, sJni.screenCellFgRed);
+        uint8_t fgGreen = env->GetIntField(screenCell, sJni.screenCellFgGreen);
+        uint8_t fgBlue = env->GetIntField(screenCell, sJni.screenCellFgBlue);
+        uint8_t bgRed = env->GetIntField(screenCell, sJni.screenCellBgRed);
+        uint8_t bgGreen = env->GetIntField(screenCell, sJni.screenCellBgGreen);
+        uint8_t bgBlue = env->GetIntField(screenCell, sJni.screenCellBgBlue);
         vterm_color_rgb(&cell.fg, fgRed, fgGreen, fgBlue);
         vterm_color_rgb(&cell.bg, bgRed, bgGreen, bgBlue);
 
         // Get attributes
-        cell.attrs.bold = env->GetBooleanField(screenCell, boldField);
-        cell.attrs.italic = env->GetBooleanField(screenCell, italicField);
-        cell.attrs.underline = env->GetIntField(screenCell, underlineField);
-        cell.attrs.reverse = env->GetBooleanField(screenCell, reverseField);
-        cell.attrs.strike = env->GetBooleanField(screenCell, strikeField);
-        cell.width = env->GetIntField(screenCell, widthField);
+        cell.attrs.bold = env->GetBooleanField(screenCell, sJni.screenCellBold);
+        cell.attrs.italic = env->GetBooleanField(screenCell, sJni.screenCellItalic);
+        cell.attrs.underline = env->GetIntField(screenCell, sJni.screenCellUnderline);
+        cell.attrs.reverse = env->GetBooleanField(screenCell, sJni.screenCellReverse);
+        cell.attrs.strike = env->GetBooleanField(screenCell, sJni.screenCellStrike);
+        cell.width = env->GetIntField(screenCell, sJni.screenCellWidth);
 
         env->DeleteLocalRef(screenCell);
     }
 
     // Clean up
     env->DeleteLocalRef(cellArray);
-    env->DeleteLocalRef(screenCellClass);
-    env->DeleteLocalRef(listClass);
-    env->DeleteLocalRef(charClass);
 
     return 1;
 }
 
 void Terminal::invokeKeyboardOutput(const char* data, size_t len) {
-    if (!mKeyboardInputMethod) {
+    if (!sJni.keyboardInputMethod) {
         return;
     }
 
@@ -931,13 +2038,26 @@ void Terminal::invokeKeyboardOutput(const char* data, size_t len) {
     jbyteArray array = env->NewByteArray(len);
     env->SetByteArrayRegion(array, 0, len, reinterpret_cast<const jbyte*>(data));
 
-    env->CallIntMethod(mCallbacks, mKeyboardInputMethod, array);
+    env->CallIntMethod(mCallbacks, sJni.keyboardInputMethod, array);
 
     env->DeleteLocalRef(array);
 }
 
+void Terminal::invokeTransportClosed(int exitCode) {
+    if (!sJni.transportClosedMethod) {
+        return;
+    }
+
+    JNIEnv* env;
+    if (mJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return;
+    }
+
+    env->CallIntMethod(mCallbacks, sJni.transportClosedMethod, exitCode);
+}
+
 int Terminal::invokeOscSequence(int command, const std::string& payload) {
-    if (!mOscSequenceMethod) {
+    if (!sJni.oscSequenceMethod) {
         return 0;
     }
 
@@ -954,7 +2074,7 @@ int Terminal::invokeOscSequence(int command, const std::string& payload) {
     }
 
     // Call the Java callback
-    jint result = env->CallIntMethod(mCallbacks, mOscSequenceMethod, command, payloadStr);
+    jint result = env->CallIntMethod(mCallbacks, sJni.oscSequenceMethod, command, payloadStr);
 
     // Clean up
     env->DeleteLocalRef(payloadStr);
@@ -977,6 +2097,17 @@ bool Terminal::cellStyleEqual(const VTermScreenCell& a, const VTermScreenCell& b
            a.attrs.dhl == b.attrs.dhl;
 }
 
+int32_t Terminal::cellFlags(const VTermScreenCell& cell) {
+    int32_t flags = 0;
+    if (cell.attrs.bold) flags |= CELL_RUN_BOLD;
+    if (cell.attrs.italic) flags |= CELL_RUN_ITALIC;
+    if (cell.attrs.blink) flags |= CELL_RUN_BLINK;
+    if (cell.attrs.reverse) flags |= CELL_RUN_REVERSE;
+    if (cell.attrs.strike) flags |= CELL_RUN_STRIKE;
+    if (cell.attrs.dwl) flags |= CELL_RUN_DWL;
+    return flags;
+}
+
 void Terminal::resolveColor(const VTermColor& color, uint8_t& r, uint8_t& g, uint8_t& b) {
     if (VTERM_COLOR_IS_INDEXED(&color)) {
         // Get color from palette
@@ -1012,15 +2143,69 @@ void Terminal::resolveColor(const VTermColor& color, uint8_t& r, uint8_t& g, uin
     }
 }
 
+int Terminal::paletteIndex(const VTermColor& color) {
+    // Default flags take precedence: a default color also carries its RGB value
+    if (VTERM_COLOR_IS_DEFAULT_FG(&color)) {
+        return PALETTE_DEFAULT_FG;
+    } else if (VTERM_COLOR_IS_DEFAULT_BG(&color)) {
+        return PALETTE_DEFAULT_BG;
+    } else if (VTERM_COLOR_IS_INDEXED(&color)) {
+        return color.indexed.idx;
+    }
+    return PALETTE_DIRECT;
+}
+
+// Palette export
+int Terminal::getPalette(uint32_t* colors, int count) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    if (!mVt) {
+        LOGE("getPalette: VTerm not initialized");
+        return -1;
+    }
+
+    VTermState* state = vterm_obtain_state(mVt);
+    VTermColor defaultFg, defaultBg;
+    vterm_state_get_default_colors(state, &defaultFg, &defaultBg);
+
+    int colorCount = std::min(count, static_cast<int>(PALETTE_SIZE));
+
+    for (int i = 0; i < colorCount; i++) {
+        VTermColor color;
+        if (i == PALETTE_DEFAULT_FG) {
+            color = defaultFg;
+        } else if (i == PALETTE_DEFAULT_BG) {
+            color = defaultBg;
+        } else {
+            vterm_state_get_palette_color(state, i, &color);
+        }
+
+        // Back to Android ARGB with full alpha
+        colors[i] = 0xFF000000u |
+                    (static_cast<uint32_t>(color.rgb.red) << 16) |
+                    (static_cast<uint32_t>(color.rgb.green) << 8) |
+                    static_cast<uint32_t>(color.rgb.blue);
+    }
+
+    return colorCount;
+}
+
 // JNI function implementations
 extern "C" {
 
 JNIEXPORT jlong JNICALL
-Java_org_connectbot_terminal_TerminalNative_nativeInit(JNIEnv* env, jobject /* thiz */, jobject callbacks) {
-    auto* term = new Terminal(env, callbacks);
+Java_org_connectbot_terminal_TerminalNative_nativeInit(JNIEnv* env, jobject /* thiz */, jobject callbacks,
+                                                       jint rows, jint cols) {
+    auto* term = new Terminal(env, callbacks, rows, cols);
     return reinterpret_cast<jlong>(term);
 }
 
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativePrewarm(JNIEnv* /* env */, jclass /* clazz */,
+                                                          jint rows, jint cols, jint count) {
+    return Terminal::prewarm(rows, cols, count);
+}
+
 JNIEXPORT jint JNICALL
 Java_org_connectbot_terminal_TerminalNative_nativeDestroy(JNIEnv* /* env */, jobject /* thiz */, jlong ptr) {
     auto* term = reinterpret_cast<Terminal*>(ptr);
@@ -1058,6 +2243,78 @@ Java_org_connectbot_terminal_TerminalNative_nativeResize(JNIEnv* /* env */, jobj
     return term->resize(rows, cols);
 }
 
+// Java String to standard UTF-8
+static std::string toUtf8(JNIEnv* env, jstring string) {
+    if (!string) {
+        return {};
+    }
+
+    const char* chars = env->GetStringUTFChars(string, nullptr);
+    if (!chars) {
+        return {};
+    }
+
+    std::string result;
+    size_t length = 0;
+    char* utf8 = mutf8_to_utf8(chars, strlen(chars), &length);
+    if (utf8) {
+        result.assign(utf8, length);
+        free(utf8);
+    }
+    env->ReleaseStringUTFChars(string, chars);
+    return result;
+}
+
+static std::vector<std::string> toUtf8Array(JNIEnv* env, jobjectArray strings) {
+    std::vector<std::string> result;
+    if (!strings) {
+        return result;
+    }
+
+    jsize count = env->GetArrayLength(strings);
+    result.reserve(count);
+    for (jsize i = 0; i < count; i++) {
+        auto string = static_cast<jstring>(env->GetObjectArrayElement(strings, i));
+        result.push_back(toUtf8(env, string));
+        env->DeleteLocalRef(string);
+    }
+    return result;
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeStartProcess(JNIEnv* env, jobject /* thiz */, jlong ptr,
+                                                               jobjectArray argv, jobjectArray envp, jstring cwd) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->startProcess(toUtf8Array(env, argv), toUtf8Array(env, envp), toUtf8(env, cwd));
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeBindLoopback(JNIEnv* /* env */, jobject /* thiz */, jlong ptr) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->bindLoopback();
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeSetSizeLocked(JNIEnv* /* env */, jobject /* thiz */,
+                                                                jlong ptr, jboolean locked) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->setSizeLocked(locked);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeSetEncoding(JNIEnv* /* env */, jobject /* thiz */,
+                                                              jlong ptr, jint encoding) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->setEncoding(encoding);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeSetOutputFd(JNIEnv* /* env */, jobject /* thiz */,
+                                                              jlong ptr, jint fd) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->setOutputFd(fd);
+}
+
 JNIEXPORT jboolean JNICALL
 Java_org_connectbot_terminal_TerminalNative_nativeDispatchKey(JNIEnv* /* env */, jobject /* thiz */,
                                                               jlong ptr, jint modifiers, jint key) {
@@ -1073,10 +2330,136 @@ Java_org_connectbot_terminal_TerminalNative_nativeDispatchCharacter(JNIEnv* /* e
 }
 
 JNIEXPORT jint JNICALL
-Java_org_connectbot_terminal_TerminalNative_nativeGetCellRun(JNIEnv* env, jobject /* thiz */,
-                                                             jlong ptr, jint row, jint col, jobject runObject) {
+Java_org_connectbot_terminal_TerminalNative_nativeSetCellRunBuffer(JNIEnv* env, jobject /* thiz */,
+                                                                   jlong ptr, jobject buffer) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    if (!buffer) {
+        return term->setCellRunBuffer(nullptr, 0);
+    }
+
+    void* address = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!address || capacity < 0) {
+        return -1;
+    }
+    return term->setCellRunBuffer(address, static_cast<size_t>(capacity));
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGetCellRun(JNIEnv* /* env */, jobject /* thiz */,
+                                                             jlong ptr, jint row, jint col, jint endCol) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->getCellRun(row, col, endCol);
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGetGridBuffer(JNIEnv* env, jobject /* thiz */, jlong ptr) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+
+    uint8_t* data;
+    size_t size;
+    if (!term->enableGrid(&data, &size)) {
+        return nullptr;
+    }
+    return env->NewDirectByteBuffer(data, static_cast<jlong>(size));
+}
+
+// @CriticalNative, and lock-free so a frame being written never blocks the
+// reader; the atomics also order the reader's plain loads of the mapping
+JNIEXPORT jlong JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGridReadBegin(jlong ptr) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return static_cast<jlong>(term->gridReadBegin());
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGridReadValidate(jlong ptr, jlong sequence) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->gridReadValidate(static_cast<uint64_t>(sequence));
+}
+
+static jlong nativeGridReadBeginCompat(JNIEnv* /* env */, jclass /* clazz */, jlong ptr) {
+    return Java_org_connectbot_terminal_TerminalNative_nativeGridReadBegin(ptr);
+}
+
+static jboolean nativeGridReadValidateCompat(JNIEnv* /* env */, jclass /* clazz */,
+                                             jlong ptr, jlong sequence) {
+    return Java_org_connectbot_terminal_TerminalNative_nativeGridReadValidate(ptr, sequence);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeBlinkTick(JNIEnv* /* env */, jobject /* thiz */, jlong ptr) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return term->blinkTick();
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGetSelectExtent(JNIEnv* env, jobject /* thiz */,
+                                                                  jlong ptr, jint row, jint col, jint mode,
+                                                                  jintArray extent) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+
+    if (env->GetArrayLength(extent) < 4) {
+        LOGE("nativeGetSelectExtent: extent array too small");
+        return JNI_FALSE;
+    }
+
+    int values[4];
+    if (!term->getSelectExtent(row, col, mode, values)) {
+        return JNI_FALSE;
+    }
+
+    env->SetIntArrayRegion(extent, 0, 4, values);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeSetProfiling(JNIEnv* /* env */, jobject /* thiz */,
+                                                               jlong ptr, jint sampleEvery) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    term->setProfiling(sampleEvery);
+}
+
+JNIEXPORT void JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeSetParallelParsing(JNIEnv* /* env */, jobject /* thiz */,
+                                                                     jlong ptr, jint threads) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    term->setParallelParsing(threads);
+}
+
+JNIEXPORT void JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeSetScrollbackLimit(JNIEnv* /* env */, jobject /* thiz */,
+                                                                     jlong ptr, jint lines) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    term->setScrollbackLimit(lines);
+}
+
+JNIEXPORT jstring JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGetProfileReport(JNIEnv* env, jobject /* thiz */, jlong ptr) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+    return env->NewStringUTF(term->getProfileReport().c_str());
+}
+
+JNIEXPORT jstring JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeReadOutputText(JNIEnv* env, jobject /* thiz */,
+                                                                 jlong ptr, jlongArray cursorArray) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+
+    jlong cursor;
+    env->GetLongArrayRegion(cursorArray, 0, 1, &cursor);
+    if (env->ExceptionCheck()) {
+        return nullptr;
+    }
+
+    jstring text = term->readOutputText(env, &cursor);
+    env->SetLongArrayRegion(cursorArray, 0, 1, &cursor);
+    return text;
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGetCommandStats(JNIEnv* env, jobject /* thiz */, jlong ptr) {
     auto* term = reinterpret_cast<Terminal*>(ptr);
-    return term->getCellRun(env, row, col, runObject);
+    return term->getCommandStats(env);
 }
 
 JNIEXPORT jint JNICALL
@@ -1100,6 +2483,26 @@ Java_org_connectbot_terminal_TerminalNative_nativeSetPaletteColors(JNIEnv* env,
     return result;
 }
 
+JNIEXPORT jint JNICALL
+Java_org_connectbot_terminal_TerminalNative_nativeGetPalette(JNIEnv* env, jobject /* thiz */,
+                                                             jlong ptr, jintArray colors) {
+    auto* term = reinterpret_cast<Terminal*>(ptr);
+
+    jsize count = env->GetArrayLength(colors);
+    jint* colorData = env->GetIntArrayElements(colors, nullptr);
+    if (!colorData) {
+        LOGE("nativeGetPalette: Failed to get array elements");
+        return -1;
+    }
+
+    int result = term->getPalette(reinterpret_cast<uint32_t*>(colorData), count);
+
+    // Copy back the exported palette
+    env->ReleaseIntArrayElements(colors, colorData, 0);
+
+    return result;
+}
+
 JNIEXPORT jint JNICALL
 Java_org_connectbot_terminal_TerminalNative_nativeSetDefaultColors(JNIEnv* /* env */, jobject /* thiz */,
                                                                    jlong ptr, jint fgColor, jint bgColor) {
@@ -1107,4 +2510,92 @@ Java_org_connectbot_terminal_TerminalNative_nativeSetDefaultColors(JNIEnv* /* en
     return term->setDefaultColors(static_cast<uint32_t>(fgColor), static_cast<uint32_t>(bgColor));
 }
 
+#define NATIVE_METHOD(name, signature) \
+    { #name, signature, reinterpret_cast<void*>(Java_org_connectbot_terminal_TerminalNative_##name) }
+
+static const JNINativeMethod sTerminalNativeMethods[] = {
+    NATIVE_METHOD(nativeInit, "(Lorg/connectbot/terminal/TerminalCallbacks;II)J"),
+    NATIVE_METHOD(nativePrewarm, "(III)I"),
+    NATIVE_METHOD(nativeDestroy, "(J)I"),
+    NATIVE_METHOD(nativeWriteInputBuffer, "(JLjava/nio/ByteBuffer;I)I"),
+    NATIVE_METHOD(nativeWriteInputArray, "(J[BII)I"),
+    NATIVE_METHOD(nativeResize, "(JII)I"),
+    NATIVE_METHOD(nativeSetSizeLocked, "(JZ)I"),
+    NATIVE_METHOD(nativeStartProcess, "(J[Ljava/lang/String;[Ljava/lang/String;Ljava/lang/String;)I"),
+    NATIVE_METHOD(nativeBindLoopback, "(J)I"),
+    NATIVE_METHOD(nativeSetOutputFd, "(JI)I"),
+    NATIVE_METHOD(nativeSetEncoding, "(JI)I"),
+    NATIVE_METHOD(nativeDispatchKey, "(JII)Z"),
+    NATIVE_METHOD(nativeDispatchCharacter, "(JII)Z"),
+    NATIVE_METHOD(nativeSetCellRunBuffer, "(JLjava/nio/ByteBuffer;)I"),
+    NATIVE_METHOD(nativeGetCellRun, "(JIII)I"),
+    NATIVE_METHOD(nativeGetGridBuffer, "(J)Ljava/nio/ByteBuffer;"),
+    NATIVE_METHOD(nativeGridReadBegin, "(J)J"),
+    NATIVE_METHOD(nativeGridReadValidate, "(JJ)Z"),
+    NATIVE_METHOD(nativeBlinkTick, "(J)I"),
+    NATIVE_METHOD(nativeGetSelectExtent, "(JIII[I)Z"),
+    NATIVE_METHOD(nativeSetProfiling, "(JI)V"),
+    NATIVE_METHOD(nativeGetProfileReport, "(J)Ljava/lang/String;"),
+    NATIVE_METHOD(nativeSetParallelParsing, "(JI)V"),
+    NATIVE_METHOD(nativeSetScrollbackLimit, "(JI)V"),
+    NATIVE_METHOD(nativeGetCommandStats, "(J)[Lorg/connectbot/terminal/CommandCost;"),
+    NATIVE_METHOD(nativeReadOutputText, "(J[J)Ljava/lang/String;"),
+    NATIVE_METHOD(nativeSetPaletteColors, "(J[II)I"),
+    NATIVE_METHOD(nativeGetPalette, "(J[I)I"),
+    NATIVE_METHOD(nativeSetDefaultColors, "(JII)I"),
+};
+
+#undef NATIVE_METHOD
+
+// @CriticalNative takes effect from API 26; older releases ignore the
+// annotation and call those methods with the usual JNIEnv and class
+static bool hasCriticalNative() {
+    char sdk[PROP_VALUE_MAX] = {};
+    __system_property_get("ro.build.version.sdk", sdk);
+    return atoi(sdk) >= 26;
+}
+
+// Library load: cache JNI IDs for all sessions and bind the natives directly
+// instead of leaving the VM to resolve each symbol by name on first call.
+// @CriticalNative methods can only be bound this way before API 31.
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* /* reserved */) {
+    JNIEnv* env;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    if (!Terminal::loadJniCache(env)) {
+        return JNI_ERR;
+    }
+
+    std::vector<JNINativeMethod> methods(std::begin(sTerminalNativeMethods), std::end(sTerminalNativeMethods));
+    if (!hasCriticalNative()) {
+        for (auto& method : methods) {
+            if (strcmp(method.name, "nativeGridReadBegin") == 0) {
+                method.fnPtr = reinterpret_cast<void*>(nativeGridReadBeginCompat);
+            } else if (strcmp(method.name, "nativeGridReadValidate") == 0) {
+                method.fnPtr = reinterpret_cast<void*>(nativeGridReadValidateCompat);
+            }
+        }
+    }
+
+    // No fallback to lookup by name: it cannot bind @CriticalNative methods
+    // before API 31, and before API 26 the grid reads would get JNIEnv* as ptr
+    jclass nativeClass = env->FindClass("org/connectbot/terminal/TerminalNative");
+    if (!nativeClass) {
+        LOGE("JNI_OnLoad: TerminalNative not found");
+        env->ExceptionClear();
+        return JNI_ERR;
+    }
+    jint registered = env->RegisterNatives(nativeClass, methods.data(), static_cast<jint>(methods.size()));
+    env->DeleteLocalRef(nativeClass);
+    if (registered != JNI_OK) {
+        LOGE("JNI_OnLoad: RegisterNatives failed");
+        env->ExceptionClear();
+        return JNI_ERR;
+    }
+
+    return JNI_VERSION_1_6;
+}
+
 } // extern "C"
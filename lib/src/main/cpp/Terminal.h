@@ -19,31 +19,169 @@
 
 #include <jni.h>
 #include <vterm.h>
+#include "GridMirror.h"
+#include "ParallelLayout.h"
+#include "Transport.h"
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 
 class Terminal {
 public:
     Terminal(JNIEnv* env, jobject callbacks, int rows = 24, int cols = 80);
     ~Terminal();
 
+    // Process-wide JNI setup, called once from JNI_OnLoad
+    static bool loadJniCache(JNIEnv* env);
+
+    // Session pool - VTerm instances built ahead of time, so a session opened
+    // at a pooled size skips allocation and setup
+    static constexpr int POOL_MAX = 8;
+    static int prewarm(int rows, int cols, int count);
+
     // Input handling - receives data from PTY/transport
     int writeInput(const uint8_t* data, size_t length);
 
-    // Terminal control
+    // Terminal control - returns 0, or 1 if the size is locked and the
+    // resize was deferred
     int resize(int rows, int cols);
 
+    // Size lock - while held, resizes are recorded but not applied, so a zoom
+    // gesture neither reflows the screen nor signals the remote program.
+    // Unlocking applies the last requested size once, if it differs from the
+    // current one. Returns 1 if that resize happened.
+    int setSizeLocked(bool locked);
+
+    // Character encoding - VTERM_LEGACY_NONE for UTF-8, or a legacy encoding
+    int setEncoding(int encoding);
+
+    // Native transport - its input is parsed on the binding's thread and
+    // keyboard output and replies are written straight to it, without JNI.
+    // Only one can be bound at a time. Returns 0, or -errno.
+    int bindTransport(std::unique_ptr<Transport> transport);
+
+    // Local process on a native PTY transport. Returns the child pid, or -errno.
+    int startProcess(const std::vector<std::string>& argv,
+                     const std::vector<std::string>& env,
+                     const std::string& cwd);
+
+    // Socketpair transport for tests and benchmarks. Returns the caller's
+    // end, which it then owns, or -errno.
+    int bindLoopback();
+
+    // Output sink - keyboard output and replies are written straight to this
+    // descriptor instead of the Java callback. The caller keeps ownership;
+    // -1 unregisters it. Returns 0, or -errno.
+    int setOutputFd(int fd);
+
+    // Native output callback, for in-process transports without a descriptor
+    using OutputCallback = void (*)(const uint8_t* data, size_t length, void* user);
+    void setOutputCallback(OutputCallback callback, void* user);
+
     // Keyboard input - generates escape sequences
     bool dispatchKey(int modifiers, int key);
     bool dispatchCharacter(int modifiers, int codepoint);
 
-    // Cell data retrieval for rendering
-    int getCellRun(JNIEnv* env, int row, int col, jobject runObject);
+    // Cell data retrieval for rendering - one run of equally styled cells in
+    // [col, endCol), written to a buffer registered once with
+    // setCellRunBuffer(). Runs end early when the buffer is full. Makes no
+    // JNI calls, but takes mLock, so its native method stays a regular one.
+    //
+    // Buffer layout, in native byte order (must match CellRun.kt): a header
+    // of 32-bit words indexed by CellRunField, then the UTF-16 text.
+    enum CellRunField {
+        CELL_RUN_LENGTH,       // columns covered
+        CELL_RUN_CHAR_COUNT,   // UTF-16 units of text
+        CELL_RUN_FG_RGB,       // 0xRRGGBB
+        CELL_RUN_BG_RGB,
+        CELL_RUN_FG_INDEX,     // palette slot, see paletteIndex()
+        CELL_RUN_BG_INDEX,
+        CELL_RUN_FLAGS,        // CellRunFlags
+        CELL_RUN_UNDERLINE,
+        CELL_RUN_FONT,
+        CELL_RUN_DHL,
+    };
+    enum CellRunFlags {
+        CELL_RUN_BOLD = 1 << 0,
+        CELL_RUN_ITALIC = 1 << 1,
+        CELL_RUN_BLINK = 1 << 2,
+        CELL_RUN_REVERSE = 1 << 3,
+        CELL_RUN_STRIKE = 1 << 4,
+        CELL_RUN_DWL = 1 << 5,
+    };
+    static constexpr size_t CELL_RUN_HEADER_BYTES = 16 * sizeof(int32_t);
+    static constexpr size_t CELL_RUN_MIN_BYTES = CELL_RUN_HEADER_BYTES + 64 * sizeof(uint16_t);
+
+    // Returns -1 if the buffer is too small; nullptr unregisters it
+    int setCellRunBuffer(void* address, size_t capacity);
+    int getCellRun(int row, int col, int endCol);
+
+    // Shared grid - a render-ready mirror of the screen that Java maps once
+    // and reads without JNI calls (see GridMirror). Created on first use;
+    // from then on damage reaches Java only after the rows are in the
+    // mirror. Returns false if the mirror could not be allocated.
+    bool enableGrid(uint8_t** data, size_t* size);
+
+    // Seqlock reads, without the terminal lock; only valid once enabled
+    uint64_t gridReadBegin() const { return mGrid->readBegin(); }
+    bool gridReadValidate(uint64_t sequence) const { return mGrid->readValidate(sequence); }
+
+    // Blink - damages only rows holding blinking cells
+    int blinkTick();
+
+    // Selection - extent of the word/path/URL around a cell, end exclusive
+    bool getSelectExtent(int row, int col, int mode, int* extent);
+
+    // Command profiler - time one in every sampleEvery sequences, 0 disables
+    void setProfiling(int sampleEvery);
+    std::string getProfileReport();
+
+    // Parallel parsing - long runs of plain lines within one write are laid
+    // out on this many worker threads (see ParallelLayout); 0 disables
+    void setParallelParsing(int threads);
+
+    // Scrollback limit - logical lines the history keeps. Long runs of plain
+    // lines skip the rows that would be evicted within the same write;
+    // 0 hands every row over
+    void setScrollbackLimit(int lines);
+
+    // Per-command costs - shell commands are delimited by OSC 133 C and D marks
+    struct CommandStats {
+        uint64_t id = 0;
+        std::string commandLine;     // from the OSC 133 B mark to the C mark
+        int64_t startTimeMs = 0;     // wall clock at the C mark
+        int64_t durationNs = 0;      // C to D, or to now while running
+        int64_t parseNs = 0;         // time writeInput spent on its output
+        int64_t bytes = 0;           // at writeInput granularity
+        int64_t scrolledLines = 0;
+        int64_t damagedCells = 0;
+        int exitCode = -1;           // -1 if the shell did not report one
+        bool finished = false;
+    };
+    static constexpr size_t COMMAND_HISTORY_SIZE = 64;
+    jobjectArray getCommandStats(JNIEnv* env);
+
+    // Output text for accessibility - an append-only stream of finalized
+    // output up to the cursor, without OSC 133 prompts and input. Returns the
+    // text after *cursor and advances it; a negative cursor skips to the end.
+    // The stream is only kept once it has been read.
+    static constexpr size_t OUTPUT_TEXT_CAPACITY = 16 * 1024;
+    jstring readOutputText(JNIEnv* env, jlong* cursor);
 
     // Color configuration
     int setPaletteColors(const uint32_t* colors, int count);
     int setDefaultColors(uint32_t fgColor, uint32_t bgColor);
 
+    // Palette export - 256 indexed colors followed by default fg and bg
+    static constexpr int PALETTE_SIZE = 258;
+    static constexpr int PALETTE_DEFAULT_FG = 256;
+    static constexpr int PALETTE_DEFAULT_BG = 257;
+    static constexpr int PALETTE_DIRECT = -1;
+    int getPalette(uint32_t* colors, int count);
+
 private:
     // libvterm screen callbacks (called by libvterm)
     static int termDamage(VTermRect rect, void* user);
@@ -51,8 +189,9 @@ private:
     static int termMovecursor(VTermPos pos, VTermPos oldpos, int visible, void* user);
     static int termSettermprop(VTermProp prop, VTermValue* val, void* user);
     static int termBell(void* user);
-    static int termSbPushline(int cols, const VTermScreenCell* cells, void* user);
+    static int termSbPushline(int cols, const VTermScreenCell* cells, bool continuation, void* user);
     static int termSbPopline(int cols, VTermScreenCell* cells, void* user);
+    static int termSbClear(void* user);
 
     // libvterm output callback (keyboard generates this)
     static void termOutput(const char* s, size_t len, void* user);
@@ -65,15 +204,109 @@ private:
     int invokeMoverect(VTermRect dest, VTermRect src);
     void invokeMoveCursor(int row, int col, int oldRow, int oldCol, bool visible);
     void invokeSetTermProp(VTermProp prop, VTermValue* val);
-    void invokeBell();
-    void invokePushScrollbackLine(int cols, const VTermScreenCell* cells);
+    void invokeBell(int count);
+    void invokePushScrollbackLine(int cols, const VTermScreenCell* cells, bool continuation);
     int invokePopScrollbackLine(int cols, VTermScreenCell* cells);
+    void invokeClearScrollback();
     void invokeKeyboardOutput(const char* data, size_t len);
     int invokeOscSequence(int command, const std::string& payload);
+    void invokeTransportClosed(int exitCode);
+
+    // Coalesced events - termprops and bells queued during a write are
+    // reported once, with their final values, when it is flushed
+    void flushEvents();
+
+    // Shared grid - rewrite the dirty cells, then report them as damage
+    void publishGrid();
+    void recolorGrid();
+    bool writeGridCells(int row, int startCol, int endCol);
+
+    // Parallel parsing and fast-forward - writes data, handing long runs of
+    // plain lines to writePlainLines()
+    size_t writeInputRuns(const uint8_t* data, size_t length);
+    void writePlainLines(const uint8_t* data, size_t length);
+    void clearForRun();
+
+    // Command cost attribution
+    void onShellIntegrationMark(const VTermStringFragment& frag);
+    void chargeCommand(std::chrono::steady_clock::time_point now);
+    void recordCommand();
+    std::string readCommandLine(VTermPos from, VTermPos to);
+
+    // Output text stream
+    void commitOutputText();
+    void resumeOutputText();
+    int appendOutputCells(const VTermScreenCell* cells, int from, int to);
+    void appendOutputChar(uint32_t codepoint);
 
     // Helper functions
     static bool cellStyleEqual(const VTermScreenCell& a, const VTermScreenCell& b);
+    static int32_t cellFlags(const VTermScreenCell& cell);
     void resolveColor(const VTermColor& color, uint8_t& r, uint8_t& g, uint8_t& b);
+    static int paletteIndex(const VTermColor& color);
+
+    // Process-wide JNI class, method and field IDs, loaded once in JNI_OnLoad
+    struct JniCache {
+        // TerminalCallbacks methods
+        jmethodID damageMethod;
+        jmethodID moverectMethod;
+        jmethodID moveCursorMethod;
+        jmethodID setTermPropMethod;
+        jmethodID bellMethod;
+        jmethodID pushScrollbackMethod;
+        jmethodID popScrollbackMethod;
+        jmethodID clearScrollbackMethod;
+        jmethodID keyboardInputMethod;
+        jmethodID oscSequenceMethod;
+        jmethodID transportClosedMethod;
+
+        // Classes built for callbacks and queries
+        jclass termRectClass;
+        jmethodID termRectConstructor;
+        jclass cursorPositionClass;
+        jmethodID cursorPositionConstructor;
+        jclass screenCellClass;
+        jmethodID screenCellConstructor;
+        jclass arrayListClass;
+        jmethodID arrayListConstructor;
+        jmethodID arrayListAdd;
+        jclass characterClass;
+        jmethodID characterValueOf;
+        jmethodID characterCharValue;
+        jclass terminalPropertyBoolClass;
+        jmethodID terminalPropertyBoolConstructor;
+        jclass terminalPropertyIntClass;
+        jmethodID terminalPropertyIntConstructor;
+        jclass terminalPropertyStringClass;
+        jmethodID terminalPropertyStringConstructor;
+        jclass terminalPropertyColorClass;
+        jmethodID terminalPropertyColorConstructor;
+        jclass commandCostClass;
+        jmethodID commandCostConstructor;
+
+        // ScreenCell fields and List methods, for reading popped scrollback
+        jfieldID screenCellChar;
+        jfieldID screenCellCombiningChars;
+        jfieldID screenCellFgRed;
+        jfieldID screenCellFgGreen;
+        jfieldID screenCellFgBlue;
+        jfieldID screenCellBgRed;
+        jfieldID screenCellBgGreen;
+        jfieldID screenCellBgBlue;
+        jfieldID screenCellBold;
+        jfieldID screenCellItalic;
+        jfieldID screenCellUnderline;
+        jfieldID screenCellReverse;
+        jfieldID screenCellStrike;
+        jfieldID screenCellWidth;
+        jmethodID listSize;
+        jmethodID listGet;
+    };
+    static JniCache sJni;
+
+    // VTerm construction, shared by sessions and the pool
+    static VTerm* newVTerm(int rows, int cols);
+    static VTerm* takePooled(int rows, int cols);
 
     // libvterm state
     VTerm* mVt;
@@ -81,63 +314,73 @@ private:
     VTermScreenCallbacks mScreenCallbacks{};
     VTermStateFallbacks mStateFallbacks{};
 
+    // Events waiting for flushEvents()
+    struct PendingProp {
+        VTermValue value{};  // string values are kept in text
+        std::string text;
+        std::string partial;  // string fragments received so far
+    };
+    PendingProp mPendingProps[VTERM_N_PROPS];
+    uint32_t mChangedProps = 0;  // bit per VTermProp
+    int mPendingBells = 0;
+
+    // Command cost attribution state
+    std::deque<CommandStats> mCommandHistory;
+    CommandStats mCommand;
+    bool mCommandRunning = false;
+    uint64_t mNextCommandId = 1;
+    VTermPos mCommandInputPos{-1, -1};
+    std::chrono::steady_clock::time_point mCommandStart;
+    std::chrono::steady_clock::time_point mWriteStart;  // or the C mark within the write
+    size_t mWriteLength = 0;
+    bool mWriteCharged = false;
+
+    // Output text stream state
+    bool mOutputTextEnabled = false;
+    bool mOutputTextInPrompt = false;      // between the OSC 133 A and C marks
+    bool mOutputTextInAltScreen = false;
+    VTermPos mOutputTextPos{-1, -1};       // first cell not yet in the stream
+    std::u16string mOutputText;
+    uint64_t mOutputTextStart = 0;         // stream offset of mOutputText[0]
+    std::vector<VTermScreenCell> mOutputTextCells;
+
+    // Registered cell run buffer, owned by the Java side
+    uint8_t* mCellRunBuffer = nullptr;
+    size_t mCellRunCapacity = 0;
+
+    // Shared grid mirror and scratch space for encoding a row, once enabled
+    std::unique_ptr<GridMirror> mGrid;
+    std::vector<GridMirror::Cell> mGridCells;
+    std::vector<uint16_t> mGridText;
+
+    // Worker threads for long runs of plain lines, once enabled
+    std::unique_ptr<ParallelLayout> mLayout;
+
+    // History kept by the Java side, and whether rows pushed now would be
+    // evicted from it before the write returns
+    int mScrollbackLimit = 0;
+    bool mDropScrollback = false;
+
+    // Native transport, if one is bound
+    std::unique_ptr<TransportBinding> mTransport;
+
+    // Direct output, taking over from the Java keyboard callback when set
+    std::unique_ptr<OutputSink> mOutputSink;
+    OutputCallback mOutputCallback = nullptr;
+    void* mOutputCallbackUser = nullptr;
+
     // Terminal dimensions
     int mRows;
     int mCols;
 
-    // Java callback object and method IDs
+    // Size requested while locked, applied on unlock
+    bool mSizeLocked = false;
+    int mPendingRows = 0;
+    int mPendingCols = 0;
+
+    // Java callback object
     JavaVM* mJavaVM{};
     jobject mCallbacks;  // Global reference
-    jmethodID mDamageMethod;
-    jmethodID mMoverectMethod;
-    jmethodID mMoveCursorMethod;
-    jmethodID mSetTermPropMethod;
-    jmethodID mBellMethod;
-    jmethodID mPushScrollbackMethod;
-    jmethodID mPopScrollbackMethod;
-    jmethodID mKeyboardInputMethod;
-    jmethodID mOscSequenceMethod;
-
-    // Cached Java class and field IDs for CellRun
-    jclass mCellRunClass;
-    jfieldID mFgRedField;
-    jfieldID mFgGreenField;
-    jfieldID mFgBlueField;
-    jfieldID mBgRedField;
-    jfieldID mBgGreenField;
-    jfieldID mBgBlueField;
-    jfieldID mBoldField;
-    jfieldID mUnderlineField;
-    jfieldID mItalicField;
-    jfieldID mBlinkField;
-    jfieldID mReverseField;
-    jfieldID mStrikeField;
-    jfieldID mFontField;
-    jfieldID mDwlField;
-    jfieldID mDhlField;
-    jfieldID mCharsField;
-    jfieldID mRunLengthField;
-
-    // Cached Java classes and methods for callbacks (avoid FindClass/GetMethodID overhead)
-    jclass mTermRectClass;
-    jmethodID mTermRectConstructor;
-    jclass mCursorPositionClass;
-    jmethodID mCursorPositionConstructor;
-    jclass mScreenCellClass;
-    jmethodID mScreenCellConstructor;
-    jclass mArrayListClass;
-    jmethodID mArrayListConstructor;
-    jmethodID mArrayListAdd;
-    jclass mCharacterClass;
-    jmethodID mCharacterValueOf;
-    jclass mTerminalPropertyBoolClass;
-    jmethodID mTerminalPropertyBoolConstructor;
-    jclass mTerminalPropertyIntClass;
-    jmethodID mTerminalPropertyIntConstructor;
-    jclass mTerminalPropertyStringClass;
-    jmethodID mTerminalPropertyStringConstructor;
-    jclass mTerminalPropertyColorClass;
-    jmethodID mTerminalPropertyColorConstructor;
 
     // Thread safety (recursive mutex for reentrant calls via callbacks)
     mutable std::recursive_mutex mLock;
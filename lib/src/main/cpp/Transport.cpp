@@ -0,0 +1,242 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "Transport.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+std::unique_ptr<TransportBinding> TransportBinding::start(std::unique_ptr<Transport> transport,
+                                                          InputHandler onInput, CloseHandler onClose) {
+    if (!transport) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    std::unique_ptr<TransportBinding> binding(
+        new TransportBinding(std::move(transport), std::move(onInput), std::move(onClose)));
+    if (!binding->startThread()) {
+        int error = errno;
+        binding.reset();
+        errno = error;
+        return nullptr;
+    }
+
+    return binding;
+}
+
+TransportBinding::TransportBinding(std::unique_ptr<Transport> transport,
+                                   InputHandler onInput, CloseHandler onClose)
+    : mTransport(std::move(transport)),
+      mOnInput(std::move(onInput)), mOnClose(std::move(onClose)) {
+}
+
+bool TransportBinding::startThread() {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mEpollFd < 0 || mWakeFd < 0) {
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = mWakeFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev) != 0) {
+        return false;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = mTransport->fd();
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTransport->fd(), &ev) != 0) {
+        return false;
+    }
+
+    mThread = std::thread(&TransportBinding::run, this);
+    return true;
+}
+
+TransportBinding::~TransportBinding() {
+    if (mThread.joinable()) {
+        eventfd_write(mWakeFd, 1);
+        mThread.join();
+    }
+
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+    }
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+    }
+
+    mTransport.reset();
+}
+
+// Called with mWriteLock held
+void TransportBinding::watchOutput(bool enable) {
+    struct epoll_event ev = {};
+    ev.events = enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.fd = mTransport->fd();
+    epoll_ctl(mEpollFd, EPOLL_CTL_MOD, mTransport->fd(), &ev);
+}
+
+bool TransportBinding::write(const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+
+    if (mEnded) {
+        return false;
+    }
+
+    // Anything already queued goes first
+    size_t done = 0;
+    while (mOutput.empty() && done < length) {
+        ssize_t n = mTransport->write(data + done, length - done);
+        if (n > 0) {
+            done += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            mEnded = true;
+            return false;
+        }
+    }
+
+    if (done < length) {
+        bool wasEmpty = mOutput.empty();
+        mOutput.push(data + done, length - done);
+        if (wasEmpty) {
+            watchOutput(true);
+        }
+    }
+
+    return true;
+}
+
+// Called on the binding thread when the transport is writable again
+void TransportBinding::flushOutput() {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+
+    while (!mOutput.empty()) {
+        size_t length;
+        const uint8_t* data = mOutput.front(&length);
+        ssize_t n = mTransport->write(data, length);
+        if (n > 0) {
+            mOutput.consume(static_cast<size_t>(n));
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            mEnded = true;
+            mOutput.clear();
+        }
+    }
+
+    watchOutput(false);
+}
+
+// Read until the transport would block; false at the end of the stream
+bool TransportBinding::drainInput() {
+    for (;;) {
+        ssize_t n = mTransport->read(mReadBuffer, sizeof(mReadBuffer));
+        if (n > 0) {
+            mOnInput(mReadBuffer, static_cast<size_t>(n));
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+void TransportBinding::run() {
+    bool open = true;
+
+    while (open) {
+        struct epoll_event events[2];
+        int count = epoll_wait(mEpollFd, events, 2, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < count && open; i++) {
+            if (events[i].data.fd == mWakeFd) {
+                return;  // stopped by the destructor
+            }
+
+            if (events[i].events & EPOLLOUT) {
+                flushOutput();
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                open = drainInput() && !(events[i].events & EPOLLHUP);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mWriteLock);
+        mEnded = true;
+        mOutput.clear();
+    }
+
+    int exitCode = mTransport->finish();
+    mClosed = true;
+    if (mOnClose) {
+        mOnClose(exitCode);
+    }
+}
+
+std::unique_ptr<LoopbackTransport> LoopbackTransport::create() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return nullptr;
+    }
+
+    // Only the terminal's end is nonblocking; the peer is the caller's to set up
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    return std::unique_ptr<LoopbackTransport>(new LoopbackTransport(fds[0], fds[1]));
+}
+
+LoopbackTransport::~LoopbackTransport() {
+    close(mFd);
+    if (mPeerFd >= 0) {
+        close(mPeerFd);
+    }
+}
+
+int LoopbackTransport::takePeerFd() {
+    int fd = mPeerFd;
+    mPeerFd = -1;
+    return fd;
+}
+
+ssize_t LoopbackTransport::read(uint8_t* buffer, size_t length) {
+    return ::read(mFd, buffer, length);
+}
+
+ssize_t LoopbackTransport::write(const uint8_t* data, size_t length) {
+    return ::send(mFd, data, length, MSG_NOSIGNAL);
+}
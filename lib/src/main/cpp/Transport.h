@@ -0,0 +1,137 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TERMSCREEN_TRANSPORT_H
+#define TERMSCREEN_TRANSPORT_H
+
+#include "OutputSink.h"
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+ * A byte stream a terminal can be bound to: a local PTY, a socket, or
+ * anything else that can signal readiness on a file descriptor.
+ *
+ * read() and write() never block and follow POSIX conventions: -1 with errno
+ * EAGAIN when nothing can be transferred yet, and a read of 0 at the end of
+ * the stream. Nothing here depends on JNI.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // Polled for EPOLLIN, and for EPOLLOUT while output is queued
+    virtual int fd() const = 0;
+
+    virtual ssize_t read(uint8_t* buffer, size_t length) = 0;
+    virtual ssize_t write(const uint8_t* data, size_t length) = 0;
+
+    // Terminal size changes, for transports that carry them
+    virtual void setWindowSize(int /* rows */, int /* cols */) {}
+
+    // Called once after the stream ends; the exit code reported for it
+    virtual int finish() { return 0; }
+};
+
+/*
+ * Binds a transport to a consumer with one epoll thread.
+ *
+ * The thread reads into its own buffer and hands each chunk to the input
+ * handler. Output is written through immediately when the transport takes
+ * it; the rest waits in a ring that the thread drains on EPOLLOUT, so a
+ * writer never blocks on a slow peer.
+ */
+class TransportBinding {
+public:
+    using InputHandler = std::function<void(const uint8_t* data, size_t length)>;
+    using CloseHandler = std::function<void(int exitCode)>;
+
+    static constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+
+    // Returns nullptr with errno set if the thread could not be started
+    static std::unique_ptr<TransportBinding> start(std::unique_ptr<Transport> transport,
+                                                   InputHandler onInput, CloseHandler onClose);
+
+    // Stops the thread, then destroys the transport
+    ~TransportBinding();
+
+    TransportBinding(const TransportBinding&) = delete;
+    TransportBinding& operator=(const TransportBinding&) = delete;
+
+    // Queue output; returns false once the stream has ended
+    bool write(const uint8_t* data, size_t length);
+
+    Transport& transport() { return *mTransport; }
+    bool closed() const { return mClosed; }
+
+private:
+    TransportBinding(std::unique_ptr<Transport> transport, InputHandler onInput, CloseHandler onClose);
+
+    bool startThread();
+    void run();
+    bool drainInput();
+    void flushOutput();
+    void watchOutput(bool enable);
+
+    std::unique_ptr<Transport> mTransport;
+    InputHandler mOnInput;
+    CloseHandler mOnClose;
+
+    int mEpollFd = -1;
+    int mWakeFd = -1;
+    std::thread mThread;
+    std::atomic<bool> mClosed{false};
+
+    // Output the transport has not taken yet
+    std::mutex mWriteLock;
+    OutputRing mOutput;
+    bool mEnded = false;
+
+    uint8_t mReadBuffer[READ_BUFFER_SIZE];
+};
+
+/*
+ * One end of a socketpair, for tests and benchmarks. Whatever is written to
+ * the peer descriptor arrives as terminal input, and terminal output can be
+ * read back from it.
+ */
+class LoopbackTransport : public Transport {
+public:
+    // Returns nullptr with errno set on failure
+    static std::unique_ptr<LoopbackTransport> create();
+    ~LoopbackTransport() override;
+
+    // The caller's end; ownership passes with takePeerFd()
+    int takePeerFd();
+
+    int fd() const override { return mFd; }
+    ssize_t read(uint8_t* buffer, size_t length) override;
+    ssize_t write(const uint8_t* data, size_t length) override;
+
+private:
+    LoopbackTransport(int fd, int peerFd) : mFd(fd), mPeerFd(peerFd) {}
+
+    int mFd;
+    int mPeerFd;
+};
+
+#endif // TERMSCREEN_TRANSPORT_H
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+#
+# Generates src/encoding/legacy.inc, the double-byte tables behind the legacy
+# CJK encodings, from the codecs that ship with Python.
+#
+# Each table is indexed by lead byte. A row only covers the span from its
+# first to its last mapped trail byte, and rows with no mappings take no
+# space, so the tables stay close to the size of the character sets.
+
+import sys
+
+TABLES = [
+    # name, codec, prefix, lead bytes, trail bytes
+    ("jis0208", "euc_jp",    b"",     range(0xa1, 0xff), range(0xa1, 0xff)),
+    ("jis0212", "euc_jp",    b"\x8f", range(0xa1, 0xff), range(0xa1, 0xff)),
+    ("gbk",     "gbk",       b"",     range(0x81, 0xff), range(0x40, 0xff)),
+    ("big5",    "big5",      b"",     range(0x81, 0xff), range(0x40, 0xff)),
+    ("ksx1001", "euc_kr",    b"",     range(0xa1, 0xff), range(0xa1, 0xff)),
+]
+
+
+def decode(codec, seq):
+    try:
+        text = seq.decode(codec)
+    except UnicodeDecodeError:
+        return 0
+    if len(text) != 1 or ord(text) > 0xffff:
+        return 0
+    return ord(text)
+
+
+def emit(out, name, codec, prefix, leads, trails):
+    rows = []
+    cells = []
+
+    for lead in leads:
+        mapped = [(trail, decode(codec, prefix + bytes([lead, trail]))) for trail in trails]
+        mapped = [(trail, cp) for trail, cp in mapped if cp]
+
+        if not mapped:
+            rows.append((0, 0, 0))
+            continue
+
+        first = mapped[0][0]
+        last = mapped[-1][0]
+        lookup = dict(mapped)
+        rows.append((len(cells), first, last - first + 1))
+        cells.extend(lookup.get(trail, 0) for trail in range(first, last + 1))
+
+    out.write("static const uint16_t %s_cells[%d] = {\n" % (name, len(cells)))
+    for i in range(0, len(cells), 12):
+        out.write("  " + ", ".join("0x%04x" % cp for cp in cells[i:i + 12]) + ",\n")
+    out.write("};\n\n")
+
+    out.write("static const struct DBCSRow %s_rows[%d] = {\n" % (name, len(rows)))
+    for i in range(0, len(rows), 4):
+        out.write("  " + " ".join("{ %5d, 0x%02x, %3d }," % row for row in rows[i:i + 4]) + "\n")
+    out.write("};\n\n")
+
+    out.write("static const struct DBCSTable table_%s = {\n" % name)
+    out.write("  0x%02x, 0x%02x, %s_rows, %s_cells,\n" % (leads[0], leads[-1], name, name))
+    out.write("};\n\n")
+
+
+def main():
+    out = sys.stdout
+    out.write("/* Generated by gen-legacy-tables.py - do not edit */\n\n")
+    for table in TABLES:
+        emit(out, *table)
+
+
+if __name__ == "__main__":
+    main()
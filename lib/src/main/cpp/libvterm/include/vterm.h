@@ -350,6 +350,23 @@ void vterm_set_size(VTerm *vt, int rows, int cols);
 int  vterm_get_utf8(const VTerm *vt);
 void vterm_set_utf8(VTerm *vt, int is_utf8);
 
+/* Legacy multibyte encodings, decoded natively in place of UTF-8. Selecting
+ * one turns UTF-8 mode off, and C1 controls stay off since their bytes are
+ * part of the multibyte characters; selecting UTF-8 clears it again */
+typedef enum {
+  VTERM_LEGACY_NONE,
+  VTERM_LEGACY_SHIFT_JIS,
+  VTERM_LEGACY_EUC_JP,     // JIS X 0208, halfwidth katakana and JIS X 0212
+  VTERM_LEGACY_GBK,
+  VTERM_LEGACY_BIG5,
+  VTERM_LEGACY_EUC_KR,
+
+  VTERM_N_LEGACY_ENCODINGS
+} VTermLegacyEncoding;
+
+VTermLegacyEncoding vterm_get_legacy_encoding(const VTerm *vt);
+void vterm_set_legacy_encoding(VTerm *vt, VTermLegacyEncoding encoding);
+
 size_t vterm_input_write(VTerm *vt, const char *bytes, size_t len);
 
 /* Setting output callback will override the buffer logic */
@@ -420,10 +437,81 @@ void *vterm_parser_get_cbdata(VTerm *vt);
  */
 void vterm_parser_set_emit_nul(VTerm *vt, bool emit);
 
+/* Optional command profiler. Counts every dispatched sequence per command and
+ * times one in every sample_every of them, including all the state and screen
+ * work it causes. Disabled (and free) until enabled.
+ *
+ * command is:
+ *   TEXT          0
+ *   CONTROL       the C0/C1 byte
+ *   ESCAPE        intermediate << 8 | final
+ *   CSI           leader << 16 | intermediate << 8 | final
+ *   OSC           the OSC number (-1 if missing)
+ *   DCS           up to three command bytes, first in the top byte
+ *   APC, PM, SOS  0
+ * Only the first leader and intermediate byte are kept. A string sequence
+ * counts once but is timed per fragment.
+ */
+typedef enum {
+  VTERM_PROFILE_TEXT,
+  VTERM_PROFILE_CONTROL,
+  VTERM_PROFILE_ESCAPE,
+  VTERM_PROFILE_CSI,
+  VTERM_PROFILE_OSC,
+  VTERM_PROFILE_DCS,
+  VTERM_PROFILE_APC,
+  VTERM_PROFILE_PM,
+  VTERM_PROFILE_SOS,
+
+  VTERM_N_PROFILE_KINDS
+} VTermProfileKind;
+
+typedef struct {
+  VTermProfileKind kind;
+  int32_t  command;
+  uint64_t count;      /* sequences dispatched */
+  uint64_t sampled;    /* dispatches that were timed */
+  uint64_t sampled_ns; /* total time spent in the timed dispatches */
+} VTermProfileEntry;
+
+/* sample_every == 0 disables profiling and discards the histogram */
+void vterm_profile_enable(VTerm *vt, int sample_every);
+void vterm_profile_reset(VTerm *vt);
+/* Copies up to len entries, returns the total number of entries */
+int  vterm_profile_get(const VTerm *vt, VTermProfileEntry *entries, int len);
+
 // -----------
 // State layer
 // -----------
 
+typedef struct {
+    unsigned int bold      : 1;
+    unsigned int underline : 2;
+    unsigned int italic    : 1;
+    unsigned int blink     : 1;
+    unsigned int reverse   : 1;
+    unsigned int conceal   : 1;
+    unsigned int strike    : 1;
+    unsigned int font      : 4; /* 0 to 9 */
+    unsigned int dwl       : 1; /* On a DECDWL or DECDHL line */
+    unsigned int dhl       : 2; /* On a DECDHL line (1=top 2=bottom) */
+    unsigned int small     : 1;
+    unsigned int baseline  : 2;
+} VTermScreenCellAttrs; /* Also used by the state layer to describe a pen */
+
+enum {
+  VTERM_UNDERLINE_OFF,
+  VTERM_UNDERLINE_SINGLE,
+  VTERM_UNDERLINE_DOUBLE,
+  VTERM_UNDERLINE_CURLY,
+};
+
+enum {
+  VTERM_BASELINE_NORMAL,
+  VTERM_BASELINE_RAISE,
+  VTERM_BASELINE_LOWER,
+};
+
 typedef struct {
   int (*putglyph)(VTermGlyphInfo *info, VTermPos pos, void *user);
   int (*movecursor)(VTermPos pos, VTermPos oldpos, int visible, void *user);
@@ -437,6 +525,21 @@ typedef struct {
   int (*resize)(int rows, int cols, VTermStateFields *fields, void *user);
   int (*setlineinfo)(int row, const VTermLineInfo *newinfo, const VTermLineInfo *oldinfo, void *user);
   int (*sb_clear)(void *user);
+  /* Optional: write `count` copies of the glyph side by side starting at pos.
+   * If absent or returning 0, the state layer falls back to putglyph */
+  int (*repeatglyph)(VTermGlyphInfo *info, VTermPos pos, int count, void *user);
+  /* Optional: receive the complete pen once per SGR sequence or pen reset;
+   * when set, setpenattr is not called. attrs.dwl and attrs.dhl are unused */
+  int (*setpen)(const VTermScreenCellAttrs *attrs, const VTermColor *fg, const VTermColor *bg, void *user);
+  /* Optional: DEC rectangular area operations. fillrect writes the glyph with
+   * the current pen into every cell of rect (DECFRA); if absent or returning 0
+   * the state layer falls back to one repeatglyph per row. copyrect copies src
+   * to dest, which may overlap, leaving src intact (DECCRA). changeattrs sets
+   * every attribute that is nonzero in mask to its value in attrs (DECCARA).
+   * The last two are ignored if absent */
+  int (*fillrect)(VTermRect rect, VTermGlyphInfo *info, void *user);
+  int (*copyrect)(VTermRect dest, VTermRect src, void *user);
+  int (*changeattrs)(VTermRect rect, const VTermScreenCellAttrs *attrs, const VTermScreenCellAttrs *mask, void *user);
 } VTermStateCallbacks;
 
 typedef struct {
@@ -475,6 +578,22 @@ void vterm_state_focus_in(VTermState *state);
 void vterm_state_focus_out(VTermState *state);
 const VTermLineInfo *vterm_state_get_lineinfo(const VTermState *state, int row);
 
+/* Whether printable UTF-8 text and CRLFs written next are laid out as they
+ * would be on a fresh screen with the same pen: the parser is in the ground
+ * state with no partial character, G0 is not translated, and text goes to
+ * a single-width row of the primary screen with autowrap on, insert mode
+ * off and no margins. */
+int  vterm_state_plain_text_ready(const VTermState *state);
+
+/* Rows that such text, in whole lines ending in CRLF, takes when written
+ * from the left of a fresh row: what it would push to scrollback from the
+ * bottom of the screen. */
+size_t vterm_state_plain_text_rows(const VTermState *state, const char *bytes, size_t len);
+
+/* Takes over the pen, default colors and palette of `from`, announcing the
+ * pen attributes to the callbacks as SGR would. */
+void vterm_state_copy_pen(VTermState *state, const VTermState *from);
+
 /**
  * Makes sure that the given color `col` is indeed an RGB colour. After this
  * function returns, VTERM_COLOR_IS_RGB(col) will return true, while all other
@@ -496,34 +615,6 @@ void vterm_state_send_selection(VTermState *state, VTermSelectionMask mask, VTer
 // Screen layer
 // ------------
 
-typedef struct {
-    unsigned int bold      : 1;
-    unsigned int underline : 2;
-    unsigned int italic    : 1;
-    unsigned int blink     : 1;
-    unsigned int reverse   : 1;
-    unsigned int conceal   : 1;
-    unsigned int strike    : 1;
-    unsigned int font      : 4; /* 0 to 9 */
-    unsigned int dwl       : 1; /* On a DECDWL or DECDHL line */
-    unsigned int dhl       : 2; /* On a DECDHL line (1=top 2=bottom) */
-    unsigned int small     : 1;
-    unsigned int baseline  : 2;
-} VTermScreenCellAttrs;
-
-enum {
-  VTERM_UNDERLINE_OFF,
-  VTERM_UNDERLINE_SINGLE,
-  VTERM_UNDERLINE_DOUBLE,
-  VTERM_UNDERLINE_CURLY,
-};
-
-enum {
-  VTERM_BASELINE_NORMAL,
-  VTERM_BASELINE_RAISE,
-  VTERM_BASELINE_LOWER,
-};
-
 typedef struct {
   uint32_t chars[VTERM_MAX_CHARS_PER_CELL];
   char     width;
@@ -541,6 +632,9 @@ typedef struct {
   int (*sb_pushline)(int cols, const VTermScreenCell *cells, void *user);
   int (*sb_popline)(int cols, VTermScreenCell *cells, void *user);
   int (*sb_clear)(void* user);
+  /* Optional: used instead of sb_pushline when set. continuation is true if
+   * the line was wrapped onto from the line pushed before it */
+  int (*sb_pushline4)(int cols, const VTermScreenCell *cells, bool continuation, void *user);
 } VTermScreenCallbacks;
 
 VTermScreen *vterm_obtain_screen(VTerm *vt);
@@ -570,6 +664,11 @@ typedef enum {
 void vterm_screen_flush_damage(VTermScreen *screen);
 void vterm_screen_set_damage_merge(VTermScreen *screen, VTermDamageSize size);
 
+/* Damage only the rows that contain blinking cells, for redrawing them on a
+ * blink tick. Returns the number of such rows; 0 means no blink timer is
+ * needed */
+int vterm_screen_damage_blink(VTermScreen *screen);
+
 void   vterm_screen_reset(VTermScreen *screen, int hard);
 
 /* Neither of these functions NUL-terminate the buffer */
@@ -595,6 +694,21 @@ typedef enum {
 
 int vterm_screen_get_attrs_extent(const VTermScreen *screen, VTermRect *extent, VTermPos pos, VTermAttrMask attrs);
 
+typedef enum {
+  VTERM_SELECT_WORD,  /* letters, digits and '_'; other punctuation groups on its own */
+  VTERM_SELECT_TOKEN, /* anything up to whitespace */
+  VTERM_SELECT_PATH,  /* filename characters and '/' */
+  VTERM_SELECT_URL,   /* URL characters, without trailing punctuation */
+  VTERM_SELECT_STYLE, /* cells with the same attributes and colours */
+
+  VTERM_N_SELECTS
+} VTermSelectMode;
+
+/* Find the run of cells around pos that mode considers one unit, following
+ * soft-wrapped lines. start is the first cell and end is one past the last,
+ * which may lie on other rows than pos. Returns 0 if pos is off the screen */
+int vterm_screen_get_select_extent(const VTermScreen *screen, VTermPos pos, VTermSelectMode mode, VTermPos *start, VTermPos *end);
+
 int vterm_screen_get_cell(const VTermScreen *screen, VTermPos pos, VTermScreenCell *cell);
 
 int vterm_screen_is_eol(const VTermScreen *screen, VTermPos pos);
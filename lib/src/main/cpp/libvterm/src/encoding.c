@@ -228,3 +228,228 @@ VTermEncoding *vterm_lookup_encoding(VTermEncodingType type, char designation)
       return encodings[i].enc;
   return NULL;
 }
+
+/* Legacy CJK encodings. Each replaces UTF-8 for bytes 0x80 and up, and takes
+ * over the ASCII that follows a multibyte character in the same run, so
+ * mixed text decodes in one pass */
+
+struct DBCSRow {
+  uint16_t offset;
+  uint8_t  first;  // first mapped trail byte
+  uint8_t  count;  // trail bytes covered from first; 0 for an empty row
+};
+
+struct DBCSTable {
+  uint8_t lead_first, lead_last;
+  const struct DBCSRow *rows;
+  const uint16_t *cells;
+};
+
+#include "encoding/legacy.inc"
+
+static uint32_t dbcs_lookup(const struct DBCSTable *table, unsigned char lead, unsigned char trail)
+{
+  if(lead < table->lead_first || lead > table->lead_last)
+    return UNICODE_INVALID;
+
+  const struct DBCSRow *row = &table->rows[lead - table->lead_first];
+  if(trail < row->first || trail >= row->first + row->count)
+    return UNICODE_INVALID;
+
+  uint16_t cp = table->cells[row->offset + trail - row->first];
+  return cp ? cp : UNICODE_INVALID;
+}
+
+typedef enum {
+  LEGACY_DBCS,   // lead byte + trail byte, one table
+  LEGACY_SJIS,
+  LEGACY_EUCJP,
+} LegacyKind;
+
+struct LegacyEncoding {
+  VTermEncoding enc;
+  LegacyKind kind;
+  const struct DBCSTable *table;
+  unsigned char trail_first;  // lowest byte that can continue a character
+};
+
+struct LegacyDecoderData {
+  // bytes of the current character seen so far
+  unsigned char bytes[2];
+  int nbytes;
+  // EUC-JP single shift (0x8E or 0x8F) in progress, or 0
+  unsigned char shift;
+};
+
+static void init_legacy(VTermEncoding *enc, void *data_)
+{
+  struct LegacyDecoderData *data = data_;
+
+  data->nbytes = 0;
+  data->shift  = 0;
+}
+
+/* Shift-JIS packs two JIS X 0208 rows into each lead byte; unpack to the EUC
+ * form the table is indexed by */
+static uint32_t sjis_lookup(unsigned char lead, unsigned char trail)
+{
+  if(trail < 0x40 || trail == 0x7f || trail > 0xfc)
+    return UNICODE_INVALID;
+
+  int row = (lead < 0xa0 ? lead - 0x81 : lead - 0xc1) * 2;
+  int col;
+  if(trail >= 0x9f) {
+    row += 2;
+    col = trail - 0x9e;
+  }
+  else {
+    row += 1;
+    col = trail - (trail > 0x7f ? 0x40 : 0x3f);
+  }
+
+  if(row < 1 || row > 94)
+    return UNICODE_INVALID;
+  return dbcs_lookup(&table_jis0208, row + 0xa0, col + 0xa0);
+}
+
+/* How many bytes a character starting with this byte takes, 0 if it cannot
+ * start one */
+static int legacy_length(const struct LegacyEncoding *legacy, unsigned char c)
+{
+  switch(legacy->kind) {
+  case LEGACY_SJIS:
+    if((c >= 0x81 && c <= 0x9f) || (c >= 0xe0 && c <= 0xfc))
+      return 2;
+    return (c >= 0xa1 && c <= 0xdf) ? 1 : 0;
+  case LEGACY_EUCJP:
+    if(c == 0x8e)
+      return 2;
+    if(c == 0x8f)
+      return 3;
+    return (c >= 0xa1 && c <= 0xfe) ? 2 : 0;
+  case LEGACY_DBCS:
+    return (c >= legacy->table->lead_first && c <= legacy->table->lead_last) ? 2 : 0;
+  }
+  return 0;
+}
+
+static uint32_t legacy_finish(const struct LegacyEncoding *legacy, struct LegacyDecoderData *data,
+                              unsigned char last)
+{
+  switch(legacy->kind) {
+  case LEGACY_SJIS:
+    return sjis_lookup(data->bytes[0], last);
+  case LEGACY_EUCJP:
+    if(data->shift == 0x8e)
+      return (last >= 0xa1 && last <= 0xdf) ? 0xff61 + last - 0xa1 : UNICODE_INVALID;
+    if(data->shift == 0x8f)
+      return dbcs_lookup(&table_jis0212, data->bytes[1], last);
+    return dbcs_lookup(&table_jis0208, data->bytes[0], last);
+  case LEGACY_DBCS:
+    return dbcs_lookup(legacy->table, data->bytes[0], last);
+  }
+  return UNICODE_INVALID;
+}
+
+static void decode_legacy(VTermEncoding *enc, void *data_,
+                          uint32_t cp[], int *cpi, int cplen,
+                          const char bytes[], size_t *pos, size_t bytelen)
+{
+  struct LegacyEncoding *legacy = (struct LegacyEncoding *)enc;
+  struct LegacyDecoderData *data = data_;
+
+  for(; *pos < bytelen && *cpi < cplen; (*pos)++) {
+    unsigned char c = bytes[*pos];
+
+    if(!data->nbytes) {
+      // ASCII fast path
+      if(c >= 0x20 && c < 0x7f) {
+        cp[(*cpi)++] = c;
+        continue;
+      }
+      if(c < 0x20 || c == 0x7f)
+        return;
+
+      int length = legacy_length(legacy, c);
+      if(length == 1) {
+        cp[(*cpi)++] = 0xff61 + c - 0xa1;  // Shift-JIS halfwidth katakana
+        continue;
+      }
+      if(!length) {
+        cp[(*cpi)++] = UNICODE_INVALID;
+        continue;
+      }
+
+      data->bytes[0] = c;
+      data->nbytes = 1;
+      data->shift = (legacy->kind == LEGACY_EUCJP && (c == 0x8e || c == 0x8f)) ? c : 0;
+      continue;
+    }
+
+    // A control or ASCII byte cuts the character short and is reprocessed
+    if(c < legacy->trail_first || c == 0x7f || c == 0xff) {
+      data->nbytes = 0;
+      cp[(*cpi)++] = UNICODE_INVALID;
+      (*pos)--;
+      continue;
+    }
+
+    int length = data->shift == 0x8f ? 3 : 2;
+    if(data->nbytes + 1 < length) {
+      data->bytes[data->nbytes++] = c;
+      continue;
+    }
+
+    cp[(*cpi)++] = legacy_finish(legacy, data, c);
+    data->nbytes = 0;
+  }
+}
+
+static const struct LegacyEncoding encoding_sjis = {
+  { .init = &init_legacy, .decode = &decode_legacy },
+  LEGACY_SJIS, &table_jis0208, 0x40,
+};
+
+static const struct LegacyEncoding encoding_eucjp = {
+  { .init = &init_legacy, .decode = &decode_legacy },
+  LEGACY_EUCJP, &table_jis0208, 0xa1,
+};
+
+static const struct LegacyEncoding encoding_gbk = {
+  { .init = &init_legacy, .decode = &decode_legacy },
+  LEGACY_DBCS, &table_gbk, 0x40,
+};
+
+static const struct LegacyEncoding encoding_big5 = {
+  { .init = &init_legacy, .decode = &decode_legacy },
+  LEGACY_DBCS, &table_big5, 0x40,
+};
+
+static const struct LegacyEncoding encoding_euckr = {
+  { .init = &init_legacy, .decode = &decode_legacy },
+  LEGACY_DBCS, &table_ksx1001, 0xa1,
+};
+
+INTERNAL VTermEncoding *vterm_lookup_legacy_encoding(VTermLegacyEncoding encoding)
+{
+  switch(encoding) {
+  case VTERM_LEGACY_SHIFT_JIS: return (VTermEncoding*)&encoding_sjis;
+  case VTERM_LEGACY_EUC_JP:    return (VTermEncoding*)&encoding_eucjp;
+  case VTERM_LEGACY_GBK:       return (VTermEncoding*)&encoding_gbk;
+  case VTERM_LEGACY_BIG5:      return (VTermEncoding*)&encoding_big5;
+  case VTERM_LEGACY_EUC_KR:    return (VTermEncoding*)&encoding_euckr;
+  default:                     return NULL;
+  }
+}
+
+INTERNAL int vterm_utf8_pending(const VTermEncodingInstance *instance)
+{
+  const struct UTF8DecoderData *data = (const struct UTF8DecoderData *)instance->data;
+  return data->bytes_remaining > 0;
+}
+
+INTERNAL int vterm_legacy_pending(const VTermEncodingInstance *instance)
+{
+  const struct LegacyDecoderData *data = (const struct LegacyDecoderData *)instance->data;
+  return instance->enc && data->nbytes > 0;
+}
@@ -12,9 +12,13 @@ static bool is_intermed(unsigned char c)
 
 static void do_control(VTerm *vt, unsigned char control)
 {
-  if(vt->parser.callbacks && vt->parser.callbacks->control)
-    if((*vt->parser.callbacks->control)(control, vt->parser.cbdata))
-      return;
+  uint64_t start = PROFILE_START(vt);
+  int handled = vt->parser.callbacks && vt->parser.callbacks->control &&
+    (*vt->parser.callbacks->control)(control, vt->parser.cbdata);
+  PROFILE_END(vt, start, VTERM_PROFILE_CONTROL, control, 1);
+
+  if(handled)
+    return;
 
   DEBUG_LOG("libvterm: Unhandled control 0x%02x\n", control);
 }
@@ -32,15 +36,22 @@ static void do_csi(VTerm *vt, char command)
   }
 #endif
 
-  if(vt->parser.callbacks && vt->parser.callbacks->csi)
-    if((*vt->parser.callbacks->csi)(
+  uint64_t start = PROFILE_START(vt);
+  int handled = vt->parser.callbacks && vt->parser.callbacks->csi &&
+    (*vt->parser.callbacks->csi)(
           vt->parser.v.csi.leaderlen ? vt->parser.v.csi.leader : NULL, 
           vt->parser.v.csi.args,
           vt->parser.v.csi.argi,
           vt->parser.intermedlen ? vt->parser.intermed : NULL,
           command,
-          vt->parser.cbdata))
-      return;
+          vt->parser.cbdata);
+  PROFILE_END(vt, start, VTERM_PROFILE_CSI,
+      (vt->parser.v.csi.leaderlen ? (unsigned char)vt->parser.v.csi.leader[0] << 16 : 0) |
+      (vt->parser.intermedlen ? (unsigned char)vt->parser.intermed[0] << 8 : 0) |
+      (unsigned char)command, 1);
+
+  if(handled)
+    return;
 
   DEBUG_LOG("libvterm: Unhandled CSI %c\n", command);
 }
@@ -54,13 +65,29 @@ static void do_escape(VTerm *vt, char command)
   seq[len++] = command;
   seq[len]   = 0;
 
-  if(vt->parser.callbacks && vt->parser.callbacks->escape)
-    if((*vt->parser.callbacks->escape)(seq, len, vt->parser.cbdata))
-      return;
+  uint64_t start = PROFILE_START(vt);
+  int handled = vt->parser.callbacks && vt->parser.callbacks->escape &&
+    (*vt->parser.callbacks->escape)(seq, len, vt->parser.cbdata);
+  PROFILE_END(vt, start, VTERM_PROFILE_ESCAPE,
+      (vt->parser.intermedlen ? (unsigned char)vt->parser.intermed[0] << 8 : 0) | (unsigned char)command, 1);
+
+  if(handled)
+    return;
 
   DEBUG_LOG("libvterm: Unhandled escape ESC 0x%02x\n", command);
 }
 
+static int32_t dcs_profile_command(VTerm *vt)
+{
+  int32_t command = 0;
+  for(int i = 0; i < 3; i++) {
+    command <<= 8;
+    if(i < vt->parser.v.dcs.commandlen)
+      command |= (unsigned char)vt->parser.v.dcs.command[i];
+  }
+  return command;
+}
+
 static void string_fragment(VTerm *vt, const char *str, size_t len, bool final)
 {
   VTermStringFragment frag = {
@@ -70,30 +97,37 @@ static void string_fragment(VTerm *vt, const char *str, size_t len, bool final)
     .final   = final,
   };
 
+  uint64_t start = PROFILE_START(vt);
+
   switch(vt->parser.state) {
     case OSC:
       if(vt->parser.callbacks && vt->parser.callbacks->osc)
         (*vt->parser.callbacks->osc)(vt->parser.v.osc.command, frag, vt->parser.cbdata);
+      PROFILE_END(vt, start, VTERM_PROFILE_OSC, vt->parser.v.osc.command, frag.initial);
       break;
 
     case DCS:
       if(vt->parser.callbacks && vt->parser.callbacks->dcs)
         (*vt->parser.callbacks->dcs)(vt->parser.v.dcs.command, vt->parser.v.dcs.commandlen, frag, vt->parser.cbdata);
+      PROFILE_END(vt, start, VTERM_PROFILE_DCS, dcs_profile_command(vt), frag.initial);
       break;
 
     case APC:
       if(vt->parser.callbacks && vt->parser.callbacks->apc)
         (*vt->parser.callbacks->apc)(frag, vt->parser.cbdata);
+      PROFILE_END(vt, start, VTERM_PROFILE_APC, 0, frag.initial);
       break;
 
     case PM:
       if(vt->parser.callbacks && vt->parser.callbacks->pm)
         (*vt->parser.callbacks->pm)(frag, vt->parser.cbdata);
+      PROFILE_END(vt, start, VTERM_PROFILE_PM, 0, frag.initial);
       break;
 
     case SOS:
       if(vt->parser.callbacks && vt->parser.callbacks->sos)
         (*vt->parser.callbacks->sos)(frag, vt->parser.cbdata);
+      PROFILE_END(vt, start, VTERM_PROFILE_SOS, 0, frag.initial);
       break;
 
     case NORMAL:
@@ -138,7 +172,7 @@ size_t vterm_input_write(VTerm *vt, const char *bytes, size_t len)
 
   for( ; pos < len; pos++) {
     unsigned char c = bytes[pos];
-    bool c1_allowed = !vt->mode.utf8;
+    bool c1_allowed = !vt->mode.utf8 && !vt->legacy_encoding;
 
     if(c == 0x00 || c == 0x7f) { // NUL, DEL
       if(IS_STRING_STATE()) {
@@ -360,8 +394,10 @@ string_state:
       }
       else {
         size_t eaten = 0;
+        uint64_t start = PROFILE_START(vt);
         if(vt->parser.callbacks && vt->parser.callbacks->text)
           eaten = (*vt->parser.callbacks->text)(bytes + pos, len - pos, vt->parser.cbdata);
+        PROFILE_END(vt, start, VTERM_PROFILE_TEXT, 0, 1);
 
         if(!eaten) {
           DEBUG_LOG("libvterm: Text callback did not consume any input\n");
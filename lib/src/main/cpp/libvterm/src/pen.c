@@ -125,10 +125,32 @@ static void setpenattr(VTermState *state, VTermAttr attr, VTermValueType type, V
     return;
   }
 #endif
-  if(state->callbacks && state->callbacks->setpenattr)
+  if(state->callbacks && state->callbacks->setpenattr && !state->callbacks->setpen)
     (*state->callbacks->setpenattr)(attr, val, state->cbdata);
 }
 
+/* Deliver the whole pen at once to a setpen-capable callback consumer */
+static void flushpen(VTermState *state)
+{
+  if(!state->callbacks || !state->callbacks->setpen)
+    return;
+
+  VTermScreenCellAttrs attrs = {
+    .bold      = state->pen.bold,
+    .underline = state->pen.underline,
+    .italic    = state->pen.italic,
+    .blink     = state->pen.blink,
+    .reverse   = state->pen.reverse,
+    .conceal   = state->pen.conceal,
+    .strike    = state->pen.strike,
+    .font      = state->pen.font,
+    .small     = state->pen.small,
+    .baseline  = state->pen.baseline,
+  };
+
+  (*state->callbacks->setpen)(&attrs, &state->pen.fg, &state->pen.bg, state->cbdata);
+}
+
 static void setpenattr_bool(VTermState *state, VTermAttr attr, int boolean)
 {
   VTermValue val = { .boolean = boolean };
@@ -167,7 +189,7 @@ INTERNAL void vterm_state_newpen(VTermState *state)
     lookup_default_colour_ansi(col, &state->colors[col]);
 }
 
-INTERNAL void vterm_state_resetpen(VTermState *state)
+static void resetpen(VTermState *state)
 {
   state->pen.bold = 0;      setpenattr_bool(state, VTERM_ATTR_BOLD, 0);
   state->pen.underline = 0; setpenattr_int (state, VTERM_ATTR_UNDERLINE, 0);
@@ -184,6 +206,32 @@ INTERNAL void vterm_state_resetpen(VTermState *state)
   state->pen.bg = state->default_bg;  setpenattr_col(state, VTERM_ATTR_BACKGROUND, state->default_bg);
 }
 
+INTERNAL void vterm_state_resetpen(VTermState *state)
+{
+  resetpen(state);
+  flushpen(state);
+}
+
+/* Tell the callbacks about every attribute of the pen */
+static void announcepen(VTermState *state)
+{
+  setpenattr_bool(state, VTERM_ATTR_BOLD,      state->pen.bold);
+  setpenattr_int (state, VTERM_ATTR_UNDERLINE, state->pen.underline);
+  setpenattr_bool(state, VTERM_ATTR_ITALIC,    state->pen.italic);
+  setpenattr_bool(state, VTERM_ATTR_BLINK,     state->pen.blink);
+  setpenattr_bool(state, VTERM_ATTR_REVERSE,   state->pen.reverse);
+  setpenattr_bool(state, VTERM_ATTR_CONCEAL,   state->pen.conceal);
+  setpenattr_bool(state, VTERM_ATTR_STRIKE,    state->pen.strike);
+  setpenattr_int (state, VTERM_ATTR_FONT,      state->pen.font);
+  setpenattr_bool(state, VTERM_ATTR_SMALL,     state->pen.small);
+  setpenattr_int (state, VTERM_ATTR_BASELINE,  state->pen.baseline);
+
+  setpenattr_col( state, VTERM_ATTR_FOREGROUND, state->pen.fg);
+  setpenattr_col( state, VTERM_ATTR_BACKGROUND, state->pen.bg);
+
+  flushpen(state);
+}
+
 INTERNAL void vterm_state_savepen(VTermState *state, int save)
 {
   if(save) {
@@ -191,23 +239,22 @@ INTERNAL void vterm_state_savepen(VTermState *state, int save)
   }
   else {
     state->pen = state->saved.pen;
-
-    setpenattr_bool(state, VTERM_ATTR_BOLD,      state->pen.bold);
-    setpenattr_int (state, VTERM_ATTR_UNDERLINE, state->pen.underline);
-    setpenattr_bool(state, VTERM_ATTR_ITALIC,    state->pen.italic);
-    setpenattr_bool(state, VTERM_ATTR_BLINK,     state->pen.blink);
-    setpenattr_bool(state, VTERM_ATTR_REVERSE,   state->pen.reverse);
-    setpenattr_bool(state, VTERM_ATTR_CONCEAL,   state->pen.conceal);
-    setpenattr_bool(state, VTERM_ATTR_STRIKE,    state->pen.strike);
-    setpenattr_int (state, VTERM_ATTR_FONT,      state->pen.font);
-    setpenattr_bool(state, VTERM_ATTR_SMALL,     state->pen.small);
-    setpenattr_int (state, VTERM_ATTR_BASELINE,  state->pen.baseline);
-
-    setpenattr_col( state, VTERM_ATTR_FOREGROUND, state->pen.fg);
-    setpenattr_col( state, VTERM_ATTR_BACKGROUND, state->pen.bg);
+    announcepen(state);
   }
 }
 
+void vterm_state_copy_pen(VTermState *state, const VTermState *from)
+{
+  state->default_fg = from->default_fg;
+  state->default_bg = from->default_bg;
+  for(int i = 0; i < 16; i++)
+    state->colors[i] = from->colors[i];
+  state->bold_is_highbright = from->bold_is_highbright;
+
+  state->pen = from->pen;
+  announcepen(state);
+}
+
 int vterm_color_is_equal(const VTermColor *a, const VTermColor *b)
 {
   /* First make sure that the two colours are of the same type (RGB/Indexed) */
@@ -273,10 +320,8 @@ void vterm_state_set_bold_highbright(VTermState *state, int bold_is_highbright)
   state->bold_is_highbright = bold_is_highbright;
 }
 
-INTERNAL void vterm_state_setpen(VTermState *state, const long args[], int argcount)
+static void setpen_args(VTermState *state, const long args[], int argcount)
 {
-  // SGR - ECMA-48 8.3.117
-
   int argi = 0;
   int value;
 
@@ -289,7 +334,7 @@ INTERNAL void vterm_state_setpen(VTermState *state, const long args[], int argco
     switch(arg = CSI_ARG(args[argi])) {
     case CSI_ARG_MISSING:
     case 0: // Reset
-      vterm_state_resetpen(state);
+      resetpen(state);
       break;
 
     case 1: { // Bold on
@@ -468,6 +513,13 @@ INTERNAL void vterm_state_setpen(VTermState *state, const long args[], int argco
   }
 }
 
+INTERNAL void vterm_state_setpen(VTermState *state, const long args[], int argcount)
+{
+  // SGR - ECMA-48 8.3.117
+  setpen_args(state, args, argcount);
+  flushpen(state);
+}
+
 static int vterm_state_getpen_color(const VTermColor *col, int argi, long args[], int fg)
 {
     /* Do nothing if the given color is the default color */
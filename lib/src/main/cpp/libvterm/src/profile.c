@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "vterm_internal.h"
+
+#include <string.h>
+#include <time.h>
+
+/* Open-addressed table keyed on (kind, command). Real workloads use a few
+ * dozen distinct sequences, so a full table simply stops adding new ones */
+#define PROFILE_SLOTS 512
+
+struct VTermProfile {
+  int sample_every;
+  int until_sample;
+
+  int nentries;
+  VTermProfileEntry entries[PROFILE_SLOTS];
+  unsigned char used[PROFILE_SLOTS];
+};
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static VTermProfileEntry *lookup(struct VTermProfile *profile, VTermProfileKind kind, int32_t command)
+{
+  uint32_t hash = ((uint32_t)command * 2654435761u) ^ kind;
+
+  for(int probe = 0; probe < PROFILE_SLOTS; probe++) {
+    int slot = (hash + probe) % PROFILE_SLOTS;
+
+    if(!profile->used[slot]) {
+      profile->used[slot] = 1;
+      profile->nentries++;
+      profile->entries[slot] = (VTermProfileEntry){ .kind = kind, .command = command };
+      return &profile->entries[slot];
+    }
+
+    VTermProfileEntry *entry = &profile->entries[slot];
+    if(entry->kind == kind && entry->command == command)
+      return entry;
+  }
+
+  return NULL;
+}
+
+INTERNAL void vterm_profile_free(VTerm *vt)
+{
+  if(vt->profile)
+    vterm_allocator_free(vt, vt->profile);
+  vt->profile = NULL;
+}
+
+INTERNAL uint64_t vterm_profile_start(VTerm *vt)
+{
+  struct VTermProfile *profile = vt->profile;
+
+  if(--profile->until_sample > 0)
+    return 0;
+
+  profile->until_sample = profile->sample_every;
+  return now_ns();
+}
+
+INTERNAL void vterm_profile_end(VTerm *vt, uint64_t start, VTermProfileKind kind, int32_t command, int counts)
+{
+  VTermProfileEntry *entry = lookup(vt->profile, kind, command);
+  if(!entry)
+    return;
+
+  if(counts)
+    entry->count++;
+
+  if(start) {
+    entry->sampled++;
+    entry->sampled_ns += now_ns() - start;
+  }
+}
+
+void vterm_profile_enable(VTerm *vt, int sample_every)
+{
+  if(sample_every <= 0) {
+    vterm_profile_free(vt);
+    return;
+  }
+
+  if(!vt->profile) {
+    vt->profile = vterm_allocator_malloc(vt, sizeof(struct VTermProfile));
+    vterm_profile_reset(vt);
+  }
+
+  vt->profile->sample_every = sample_every;
+  vt->profile->until_sample = sample_every;
+}
+
+void vterm_profile_reset(VTerm *vt)
+{
+  struct VTermProfile *profile = vt->profile;
+  if(!profile)
+    return;
+
+  profile->nentries = 0;
+  memset(profile->used, 0, sizeof(profile->used));
+}
+
+int vterm_profile_get(const VTerm *vt, VTermProfileEntry *entries, int len)
+{
+  const struct VTermProfile *profile = vt->profile;
+  if(!profile)
+    return 0;
+
+  int n = 0;
+  for(int slot = 0; slot < PROFILE_SLOTS; slot++) {
+    if(!profile->used[slot])
+      continue;
+    if(n < len)
+      entries[n] = profile->entries[slot];
+    n++;
+  }
+
+  return n;
+}
@@ -70,6 +70,11 @@ struct VTermScreen
   /* buffer for a single screen row used in scrollback storage callbacks */
   VTermScreenCell *sb_buffer;
 
+  /* Per-row count of cells with the blink attribute, for each buffer. NULL
+   * while that buffer has no blinking cells, so screens that never use blink
+   * only pay for a pointer test */
+  int *blink_rows[2];
+
   ScreenPen pen;
 };
 
@@ -88,6 +93,78 @@ static inline ScreenCell *getcell(const VTermScreen *screen, int row, int col)
   return screen->buffer + (screen->cols * row) + col;
 }
 
+static inline int *blinkrows(const VTermScreen *screen)
+{
+  return screen->blink_rows[screen->buffer == screen->buffers[BUFIDX_ALTSCREEN] ? BUFIDX_ALTSCREEN : BUFIDX_PRIMARY];
+}
+
+static int blink_count(const VTermScreen *screen, int row, int start_col, int end_col)
+{
+  const ScreenCell *cell = getcell(screen, row, start_col);
+  int count = 0;
+  for(int col = start_col; col < end_col; col++, cell++)
+    count += cell->pen.blink;
+  return count;
+}
+
+/* Drop the cells of rect from the blink counts, before they are rewritten */
+static void blink_forget(VTermScreen *screen, VTermRect rect)
+{
+  int *counts = blinkrows(screen);
+  if(!counts)
+    return;
+
+  for(int row = rect.start_row; row < rect.end_row && row < screen->rows; row++)
+    counts[row] -= blink_count(screen, row, rect.start_col, rect.end_col);
+}
+
+/* Add the cells of rect to the blink counts, after they have been rewritten.
+ * may_blink says the write could have introduced blinking cells into a buffer
+ * that had none */
+static void blink_note(VTermScreen *screen, VTermRect rect, int may_blink)
+{
+  int bufidx = screen->buffer == screen->buffers[BUFIDX_ALTSCREEN] ? BUFIDX_ALTSCREEN : BUFIDX_PRIMARY;
+
+  if(!screen->blink_rows[bufidx]) {
+    if(!may_blink)
+      return;
+
+    screen->blink_rows[bufidx] = vterm_allocator_malloc(screen->vt, sizeof(int) * screen->rows);
+    memset(screen->blink_rows[bufidx], 0, sizeof(int) * screen->rows);
+  }
+
+  int *counts = screen->blink_rows[bufidx];
+  for(int row = rect.start_row; row < rect.end_row && row < screen->rows; row++)
+    counts[row] += blink_count(screen, row, rect.start_col, rect.end_col);
+}
+
+/* Recount a whole buffer after it has been rebuilt */
+static void blink_recount(VTermScreen *screen, int bufidx)
+{
+  if(screen->blink_rows[bufidx]) {
+    vterm_allocator_free(screen->vt, screen->blink_rows[bufidx]);
+    screen->blink_rows[bufidx] = NULL;
+  }
+
+  ScreenCell *buffer = screen->buffers[bufidx];
+  if(!buffer)
+    return;
+
+  for(int row = 0; row < screen->rows; row++) {
+    int count = 0;
+    for(int col = 0; col < screen->cols; col++)
+      count += buffer[row * screen->cols + col].pen.blink;
+    if(!count)
+      continue;
+
+    if(!screen->blink_rows[bufidx]) {
+      screen->blink_rows[bufidx] = vterm_allocator_malloc(screen->vt, sizeof(int) * screen->rows);
+      memset(screen->blink_rows[bufidx], 0, sizeof(int) * screen->rows);
+    }
+    screen->blink_rows[bufidx][row] = count;
+  }
+}
+
 static ScreenCell *alloc_buffer(VTermScreen *screen, int rows, int cols)
 {
   ScreenCell *new_buffer = vterm_allocator_malloc(screen->vt, sizeof(ScreenCell) * rows * cols);
@@ -178,6 +255,15 @@ static int putglyph(VTermGlyphInfo *info, VTermPos pos, void *user)
   if(!cell)
     return 0;
 
+  VTermRect rect = {
+    .start_row = pos.row,
+    .end_row   = pos.row+1,
+    .start_col = pos.col,
+    .end_col   = pos.col+info->width,
+  };
+
+  blink_forget(screen, rect);
+
   int i;
   for(i = 0; i < VTERM_MAX_CHARS_PER_CELL && info->chars[i]; i++) {
     cell->chars[i] = info->chars[i];
@@ -189,46 +275,97 @@ static int putglyph(VTermGlyphInfo *info, VTermPos pos, void *user)
   for(int col = 1; col < info->width; col++)
     getcell(screen, pos.row, pos.col + col)->chars[0] = (uint32_t)-1;
 
+  cell->pen.protected_cell = info->protected_cell;
+  cell->pen.dwl            = info->dwl;
+  cell->pen.dhl            = info->dhl;
+
+  blink_note(screen, rect, screen->pen.blink);
+
+  damagerect(screen, rect);
+
+  return 1;
+}
+
+static int repeatglyph(VTermGlyphInfo *info, VTermPos pos, int count, void *user)
+{
+  VTermScreen *screen = user;
+
+  if(pos.row < 0 || pos.row >= screen->rows || pos.col < 0 ||
+     pos.col + count * info->width > screen->cols)
+    return 0;
+
+  ScreenCell proto;
+  int i;
+  for(i = 0; i < VTERM_MAX_CHARS_PER_CELL && info->chars[i]; i++)
+    proto.chars[i] = info->chars[i];
+  if(i < VTERM_MAX_CHARS_PER_CELL)
+    proto.chars[i] = 0;
+
+  proto.pen = screen->pen;
+  proto.pen.protected_cell = info->protected_cell;
+  proto.pen.dwl            = info->dwl;
+  proto.pen.dhl            = info->dhl;
+
   VTermRect rect = {
     .start_row = pos.row,
     .end_row   = pos.row+1,
     .start_col = pos.col,
-    .end_col   = pos.col+info->width,
+    .end_col   = pos.col + count * info->width,
   };
 
-  cell->pen.protected_cell = info->protected_cell;
-  cell->pen.dwl            = info->dwl;
-  cell->pen.dhl            = info->dhl;
+  blink_forget(screen, rect);
+
+  ScreenCell *cell = getcell(screen, pos.row, pos.col);
+  for(int n = 0; n < count; n++) {
+    *cell++ = proto;
+    for(int col = 1; col < info->width; col++)
+      (cell++)->chars[0] = (uint32_t)-1;
+  }
+
+  blink_note(screen, rect, proto.pen.blink);
 
   damagerect(screen, rect);
 
   return 1;
 }
 
-static void sb_pushline_from_row(VTermScreen *screen, int row)
+#define HAS_SB_PUSHLINE(screen) \
+  ((screen)->callbacks && ((screen)->callbacks->sb_pushline || (screen)->callbacks->sb_pushline4))
+
+static void sb_pushline_from_row(VTermScreen *screen, int row, bool continuation)
 {
   VTermPos pos = { .row = row };
   for(pos.col = 0; pos.col < screen->cols; pos.col++)
     vterm_screen_get_cell(screen, pos, screen->sb_buffer + pos.col);
 
-  (screen->callbacks->sb_pushline)(screen->cols, screen->sb_buffer, screen->cbdata);
+  if(screen->callbacks->sb_pushline4)
+    (screen->callbacks->sb_pushline4)(screen->cols, screen->sb_buffer, continuation, screen->cbdata);
+  else
+    (screen->callbacks->sb_pushline)(screen->cols, screen->sb_buffer, screen->cbdata);
 }
 
 static int moverect_internal(VTermRect dest, VTermRect src, void *user)
 {
   VTermScreen *screen = user;
 
-  if(screen->callbacks && screen->callbacks->sb_pushline &&
+  if(HAS_SB_PUSHLINE(screen) &&
      dest.start_row == 0 && dest.start_col == 0 &&        // starts top-left corner
      dest.end_col == screen->cols &&                      // full width
      screen->buffer == screen->buffers[BUFIDX_PRIMARY]) { // not altscreen
+    const VTermState *state = screen->state;
     for(int row = 0; row < src.start_row; row++)
-      sb_pushline_from_row(screen, row);
+      sb_pushline_from_row(screen, row,
+          row < state->scrolled_rows && state->scrolled_lineinfo[row].continuation);
   }
 
   int cols = src.end_col - src.start_col;
   int downward = src.start_row - dest.start_row;
 
+  int *blink = blinkrows(screen);
+  int blink_fullwidth = blink && dest.start_col == 0 && dest.end_col == screen->cols;
+  if(blink && !blink_fullwidth)
+    blink_forget(screen, dest);
+
   int init_row, test_row, inc_row;
   if(downward < 0) {
     init_row = dest.end_row - 1;
@@ -246,6 +383,13 @@ static int moverect_internal(VTermRect dest, VTermRect src, void *user)
             getcell(screen, row + downward, src.start_col),
             cols * sizeof(ScreenCell));
 
+  if(blink_fullwidth)
+    /* Whole rows moved; their counts move with them */
+    memmove(blink + dest.start_row, blink + src.start_row,
+            (dest.end_row - dest.start_row) * sizeof(int));
+  else if(blink)
+    blink_note(screen, dest, 0);
+
   return 1;
 }
 
@@ -271,6 +415,8 @@ static int erase_internal(VTermRect rect, int selective, void *user)
 {
   VTermScreen *screen = user;
 
+  blink_forget(screen, rect);
+
   for(int row = rect.start_row; row < screen->state->rows && row < rect.end_row; row++) {
     const VTermLineInfo *info = vterm_state_get_lineinfo(screen->state, row);
 
@@ -291,6 +437,10 @@ static int erase_internal(VTermRect rect, int selective, void *user)
     }
   }
 
+  /* Only a selective erase can leave blinking cells behind */
+  if(selective)
+    blink_note(screen, rect, 0);
+
   return 1;
 }
 
@@ -309,6 +459,110 @@ static int erase(VTermRect rect, int selective, void *user)
   return erase_user(rect, 0, user);
 }
 
+static int fillrect(VTermRect rect, VTermGlyphInfo *info, void *user)
+{
+  VTermScreen *screen = user;
+
+  ScreenCell proto = { 0 };
+  int i;
+  for(i = 0; i < VTERM_MAX_CHARS_PER_CELL && info->chars[i]; i++)
+    proto.chars[i] = info->chars[i];
+  if(i < VTERM_MAX_CHARS_PER_CELL)
+    proto.chars[i] = 0;
+
+  proto.pen = screen->pen;
+  proto.pen.protected_cell = info->protected_cell;
+
+  blink_forget(screen, rect);
+
+  for(int row = rect.start_row; row < rect.end_row; row++) {
+    const VTermLineInfo *lineinfo = vterm_state_get_lineinfo(screen->state, row);
+    proto.pen.dwl = lineinfo->doublewidth;
+    proto.pen.dhl = lineinfo->doubleheight;
+
+    ScreenCell *cell = getcell(screen, row, rect.start_col);
+    for(int col = rect.start_col; col < rect.end_col; col++)
+      *cell++ = proto;
+  }
+
+  blink_note(screen, rect, proto.pen.blink);
+
+  damagerect(screen, rect);
+
+  return 1;
+}
+
+static int copyrect(VTermRect dest, VTermRect src, void *user)
+{
+  VTermScreen *screen = user;
+
+  int cols = src.end_col - src.start_col;
+  int downward = src.start_row - dest.start_row;
+
+  blink_forget(screen, dest);
+
+  int init_row, test_row, inc_row;
+  if(downward < 0) {
+    init_row = dest.end_row - 1;
+    test_row = dest.start_row - 1;
+    inc_row  = -1;
+  }
+  else {
+    init_row = dest.start_row;
+    test_row = dest.end_row;
+    inc_row  = +1;
+  }
+
+  for(int row = init_row; row != test_row; row += inc_row) {
+    ScreenCell *cell = getcell(screen, row, dest.start_col);
+    memmove(cell,
+            getcell(screen, row + downward, src.start_col),
+            cols * sizeof(ScreenCell));
+
+    // Cells keep the line size of their destination row
+    const VTermLineInfo *lineinfo = vterm_state_get_lineinfo(screen->state, row);
+    for(int col = 0; col < cols; col++) {
+      cell[col].pen.dwl = lineinfo->doublewidth;
+      cell[col].pen.dhl = lineinfo->doubleheight;
+    }
+  }
+
+  blink_note(screen, dest, 0);
+
+  damagerect(screen, dest);
+
+  return 1;
+}
+
+static int changeattrs(VTermRect rect, const VTermScreenCellAttrs *attrs, const VTermScreenCellAttrs *mask, void *user)
+{
+  VTermScreen *screen = user;
+
+  blink_forget(screen, rect);
+
+  for(int row = rect.start_row; row < rect.end_row; row++) {
+    ScreenCell *cell = getcell(screen, row, rect.start_col);
+    for(int col = rect.start_col; col < rect.end_col; col++, cell++) {
+      if(mask->bold)      cell->pen.bold      = attrs->bold;
+      if(mask->underline) cell->pen.underline = attrs->underline;
+      if(mask->blink)     cell->pen.blink     = attrs->blink;
+      if(mask->reverse)   cell->pen.reverse   = attrs->reverse;
+      if(mask->conceal)   cell->pen.conceal   = attrs->conceal;
+      if(mask->italic)    cell->pen.italic    = attrs->italic;
+      if(mask->strike)    cell->pen.strike    = attrs->strike;
+      if(mask->font)      cell->pen.font      = attrs->font;
+      if(mask->small)     cell->pen.small     = attrs->small;
+      if(mask->baseline)  cell->pen.baseline  = attrs->baseline;
+    }
+  }
+
+  blink_note(screen, rect, mask->blink && attrs->blink);
+
+  damagerect(screen, rect);
+
+  return 1;
+}
+
 static int scrollrect(VTermRect rect, int downward, int rightward, void *user)
 {
   VTermScreen *screen = user;
@@ -452,6 +706,28 @@ static int setpenattr(VTermAttr attr, VTermValue *val, void *user)
   return 0;
 }
 
+static int setpen(const VTermScreenCellAttrs *attrs, const VTermColor *fg, const VTermColor *bg, void *user)
+{
+  VTermScreen *screen = user;
+
+  screen->pen.bold      = attrs->bold;
+  screen->pen.underline = attrs->underline;
+  screen->pen.italic    = attrs->italic;
+  screen->pen.blink     = attrs->blink;
+  screen->pen.reverse   = attrs->reverse;
+  screen->pen.conceal   = attrs->conceal;
+  screen->pen.strike    = attrs->strike;
+  screen->pen.font      = attrs->font;
+  screen->pen.small     = attrs->small;
+  screen->pen.baseline  = attrs->baseline;
+
+  // A default color in the pen may predate a change of the defaults
+  screen->pen.fg = VTERM_COLOR_IS_DEFAULT_FG(fg) ? screen->state->default_fg : *fg;
+  screen->pen.bg = VTERM_COLOR_IS_DEFAULT_BG(bg) ? screen->state->default_bg : *bg;
+
+  return 1;
+}
+
 static int settermprop(VTermProp prop, VTermValue *val, void *user)
 {
   VTermScreen *screen = user;
@@ -534,7 +810,7 @@ static void resize_buffer(VTermScreen *screen, int bufidx, int new_rows, int new
   while(old_row >= 0) {
     int old_row_end = old_row;
     /* TODO: Stop if dwl or dhl */
-    while(REFLOW && old_lineinfo && old_row >= 0 && old_lineinfo[old_row].continuation)
+    while(REFLOW && old_lineinfo && old_row > 0 && old_lineinfo[old_row].continuation)
       old_row--;
     int old_row_start = old_row;
 
@@ -667,9 +943,9 @@ static void resize_buffer(VTermScreen *screen, int bufidx, int new_rows, int new
 
   if(old_row >= 0 && bufidx == BUFIDX_PRIMARY) {
     /* Push spare lines to scrollback buffer */
-    if(screen->callbacks && screen->callbacks->sb_pushline)
+    if(HAS_SB_PUSHLINE(screen))
       for(int row = 0; row <= old_row; row++)
-        sb_pushline_from_row(screen, row);
+        sb_pushline_from_row(screen, row, old_lineinfo && old_lineinfo[row].continuation);
     if(active)
       statefields->pos.row -= (old_row + 1);
   }
@@ -780,6 +1056,9 @@ static int resize(int new_rows, int new_cols, VTermStateFields *fields, void *us
   screen->rows = new_rows;
   screen->cols = new_cols;
 
+  blink_recount(screen, BUFIDX_PRIMARY);
+  blink_recount(screen, BUFIDX_ALTSCREEN);
+
   if(new_cols <= old_cols) {
     if(screen->sb_buffer)
       vterm_allocator_free(screen->vt, screen->sb_buffer);
@@ -837,17 +1116,53 @@ static int sb_clear(void *user) {
   return 0;
 }
 
+#ifdef VTERM_FUSED_SCREEN
+int vterm_screen_on_putglyph(VTermGlyphInfo *info, VTermPos pos, void *user)
+{
+  return putglyph(info, pos, user);
+}
+
+int vterm_screen_on_repeatglyph(VTermGlyphInfo *info, VTermPos pos, int count, void *user)
+{
+  return repeatglyph(info, pos, count, user);
+}
+
+int vterm_screen_on_movecursor(VTermPos pos, VTermPos oldpos, int visible, void *user)
+{
+  return movecursor(pos, oldpos, visible, user);
+}
+
+int vterm_screen_on_scrollrect(VTermRect rect, int downward, int rightward, void *user)
+{
+  return scrollrect(rect, downward, rightward, user);
+}
+
+int vterm_screen_on_erase(VTermRect rect, int selective, void *user)
+{
+  return erase(rect, selective, user);
+}
+
+# define FUSED_CALLBACK(name) &vterm_screen_on_##name
+#else
+# define FUSED_CALLBACK(name) &name
+#endif
+
 static VTermStateCallbacks state_cbs = {
-  .putglyph    = &putglyph,
-  .movecursor  = &movecursor,
-  .scrollrect  = &scrollrect,
-  .erase       = &erase,
+  .putglyph    = FUSED_CALLBACK(putglyph),
+  .movecursor  = FUSED_CALLBACK(movecursor),
+  .scrollrect  = FUSED_CALLBACK(scrollrect),
+  .erase       = FUSED_CALLBACK(erase),
   .setpenattr  = &setpenattr,
   .settermprop = &settermprop,
   .bell        = &bell,
   .resize      = &resize,
   .setlineinfo = &setlineinfo,
   .sb_clear    = &sb_clear,
+  .repeatglyph = FUSED_CALLBACK(repeatglyph),
+  .setpen      = &setpen,
+  .fillrect    = &fillrect,
+  .copyrect    = &copyrect,
+  .changeattrs = &changeattrs,
 };
 
 static VTermScreen *screen_new(VTerm *vt)
@@ -881,6 +1196,9 @@ static VTermScreen *screen_new(VTerm *vt)
 
   screen->buffer = screen->buffers[BUFIDX_PRIMARY];
 
+  screen->blink_rows[BUFIDX_PRIMARY]   = NULL;
+  screen->blink_rows[BUFIDX_ALTSCREEN] = NULL;
+
   screen->sb_buffer = vterm_allocator_malloc(screen->vt, sizeof(VTermScreenCell) * cols);
 
   vterm_state_set_callbacks(screen->state, &state_cbs, screen);
@@ -894,6 +1212,10 @@ INTERNAL void vterm_screen_free(VTermScreen *screen)
   if(screen->buffers[BUFIDX_ALTSCREEN])
     vterm_allocator_free(screen->vt, screen->buffers[BUFIDX_ALTSCREEN]);
 
+  for(int bufidx = BUFIDX_PRIMARY; bufidx <= BUFIDX_ALTSCREEN; bufidx++)
+    if(screen->blink_rows[bufidx])
+      vterm_allocator_free(screen->vt, screen->blink_rows[bufidx]);
+
   vterm_allocator_free(screen->vt, screen->sb_buffer);
 
   vterm_allocator_free(screen->vt, screen);
@@ -1047,6 +1369,7 @@ void vterm_screen_enable_altscreen(VTermScreen *screen, int altscreen)
     vterm_get_size(screen->vt, &rows, &cols);
 
     screen->buffers[BUFIDX_ALTSCREEN] = alloc_buffer(screen, rows, cols);
+    blink_recount(screen, BUFIDX_ALTSCREEN);
   }
 }
 
@@ -1088,6 +1411,38 @@ void vterm_screen_flush_damage(VTermScreen *screen)
   }
 }
 
+int vterm_screen_damage_blink(VTermScreen *screen)
+{
+  const int *counts = blinkrows(screen);
+  if(!counts)
+    return 0;
+
+  int blinking = 0;
+  VTermRect rect = {
+    .start_col = 0,
+    .end_col   = screen->cols,
+  };
+
+  for(int row = 0; row < screen->rows; row++) {
+    if(!counts[row])
+      continue;
+
+    blinking++;
+
+    /* Damage runs of adjacent blinking rows together */
+    rect.start_row = row;
+    while(row + 1 < screen->rows && counts[row + 1]) {
+      row++;
+      blinking++;
+    }
+    rect.end_row = row + 1;
+
+    damagerect(screen, rect);
+  }
+
+  return blinking;
+}
+
 void vterm_screen_set_damage_merge(VTermScreen *screen, VTermDamageSize size)
 {
   vterm_screen_flush_damage(screen);
@@ -1152,6 +1507,131 @@ int vterm_screen_get_attrs_extent(const VTermScreen *screen, VTermRect *extent,
   return 1;
 }
 
+static int is_one_of(uint32_t c, const char *set)
+{
+  return c > 0 && c < 0x80 && strchr(set, c);
+}
+
+/* Character class of a cell for selection; cells of equal class are joined */
+static int select_class(const ScreenCell *cell, VTermSelectMode mode)
+{
+  uint32_t c = cell->chars[0];
+  if(c == 0 || c == UNICODE_SPACE)
+    return 0;
+
+  int alnum = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+              c == '_' || c >= 0x80;
+
+  switch(mode) {
+  case VTERM_SELECT_WORD:
+    return alnum ? 1 : 2;
+  case VTERM_SELECT_TOKEN:
+    return 1;
+  case VTERM_SELECT_PATH:
+    return alnum || is_one_of(c, "/.-~+@%,=") ? 1 : 2;
+  case VTERM_SELECT_URL:
+    return alnum || is_one_of(c, "-._~:/?#[]@!$&'()*+,;=%") ? 1 : 2;
+  default:
+    return 1;
+  }
+}
+
+/* Step pos one cell backward or forward, following soft wraps. Returns 0 at
+ * the end of the logical line */
+static int select_step(const VTermScreen *screen, VTermPos *pos, int dir)
+{
+  if(dir < 0) {
+    if(pos->col > 0) {
+      pos->col--;
+      return 1;
+    }
+    if(pos->row == 0 || !vterm_state_get_lineinfo(screen->state, pos->row)->continuation)
+      return 0;
+    pos->row--;
+    pos->col = screen->cols - 1;
+    return 1;
+  }
+
+  if(pos->col < screen->cols - 1) {
+    pos->col++;
+    return 1;
+  }
+  if(pos->row == screen->rows - 1 || !vterm_state_get_lineinfo(screen->state, pos->row + 1)->continuation)
+    return 0;
+  pos->row++;
+  pos->col = 0;
+  return 1;
+}
+
+static int select_joins(const VTermScreen *screen, const ScreenCell *target, int class, VTermSelectMode mode, VTermPos pos)
+{
+  const ScreenCell *cell = getcell(screen, pos.row, pos.col);
+
+  // The right half of a wide character goes with its left half
+  while(cell->chars[0] == (uint32_t)-1 && pos.col > 0)
+    cell = getcell(screen, pos.row, --pos.col);
+
+  if(mode == VTERM_SELECT_STYLE)
+    return !attrs_differ(VTERM_ALL_ATTRS_MASK, (ScreenCell *)target, (ScreenCell *)cell);
+
+  return select_class(cell, mode) == class;
+}
+
+int vterm_screen_get_select_extent(const VTermScreen *screen, VTermPos pos, VTermSelectMode mode, VTermPos *start, VTermPos *end)
+{
+  const ScreenCell *target = getcell(screen, pos.row, pos.col);
+  if(!target)
+    return 0;
+
+  while(target->chars[0] == (uint32_t)-1 && pos.col > 0)
+    target = getcell(screen, pos.row, --pos.col);
+
+  int class = select_class(target, mode);
+
+  VTermPos p = pos;
+  *start = pos;
+  while(select_step(screen, &p, -1) && select_joins(screen, target, class, mode, p))
+    *start = p;
+
+  p = pos;
+  VTermPos last = pos;
+  while(select_step(screen, &p, +1) && select_joins(screen, target, class, mode, p))
+    last = p;
+
+  if(mode == VTERM_SELECT_URL && class == 1) {
+    /* A bracket or quote around the URL, an unmatched closing bracket and
+     * trailing sentence punctuation are almost never part of it */
+    while(vterm_pos_cmp(*start, pos) < 0 &&
+          is_one_of(getcell(screen, start->row, start->col)->chars[0], "(['"))
+      select_step(screen, start, +1);
+
+    int parens = 0;
+    p = *start;
+    do {
+      uint32_t c = getcell(screen, p.row, p.col)->chars[0];
+      parens += (c == '(') - (c == ')');
+    } while(vterm_pos_cmp(p, last) < 0 && select_step(screen, &p, +1));
+
+    while(vterm_pos_cmp(last, pos) > 0) {
+      uint32_t c = getcell(screen, last.row, last.col)->chars[0];
+      if(c == ')' && parens < 0)
+        parens++;
+      else if(!is_one_of(c, ".,;:!?'"))
+        break;
+
+      select_step(screen, &last, -1);
+    }
+  }
+
+  *end = last;
+  /* Include the right half of a trailing wide character */
+  while(end->col < screen->cols - 1 && getcell(screen, end->row, end->col + 1)->chars[0] == (uint32_t)-1)
+    end->col++;
+  end->col++;
+
+  return 1;
+}
+
 void vterm_screen_convert_color_to_rgb(const VTermScreen *screen, VTermColor *col)
 {
   vterm_state_convert_color_to_rgb(screen->state, col);
@@ -22,12 +22,30 @@ static void putglyph(VTermState *state, const uint32_t chars[], int width, VTerm
   };
 
   if(state->callbacks && state->callbacks->putglyph)
-    if((*state->callbacks->putglyph)(&info, pos, state->cbdata))
+    if(STATE_CALLBACK(state, putglyph, &info, pos))
       return;
 
   DEBUG_LOG("libvterm: Unhandled putglyph U+%04x at (%d,%d)\n", chars[0], pos.col, pos.row);
 }
 
+static void repeatglyph(VTermState *state, const uint32_t chars[], int width, VTermPos pos, int count)
+{
+  VTermGlyphInfo info = {
+    .chars = chars,
+    .width = width,
+    .protected_cell = state->protected_cell,
+    .dwl = state->lineinfo[pos.row].doublewidth,
+    .dhl = state->lineinfo[pos.row].doubleheight,
+  };
+
+  if(state->callbacks && state->callbacks->repeatglyph)
+    if(STATE_CALLBACK(state, repeatglyph, &info, pos, count))
+      return;
+
+  for( ; count > 0; count--, pos.col += width)
+    putglyph(state, chars, width, pos);
+}
+
 static void updatecursor(VTermState *state, VTermPos *oldpos, int cancel_phantom)
 {
   if(state->pos.col == oldpos->col && state->pos.row == oldpos->row)
@@ -37,7 +55,7 @@ static void updatecursor(VTermState *state, VTermPos *oldpos, int cancel_phantom
     state->at_phantom = 0;
 
   if(state->callbacks && state->callbacks->movecursor)
-    if((*state->callbacks->movecursor)(state->pos, *oldpos, state->mode.cursor_visible, state->cbdata))
+    if(STATE_CALLBACK(state, movecursor, state->pos, *oldpos, state->mode.cursor_visible))
       return;
 }
 
@@ -52,7 +70,7 @@ static void erase(VTermState *state, VTermRect rect, int selective)
   }
 
   if(state->callbacks && state->callbacks->erase)
-    if((*state->callbacks->erase)(rect, selective, state->cbdata))
+    if(STATE_CALLBACK(state, erase, rect, selective))
       return;
 }
 
@@ -96,6 +114,10 @@ static VTermState *vterm_state_new(VTerm *vt)
   if(*state->encoding_utf8.enc->init)
     (*state->encoding_utf8.enc->init)(state->encoding_utf8.enc, state->encoding_utf8.data);
 
+  state->encoding_legacy.enc = vterm_lookup_legacy_encoding(vt->legacy_encoding);
+  if(state->encoding_legacy.enc && state->encoding_legacy.enc->init)
+    (*state->encoding_legacy.enc->init)(state->encoding_legacy.enc, state->encoding_legacy.data);
+
   return state;
 }
 
@@ -105,6 +127,8 @@ INTERNAL void vterm_state_free(VTermState *state)
   vterm_allocator_free(state->vt, state->lineinfos[BUFIDX_PRIMARY]);
   if(state->lineinfos[BUFIDX_ALTSCREEN])
     vterm_allocator_free(state->vt, state->lineinfos[BUFIDX_ALTSCREEN]);
+  if(state->scrolled_lineinfo)
+    vterm_allocator_free(state->vt, state->scrolled_lineinfo);
   vterm_allocator_free(state->vt, state->combine_chars);
   vterm_allocator_free(state->vt, state);
 }
@@ -131,6 +155,18 @@ static void scroll(VTermState *state, VTermRect rect, int downward, int rightwar
     int height = rect.end_row - rect.start_row - abs(downward);
 
     if(downward > 0) {
+      if(rect.start_row == 0) {
+        /* These rows may be pushed to the scrollback; keep their lineinfo
+         * around so the screen can tell which of them were wrapped */
+        if(state->scrolled_lineinfo_size < downward) {
+          if(state->scrolled_lineinfo)
+            vterm_allocator_free(state->vt, state->scrolled_lineinfo);
+          state->scrolled_lineinfo = vterm_allocator_malloc(state->vt, state->rows * sizeof(VTermLineInfo));
+          state->scrolled_lineinfo_size = state->rows;
+        }
+        memcpy(state->scrolled_lineinfo, state->lineinfo, downward * sizeof(state->lineinfo[0]));
+        state->scrolled_rows = downward;
+      }
       memmove(state->lineinfo + rect.start_row,
               state->lineinfo + rect.start_row + downward,
               height * sizeof(state->lineinfo[0]));
@@ -146,13 +182,14 @@ static void scroll(VTermState *state, VTermRect rect, int downward, int rightwar
     }
   }
 
-  if(state->callbacks && state->callbacks->scrollrect)
-    if((*state->callbacks->scrollrect)(rect, downward, rightward, state->cbdata))
-      return;
+  int handled = state->callbacks && state->callbacks->scrollrect &&
+      STATE_CALLBACK(state, scrollrect, rect, downward, rightward);
 
-  if(state->callbacks)
+  if(!handled && state->callbacks)
     vterm_scroll_rect(rect, downward, rightward,
         state->callbacks->moverect, state->callbacks->erase, state->cbdata);
+
+  state->scrolled_rows = 0;
 }
 
 static void linefeed(VTermState *state)
@@ -281,10 +318,17 @@ static int on_text(const char bytes[], size_t len, void *user)
   int npoints = 0;
   size_t eaten = 0;
 
+  /* A legacy trail byte can be ASCII, so one split from its lead byte by the
+   * end of the previous write still goes to the legacy decoder */
+  int legacy = state->encoding_legacy.enc != NULL;
+
   VTermEncodingInstance *encoding =
     state->gsingle_set     ? &state->encoding[state->gsingle_set] :
-    !(bytes[eaten] & 0x80) ? &state->encoding[state->gl_set] :
+    !(bytes[eaten] & 0x80) &&
+      !(legacy && vterm_legacy_pending(&state->encoding_legacy))
+                           ? &state->encoding[state->gl_set] :
     state->vt->mode.utf8   ? &state->encoding_utf8 :
+    legacy                 ? &state->encoding_legacy :
                              &state->encoding[state->gr_set];
 
   (*encoding->enc->decode)(encoding->enc, encoding->data,
@@ -923,6 +967,121 @@ static void request_version_string(VTermState *state)
       VTERM_VERSION_MAJOR, VTERM_VERSION_MINOR);
 }
 
+#define LBOUND(v,min) if((v) < (min)) (v) = (min)
+#define UBOUND(v,max) if((v) > (max)) (v) = (max)
+
+/* Argument i of a rectangular area operation; missing or zero gives def */
+static int rect_arg(const long args[], int argcount, int i, int def)
+{
+  if(i >= argcount || CSI_ARG_IS_MISSING(args[i]) || CSI_ARG(args[i]) == 0)
+    return def;
+  return CSI_ARG(args[i]);
+}
+
+/* Parse the Pt;Pl;Pb;Pr area at args[i] that the DEC rectangular area
+ * operations take. Coordinates are relative to the margins in origin mode and
+ * are clipped to the page or margins. Returns 0 if the area is empty
+ */
+static int rect_from_args(VTermState *state, const long args[], int argcount, int i, VTermRect *rect)
+{
+  int top = 0, left = 0, bottom = state->rows, right = state->cols;
+  if(state->mode.origin) {
+    top    = state->scrollregion_top;
+    left   = SCROLLREGION_LEFT(state);
+    bottom = SCROLLREGION_BOTTOM(state);
+    right  = SCROLLREGION_RIGHT(state);
+  }
+
+  rect->start_row = top  + rect_arg(args, argcount, i+0, 1) - 1;
+  rect->start_col = left + rect_arg(args, argcount, i+1, 1) - 1;
+  rect->end_row   = top  + rect_arg(args, argcount, i+2, bottom - top);
+  rect->end_col   = left + rect_arg(args, argcount, i+3, right - left);
+
+  UBOUND(rect->end_row, bottom);
+  UBOUND(rect->end_col, right);
+
+  return rect->start_row < rect->end_row && rect->start_col < rect->end_col;
+}
+
+static void fillrect(VTermState *state, uint32_t ch, VTermRect rect)
+{
+  uint32_t chars[2] = { ch, 0 };
+  VTermGlyphInfo info = {
+    .chars = chars,
+    .width = 1,
+    .protected_cell = state->protected_cell,
+  };
+
+  if(state->callbacks && state->callbacks->fillrect)
+    if((*state->callbacks->fillrect)(rect, &info, state->cbdata))
+      return;
+
+  for(VTermPos pos = { .row = rect.start_row, .col = rect.start_col }; pos.row < rect.end_row; pos.row++)
+    repeatglyph(state, chars, 1, pos, rect.end_col - rect.start_col);
+}
+
+static void copyrect(VTermState *state, const long args[], int argcount)
+{
+  VTermRect src, dest;
+  if(!rect_from_args(state, args, argcount, 0, &src))
+    return;
+
+  // Only one page is supported, so Pps and Ppd are ignored. The destination
+  // is given by its top-left corner and extends to the page or margins
+  long dest_args[] = {
+    argcount > 5 ? args[5] : (long)CSI_ARG_MISSING,
+    argcount > 6 ? args[6] : (long)CSI_ARG_MISSING,
+  };
+  if(!rect_from_args(state, dest_args, 2, 0, &dest))
+    return;
+
+  UBOUND(dest.end_row, dest.start_row + (src.end_row - src.start_row));
+  UBOUND(dest.end_col, dest.start_col + (src.end_col - src.start_col));
+  src.end_row = src.start_row + (dest.end_row - dest.start_row);
+  src.end_col = src.start_col + (dest.end_col - dest.start_col);
+
+  if(state->callbacks && state->callbacks->copyrect)
+    (*state->callbacks->copyrect)(dest, src, state->cbdata);
+}
+
+static void changeattrs(VTermState *state, const long args[], int argcount)
+{
+  VTermRect rect;
+  if(!rect_from_args(state, args, argcount, 0, &rect))
+    return;
+
+  VTermScreenCellAttrs attrs = { 0 }, mask = { 0 };
+
+  int argi = 4;
+  do {
+    // A missing attribute list behaves as 0
+    int arg = argi < argcount ? CSI_ARG_OR(args[argi], 0) : 0;
+
+    switch(arg) {
+    case 0:
+      mask.bold = mask.underline = mask.blink = mask.reverse = mask.conceal = 1;
+      attrs.bold = attrs.underline = attrs.blink = attrs.reverse = attrs.conceal = 0;
+      break;
+    case 1:  mask.bold = 1;      attrs.bold = 1; break;
+    case 4:  mask.underline = 1; attrs.underline = VTERM_UNDERLINE_SINGLE; break;
+    case 5:  mask.blink = 1;     attrs.blink = 1; break;
+    case 7:  mask.reverse = 1;   attrs.reverse = 1; break;
+    case 8:  mask.conceal = 1;   attrs.conceal = 1; break;
+    case 22: mask.bold = 1;      attrs.bold = 0; break;
+    case 24: mask.underline = 1; attrs.underline = VTERM_UNDERLINE_OFF; break;
+    case 25: mask.blink = 1;     attrs.blink = 0; break;
+    case 27: mask.reverse = 1;   attrs.reverse = 0; break;
+    case 28: mask.conceal = 1;   attrs.conceal = 0; break;
+    default:
+      DEBUG_LOG("libvterm: Unhandled DECCARA %d\n", arg);
+      break;
+    }
+  } while(++argi < argcount);
+
+  if(state->callbacks && state->callbacks->changeattrs)
+    (*state->callbacks->changeattrs)(rect, &attrs, &mask, state->cbdata);
+}
+
 static int on_csi(const char *leader, const long args[], int argcount, const char *intermed, char command, void *user)
 {
   VTermState *state = user;
@@ -969,9 +1128,6 @@ static int on_csi(const char *leader, const long args[], int argcount, const cha
   VTermRect rect;
   int selective;
 
-#define LBOUND(v,min) if((v) < (min)) (v) = (min)
-#define UBOUND(v,max) if((v) > (max)) (v) = (max)
-
 #define LEADER(l,b) ((l << 8) | b)
 #define INTERMED(i,b) ((i << 16) | b)
 
@@ -1231,14 +1387,20 @@ static int on_csi(const char *leader, const long args[], int argcount, const cha
 
   case 0x62: { // REP - ECMA-48 8.3.103
     const int row_width = THISROWWIDTH(state);
+    const int width = state->combine_width;
+    if(width < 1 || !state->combine_chars[0])
+      break;
     count = CSI_ARG_COUNT(args[0]);
     col = state->pos.col + count;
     UBOUND(col, row_width);
-    while (state->pos.col < col) {
-      putglyph(state, state->combine_chars, state->combine_width, state->pos);
-      state->pos.col += state->combine_width;
+    /* Glyphs that start before col, but never one hanging off the row end */
+    count = (col - state->pos.col + width - 1) / width;
+    UBOUND(count, (row_width - state->pos.col) / width);
+    if(count > 0) {
+      repeatglyph(state, state->combine_chars, width, state->pos, count);
+      state->pos.col += count * width;
     }
-    if (state->pos.col + state->combine_width >= row_width) {
+    if (state->pos.col + width >= row_width) {
       if (state->mode.autowrap) {
         state->at_phantom = 1;
         cancel_phantom = 0;
@@ -1250,8 +1412,8 @@ static int on_csi(const char *leader, const long args[], int argcount, const cha
   case 0x63: // DA - ECMA-48 8.3.24
     val = CSI_ARG_OR(args[0], 0);
     if(val == 0)
-      // DEC VT100 response
-      vterm_push_output_sprintf_ctrl(state->vt, C1_CSI, "?1;2c");
+      // DEC VT220 response; 22 = ANSI colour, 28 = rectangular editing
+      vterm_push_output_sprintf_ctrl(state->vt, C1_CSI, "?62;22;28c");
     break;
 
   case LEADER('>', 0x63): // DEC secondary Device Attributes
@@ -1477,6 +1639,10 @@ static int on_csi(const char *leader, const long args[], int argcount, const cha
 
     break;
 
+  case INTERMED('$', 0x72): // DECCARA - DEC change attributes in rectangular area
+    changeattrs(state, args, argcount);
+    break;
+
   case 0x73: // DECSLRM - DEC custom
     // Always allow setting these margins, just they won't take effect without DECVSSM
     state->scrollregion_left = CSI_ARG_OR(args[0], 1) - 1;
@@ -1506,6 +1672,27 @@ static int on_csi(const char *leader, const long args[], int argcount, const cha
 
     break;
 
+  case INTERMED('$', 0x76): // DECCRA - DEC copy rectangular area
+    copyrect(state, args, argcount);
+    break;
+
+  case INTERMED('$', 0x78): // DECFRA - DEC fill rectangular area
+    val = CSI_ARG_OR(args[0], 0);
+    // Only printable GL and GR characters may be used
+    if(!((val >= 0x20 && val <= 0x7e) || (val >= 0xa0 && val <= 0xff)))
+      break;
+
+    if(rect_from_args(state, args, argcount, 1, &rect))
+      fillrect(state, val, rect);
+    break;
+
+  case INTERMED('$', 0x7A): // DECERA - DEC erase rectangular area
+  case INTERMED('$', 0x7B): // DECSERA - DEC selective erase rectangular area
+    selective = (command == 0x7B);
+    if(rect_from_args(state, args, argcount, 0, &rect))
+      erase(state, rect, selective);
+    break;
+
   case INTERMED('\'', 0x7D): // DECIC
     count = CSI_ARG_COUNT(args[0]);
 
@@ -2253,6 +2440,94 @@ const VTermLineInfo *vterm_state_get_lineinfo(const VTermState *state, int row)
   return state->lineinfo + row;
 }
 
+int vterm_state_plain_text_ready(const VTermState *state)
+{
+  const VTerm *vt = state->vt;
+  if(vt->parser.state != NORMAL || vt->parser.in_esc)
+    return 0;
+  if(!vt->mode.utf8 || vt->legacy_encoding || vterm_utf8_pending(&state->encoding_utf8))
+    return 0;
+
+  /* ASCII goes through G0, which must pass it through unchanged */
+  const VTermEncoding *g0 = state->encoding[state->gl_set].enc;
+  if(state->gsingle_set ||
+     (g0 != vterm_lookup_encoding(ENC_UTF8, 'u') && g0 != vterm_lookup_encoding(ENC_SINGLE_94, 'B')))
+    return 0;
+
+  if(state->mode.alt_screen || !state->mode.autowrap || state->mode.insert || state->mode.leftrightmargin)
+    return 0;
+  if(state->scrollregion_top != 0 || SCROLLREGION_BOTTOM(state) != state->rows)
+    return 0;
+  if(state->protected_cell)
+    return 0;
+
+  const VTermLineInfo *info = state->lineinfo + state->pos.row;
+  return !info->doublewidth && !info->doubleheight;
+}
+
+/* The text is whole, valid UTF-8 */
+static uint32_t plain_text_next(const unsigned char *bytes, size_t *pos)
+{
+  unsigned char c = bytes[*pos];
+  if(c < 0x80) {
+    (*pos)++;
+    return c;
+  }
+
+  int trail = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+  uint32_t codepoint = c & (0x3f >> trail);
+  for(int i = 1; i <= trail; i++)
+    codepoint = (codepoint << 6) | (bytes[*pos + i] & 0x3f);
+  *pos += trail + 1;
+  return codepoint;
+}
+
+size_t vterm_state_plain_text_rows(const VTermState *state, const char *bytes_, size_t len)
+{
+  const unsigned char *bytes = (const unsigned char *)bytes_;
+  int cols = state->cols;
+  size_t rows = 0;
+  int col = 0;
+  int at_phantom = 0;
+
+  size_t pos = 0;
+  while(pos < len) {
+    if(bytes[pos] == '\r') {
+      rows++;
+      col = 0;
+      at_phantom = 0;
+      pos += 2;
+      continue;
+    }
+
+    /* Glyphs are grouped and wrapped as in on_text() */
+    int width = vterm_unicode_width(plain_text_next(bytes, &pos));
+    int chars = 1;
+    while(pos < len && bytes[pos] != '\r') {
+      size_t next = pos;
+      uint32_t codepoint = plain_text_next(bytes, &next);
+      if(!vterm_unicode_is_combining(codepoint))
+        break;
+      if(chars++ < VTERM_MAX_CHARS_PER_CELL)
+        width += vterm_unicode_width(codepoint);
+      pos = next;
+    }
+
+    if(at_phantom || col + width > cols) {
+      rows++;
+      col = 0;
+      at_phantom = 0;
+    }
+
+    if(col + width >= cols)
+      at_phantom = 1;
+    else
+      col += width;
+  }
+
+  return rows;
+}
+
 void vterm_state_set_selection_callbacks(VTermState *state, const VTermSelectionCallbacks *callbacks, void *user,
     char *buffer, size_t buflen)
 {
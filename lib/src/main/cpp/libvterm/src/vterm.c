@@ -89,6 +89,8 @@ void vterm_free(VTerm *vt)
   if(vt->state)
     vterm_state_free(vt->state);
 
+  vterm_profile_free(vt);
+
   vterm_allocator_free(vt, vt->outbuffer);
   vterm_allocator_free(vt, vt->tmpbuffer);
 
@@ -133,6 +135,30 @@ int vterm_get_utf8(const VTerm *vt)
 void vterm_set_utf8(VTerm *vt, int is_utf8)
 {
   vt->mode.utf8 = is_utf8;
+  if(is_utf8)
+    vterm_set_legacy_encoding(vt, VTERM_LEGACY_NONE);
+}
+
+VTermLegacyEncoding vterm_get_legacy_encoding(const VTerm *vt)
+{
+  return vt->legacy_encoding;
+}
+
+void vterm_set_legacy_encoding(VTerm *vt, VTermLegacyEncoding encoding)
+{
+  if(encoding < 0 || encoding >= VTERM_N_LEGACY_ENCODINGS)
+    return;
+
+  vt->legacy_encoding = encoding;
+  if(encoding != VTERM_LEGACY_NONE)
+    vt->mode.utf8 = 0;
+
+  if(vt->state) {
+    VTermEncodingInstance *instance = &vt->state->encoding_legacy;
+    instance->enc = vterm_lookup_legacy_encoding(encoding);
+    if(instance->enc && instance->enc->init)
+      (*instance->enc->init)(instance->enc, instance->data);
+  }
 }
 
 void vterm_output_set_callback(VTerm *vt, VTermOutputCallback *func, void *user)
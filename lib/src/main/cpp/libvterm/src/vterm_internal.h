@@ -87,6 +87,12 @@ struct VTermState
   /* lineinfo will == lineinfos[0] or lineinfos[1], depending on altscreen */
   VTermLineInfo *lineinfo;
 #define ROWWIDTH(state,row) ((state)->lineinfo[(row)].doublewidth ? ((state)->cols / 2) : (state)->cols)
+
+  /* Lineinfo of the rows a full-width scroll is moving off the top, valid
+   * for the first scrolled_rows rows while the scroll callbacks run */
+  VTermLineInfo *scrolled_lineinfo;
+  int scrolled_lineinfo_size;
+  int scrolled_rows;
 #define THISROWWIDTH(state) ROWWIDTH(state, (state)->pos.row)
 
   /* Mouse state */
@@ -122,7 +128,7 @@ struct VTermState
     unsigned int report_focus:1;
   } mode;
 
-  VTermEncodingInstance encoding[4], encoding_utf8;
+  VTermEncodingInstance encoding[4], encoding_utf8, encoding_legacy;
   int gl_set, gr_set, gsingle_set;
 
   struct VTermPen pen;
@@ -186,6 +192,8 @@ struct VTerm
     unsigned int ctrl8bit:1;
   } mode;
 
+  VTermLegacyEncoding legacy_encoding;
+
   struct {
     enum VTermParserState {
       NORMAL,
@@ -246,6 +254,9 @@ struct VTerm
 
   VTermState *state;
   VTermScreen *screen;
+
+  /* NULL unless the command profiler is enabled */
+  struct VTermProfile *profile;
 };
 
 struct VTermEncoding {
@@ -269,6 +280,16 @@ void vterm_push_output_sprintf(VTerm *vt, const char *format, ...);
 void vterm_push_output_sprintf_ctrl(VTerm *vt, unsigned char ctrl, const char *fmt, ...);
 void vterm_push_output_sprintf_str(VTerm *vt, unsigned char ctrl, bool term, const char *fmt, ...);
 
+void vterm_profile_free(VTerm *vt);
+uint64_t vterm_profile_start(VTerm *vt);
+void vterm_profile_end(VTerm *vt, uint64_t start, VTermProfileKind kind, int32_t command, int counts);
+
+/* Time a dispatch when profiling; command is only evaluated if enabled */
+#define PROFILE_START(vt) \
+    ((vt)->profile ? vterm_profile_start(vt) : 0)
+#define PROFILE_END(vt, start, kind, command, counts) \
+    do { if((vt)->profile) vterm_profile_end(vt, start, kind, command, counts); } while(0)
+
 void vterm_state_free(VTermState *state);
 
 void vterm_state_newpen(VTermState *state);
@@ -289,7 +310,30 @@ void vterm_state_push_output_sprintf_CSI(VTermState *vts, const char *format, ..
 
 void vterm_screen_free(VTermScreen *screen);
 
+#ifdef VTERM_FUSED_SCREEN
+/* Fused build: the screen's handlers for the per-glyph state callbacks are
+ * visible to state.c, which calls them directly when they are the installed
+ * callbacks. With LTO they inline into the text path; any other callback set
+ * still goes through its function pointers */
+int vterm_screen_on_putglyph(VTermGlyphInfo *info, VTermPos pos, void *user);
+int vterm_screen_on_repeatglyph(VTermGlyphInfo *info, VTermPos pos, int count, void *user);
+int vterm_screen_on_movecursor(VTermPos pos, VTermPos oldpos, int visible, void *user);
+int vterm_screen_on_scrollrect(VTermRect rect, int downward, int rightward, void *user);
+int vterm_screen_on_erase(VTermRect rect, int selective, void *user);
+
+# define STATE_CALLBACK(state, name, ...) \
+    ((state)->callbacks->name == &vterm_screen_on_##name ? \
+        vterm_screen_on_##name(__VA_ARGS__, (state)->cbdata) : \
+        (*(state)->callbacks->name)(__VA_ARGS__, (state)->cbdata))
+#else
+# define STATE_CALLBACK(state, name, ...) \
+    (*(state)->callbacks->name)(__VA_ARGS__, (state)->cbdata)
+#endif
+
 VTermEncoding *vterm_lookup_encoding(VTermEncodingType type, char designation);
+VTermEncoding *vterm_lookup_legacy_encoding(VTermLegacyEncoding encoding);
+int vterm_legacy_pending(const VTermEncodingInstance *instance);
+int vterm_utf8_pending(const VTermEncodingInstance *instance);
 
 int vterm_unicode_width(uint32_t codepoint);
 int vterm_unicode_is_combining(uint32_t codepoint);
@@ -23,6 +23,45 @@ static size_t inplace_hex2bytes(char *s)
   return outpos - s;
 }
 
+static int profile_entry_cmp(const void *a, const void *b)
+{
+  const VTermProfileEntry *ea = a, *eb = b;
+  if(ea->kind != eb->kind)
+    return ea->kind - eb->kind;
+  return (ea->command > eb->command) - (ea->command < eb->command);
+}
+
+static void print_profile_entry(const VTermProfileEntry *entry)
+{
+  static const char *kinds[] = {
+    "text", "ctrl", "esc", "csi", "osc", "dcs", "apc", "pm", "sos",
+  };
+  printf("%s", kinds[entry->kind]);
+
+  switch(entry->kind) {
+  case VTERM_PROFILE_CONTROL:
+    printf("-%02x", entry->command);
+    break;
+  case VTERM_PROFILE_ESCAPE:
+  case VTERM_PROFILE_CSI:
+  case VTERM_PROFILE_DCS:
+    printf("-");
+    for(int shift = 16; shift >= 0; shift -= 8)
+      if((entry->command >> shift) & 0xff)
+        printf("%c", (entry->command >> shift) & 0xff);
+    break;
+  case VTERM_PROFILE_OSC:
+    printf("-%d", entry->command);
+    break;
+  default:
+    break;
+  }
+
+  printf("=%llu", (unsigned long long)entry->count);
+  if(entry->sampled != entry->count)
+    printf("/%llu", (unsigned long long)entry->sampled);
+}
+
 static VTermModifier strpe_modifiers(char **strp)
 {
   VTermModifier state = 0;
@@ -569,7 +608,7 @@ static int screen_damage(VTermRect rect, void *user)
 }
 
 static int want_screen_scrollback = 0;
-static int screen_sb_pushline(int cols, const VTermScreenCell *cells, void *user)
+static int screen_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user)
 {
   if(!want_screen_scrollback)
     return 1;
@@ -581,6 +620,8 @@ static int screen_sb_pushline(int cols, const VTermScreenCell *cells, void *user
   printf("sb_pushline %d =", cols);
   for(int c = 0; c < eol; c++)
     printf(" %02X", cells[c].chars[0]);
+  if(continuation)
+    printf(" cont");
   printf("\n");
 
   return 1;
@@ -619,9 +660,9 @@ VTermScreenCallbacks screen_cbs = {
   .moverect    = moverect,
   .movecursor  = movecursor,
   .settermprop = settermprop,
-  .sb_pushline = screen_sb_pushline,
   .sb_popline  = screen_sb_popline,
   .sb_clear    = screen_sb_clear,
+  .sb_pushline4 = screen_sb_pushline4,
 };
 
 int main(int argc, char **argv)
@@ -752,6 +793,14 @@ int main(int argc, char **argv)
       vterm_set_utf8(vt, flag);
     }
 
+    else if(sscanf(line, "LEGACY %d", &flag)) {
+      vterm_set_legacy_encoding(vt, flag);
+    }
+
+    else if(sscanf(line, "PROFILE %d", &flag)) {
+      vterm_profile_enable(vt, flag);
+    }
+
     else if(streq(line, "RESET")) {
       if(state) {
         vterm_state_reset(state, 1);
@@ -931,6 +980,11 @@ int main(int argc, char **argv)
       vterm_screen_flush_damage(screen);
     }
 
+    else if(strstartswith(line, "DAMAGEBLINK")) {
+      assert(screen);
+      printf("blinkrows %d\n", vterm_screen_damage_blink(screen));
+    }
+
     else if(strstartswith(line, "SETDEFAULTCOL ")) {
       assert(screen);
       char *linep = line + 14;
@@ -962,6 +1016,19 @@ int main(int argc, char **argv)
         else
           printf("%d,%d\n", state_pos.row, state_pos.col);
       }
+      else if(streq(line, "?profile")) {
+        VTermProfileEntry entries[64];
+        int n = vterm_profile_get(vt, entries, 64);
+        if(n > 64)
+          n = 64;
+        qsort(entries, n, sizeof(entries[0]), profile_entry_cmp);
+        for(int i = 0; i < n; i++) {
+          if(i)
+            printf(" ");
+          print_profile_entry(&entries[i]);
+        }
+        printf("\n");
+      }
       else if(strstartswith(line, "?pen ")) {
         assert(state);
         char *linep = line + 5;
@@ -1208,6 +1275,33 @@ int main(int argc, char **argv)
         }
         printf("%d,%d-%d,%d\n", rect.start_row, rect.start_col, rect.end_row, rect.end_col);
       }
+      else if(strstartswith(line, "?screen_select ")) {
+        assert(screen);
+        char *linep = line + 15;
+        while(linep[0] == ' ')
+          linep++;
+        VTermPos pos;
+        char modename[16];
+        if(sscanf(linep, "%d,%d %15s", &pos.row, &pos.col, modename) < 3) {
+          printf("! screen_select unrecognised input\n");
+          goto abort_line;
+        }
+        static const char *modenames[] = { "word", "token", "path", "url", "style" };
+        VTermSelectMode mode;
+        for(mode = 0; mode < VTERM_N_SELECTS; mode++)
+          if(streq(modename, modenames[mode]))
+            break;
+        if(mode == VTERM_N_SELECTS) {
+          printf("! screen_select unrecognised mode\n");
+          goto abort_line;
+        }
+        VTermPos start, end;
+        if(!vterm_screen_get_select_extent(screen, pos, mode, &start, &end)) {
+          printf("! screen_select failed\n");
+          goto abort_line;
+        }
+        printf("%d,%d-%d,%d\n", start.row, start.col, end.row, end.col);
+      }
       else
         printf("?\n");
 
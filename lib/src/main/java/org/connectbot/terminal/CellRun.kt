@@ -16,13 +16,26 @@
  */
 package org.connectbot.terminal
 
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
 /**
  * A run of consecutive cells with identical formatting attributes.
  * Used to efficiently batch cell data transfer across the JNI boundary.
  *
+ * Native code writes each run into [buffer], which is registered with the
+ * terminal once, so fetching a run passes only primitives. [load] then
+ * unpacks it into the fields below.
+ *
  * This class is reusable - call reset() before each getCellRun() call.
  */
 internal class CellRun {
+    /**
+     * Where native code writes the run: a header of 32-bit words (see the
+     * HEADER_ constants, matching Terminal::CellRunField), then UTF-16 text.
+     */
+    val buffer: ByteBuffer = ByteBuffer.allocateDirect(BUFFER_BYTES).order(ByteOrder.nativeOrder())
+
     // Foreground color (RGB)
     var fgRed: Int = 0
     var fgGreen: Int = 0
@@ -33,6 +46,10 @@ internal class CellRun {
     var bgGreen: Int = 0
     var bgBlue: Int = 0
 
+    // Palette slots for the colors above (see TerminalPalette); DIRECT for RGB colors
+    var fgIndex: Int = TerminalPalette.DIRECT
+    var bgIndex: Int = TerminalPalette.DIRECT
+
     // Text attributes
     var bold: Boolean = false
     var underline: Int = 0  // 0=none, 1=single, 2=double, 3=curly
@@ -46,10 +63,14 @@ internal class CellRun {
     var dwl: Boolean = false  // Double-width line
     var dhl: Int = 0  // Double-height line (0=none, 1=top, 2=bottom)
 
-    // Characters in this run (UTF-16, may include surrogate pairs)
+    // Characters in this run (UTF-16, may include surrogate pairs); shared and
+    // possibly longer than the run, so only the first charCount are valid
     var chars: CharArray = CharArray(256)
 
-    // Number of cells this run covers (not necessarily chars.size due to wide chars)
+    // Number of UTF-16 chars in this run
+    var charCount: Int = 0
+
+    // Number of cells this run covers (not necessarily charCount due to wide chars)
     var runLength: Int = 0
 
     /**
@@ -57,6 +78,9 @@ internal class CellRun {
      */
     fun reset() {
         runLength = 0
+        charCount = 0
+        fgIndex = TerminalPalette.DIRECT
+        bgIndex = TerminalPalette.DIRECT
         bold = false
         underline = 0
         italic = false
@@ -68,10 +92,73 @@ internal class CellRun {
         dhl = 0
     }
 
+    /**
+     * Unpack the run native code last wrote to [buffer].
+     */
+    fun load() {
+        runLength = buffer.getInt(HEADER_LENGTH * 4)
+        charCount = buffer.getInt(HEADER_CHAR_COUNT * 4)
+
+        val fg = buffer.getInt(HEADER_FG_RGB * 4)
+        fgRed = (fg shr 16) and 0xFF
+        fgGreen = (fg shr 8) and 0xFF
+        fgBlue = fg and 0xFF
+        val bg = buffer.getInt(HEADER_BG_RGB * 4)
+        bgRed = (bg shr 16) and 0xFF
+        bgGreen = (bg shr 8) and 0xFF
+        bgBlue = bg and 0xFF
+        fgIndex = buffer.getInt(HEADER_FG_INDEX * 4)
+        bgIndex = buffer.getInt(HEADER_BG_INDEX * 4)
+
+        val flags = buffer.getInt(HEADER_FLAGS * 4)
+        bold = (flags and FLAG_BOLD) != 0
+        italic = (flags and FLAG_ITALIC) != 0
+        blink = (flags and FLAG_BLINK) != 0
+        reverse = (flags and FLAG_REVERSE) != 0
+        strike = (flags and FLAG_STRIKE) != 0
+        dwl = (flags and FLAG_DWL) != 0
+        underline = buffer.getInt(HEADER_UNDERLINE * 4)
+        font = buffer.getInt(HEADER_FONT * 4)
+        dhl = buffer.getInt(HEADER_DHL * 4)
+
+        if (chars.size < charCount) {
+            chars = CharArray((charCount + 63) / 64 * 64)
+        }
+        for (i in 0 until charCount) {
+            chars[i] = buffer.getChar(HEADER_BYTES + i * 2)
+        }
+    }
+
     /**
      * Get the characters as a String.
      */
     fun getCharsAsString(): String {
-        return String(chars, 0, chars.size)
+        return String(chars, 0, charCount)
+    }
+
+    private companion object {
+        // Header words, in the order of Terminal::CellRunField
+        const val HEADER_LENGTH = 0
+        const val HEADER_CHAR_COUNT = 1
+        const val HEADER_FG_RGB = 2
+        const val HEADER_BG_RGB = 3
+        const val HEADER_FG_INDEX = 4
+        const val HEADER_BG_INDEX = 5
+        const val HEADER_FLAGS = 6
+        const val HEADER_UNDERLINE = 7
+        const val HEADER_FONT = 8
+        const val HEADER_DHL = 9
+        const val HEADER_BYTES = 16 * 4
+
+        // Terminal::CellRunFlags
+        const val FLAG_BOLD = 1 shl 0
+        const val FLAG_ITALIC = 1 shl 1
+        const val FLAG_BLINK = 1 shl 2
+        const val FLAG_REVERSE = 1 shl 3
+        const val FLAG_STRIKE = 1 shl 4
+        const val FLAG_DWL = 1 shl 5
+
+        // Longer runs are split by native code
+        const val BUFFER_BYTES = HEADER_BYTES + 4096 * 2
     }
 }
@@ -0,0 +1,49 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+/**
+ * Resources used by one shell command, as delimited by the OSC 133 C
+ * (output starts) and D (command finished) shell integration marks.
+ *
+ * Bytes are counted per [TerminalEmulator.writeInput] call, so output sharing
+ * a write with a mark is charged to the command.
+ *
+ * @param id Sequence number within this terminal session
+ * @param commandLine Command text between the OSC 133 B and C marks, empty if unknown
+ * @param startTimeMillis Wall-clock time the command started
+ * @param durationNanos Time from start to finish, or to now while running
+ * @param parseNanos Time spent processing the command's output
+ * @param bytes Output bytes processed
+ * @param scrolledLines Lines scrolled off the top of the screen
+ * @param damagedCells Total area of the screen damage the command caused
+ * @param exitCode Exit status from the D mark, or -1 if the shell did not report one
+ * @param finished False while the command is still running, or if the next
+ *                 command started without a D mark
+ */
+data class CommandCost(
+    val id: Long,
+    val commandLine: String,
+    val startTimeMillis: Long,
+    val durationNanos: Long,
+    val parseNanos: Long,
+    val bytes: Long,
+    val scrolledLines: Long,
+    val damagedCells: Long,
+    val exitCode: Int,
+    val finished: Boolean
+)
@@ -0,0 +1,201 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+import androidx.compose.ui.graphics.Color
+import java.nio.ByteBuffer
+
+/**
+ * Reader for the render-ready copy of the visible screen that native code
+ * keeps in memory shared with Java (see GridMirror.h).
+ *
+ * The memory is mapped once, and rows are decoded straight from it, so a
+ * frame costs two lock-free native calls to check the seqlock however many
+ * rows it touches. Native code only reports damage once the damaged rows
+ * are in the mirror.
+ *
+ * Not thread-safe; frames are read from one thread.
+ */
+internal class GridMirror(private val terminalNative: TerminalNative) {
+    private var buffer: ByteBuffer? = null
+    private var unavailable = false
+
+    // Header of the frame being read
+    private var rows = 0
+    private var cols = 0
+    private var rowStride = 0
+    private var rowsOffset = 0
+    private var textOffset = 0
+    private var stylesOffset = 0
+    private var styleCount = 0
+
+    // Last style decoded; neighboring cells mostly share one
+    private var styleId = -1
+    private var fgColor = Color.Unspecified
+    private var bgColor = Color.Unspecified
+    private var fgIndex = TerminalPalette.DIRECT
+    private var bgIndex = TerminalPalette.DIRECT
+    private var attrs = 0
+
+    /**
+     * Run [block] against one consistent frame, during which [readCells] may
+     * be called. The block may run more than once if a frame is published
+     * while it reads, so it must be safe to repeat.
+     *
+     * @return false if no consistent frame could be read, in which case the
+     *         caller should fetch the rows through [TerminalNative.getCellRun]
+     */
+    fun read(block: () -> Unit): Boolean {
+        if (unavailable) return false
+
+        repeat(MAX_ATTEMPTS) {
+            val sequence = terminalNative.gridReadBegin()
+            if ((sequence and 1L) != 0L) {
+                Thread.yield()
+                return@repeat
+            }
+
+            var mapped = buffer
+            if (mapped == null || mapped.getInt(HEADER_RETIRED * 4) != 0) {
+                // First use, or the screen outgrew the old mapping
+                mapped = terminalNative.getGridBuffer()
+                if (mapped == null) {
+                    unavailable = true
+                    return false
+                }
+                buffer = mapped
+                return@repeat
+            }
+
+            rows = mapped.getInt(HEADER_ROWS * 4)
+            cols = mapped.getInt(HEADER_COLS * 4)
+            rowStride = mapped.getInt(HEADER_ROW_STRIDE * 4)
+            rowsOffset = mapped.getInt(HEADER_ROWS_OFFSET * 4)
+            textOffset = mapped.getInt(HEADER_TEXT_OFFSET * 4)
+            stylesOffset = mapped.getInt(HEADER_STYLES_OFFSET * 4)
+            styleCount = mapped.getInt(HEADER_STYLE_COUNT * 4)
+            styleId = -1
+
+            try {
+                block()
+            } catch (e: IndexOutOfBoundsException) {
+                // Offsets torn by a concurrent frame; only a bug if the frame held
+                if (terminalNative.gridReadValidate(sequence)) throw e
+                return@repeat
+            }
+
+            if (terminalNative.gridReadValidate(sequence)) {
+                return true
+            }
+        }
+
+        return false
+    }
+
+    /**
+     * Decode the cells of [row] in [fromCol, toCol) into [out], a wide
+     * character counting as one cell of width 2. Only valid inside [read].
+     *
+     * @return false if the frame does not cover those cells, e.g. right
+     *         after a resize, and nothing was added
+     */
+    fun readCells(row: Int, fromCol: Int, toCol: Int, out: MutableList<TerminalLine.Cell>): Boolean {
+        val mapped = buffer ?: return false
+        if (row !in 0..<rows || fromCol < 0 || toCol > cols) return false
+
+        val base = rowsOffset + row * rowStride
+
+        var col = fromCol
+        while (col < toCol) {
+            val cell = base + col * CELL_BYTES
+            loadStyle(mapped, mapped.getShort(cell).toInt() and 0xFFFF)
+            val width = mapped.get(cell + 2).toInt() and 0xFF
+            val length = (mapped.get(cell + 3).toInt() and 0xFF).coerceAtMost(TEXT_UNITS_PER_CELL)
+            val text = base + textOffset + col * TEXT_UNITS_PER_CELL * 2
+
+            // A column covered by a wide character before fromCol has no text
+            val char = if (length > 0) mapped.getChar(text) else ' '
+            val combiningChars = if (length > 1) {
+                List(length - 1) { mapped.getChar(text + (1 + it) * 2) }
+            } else {
+                TerminalLine.EMPTY_COMBINING_CHARS
+            }
+
+            out.add(
+                TerminalLine.Cell(
+                    char = char,
+                    combiningChars = combiningChars,
+                    fgColor = fgColor,
+                    bgColor = bgColor,
+                    fgIndex = fgIndex,
+                    bgIndex = bgIndex,
+                    bold = (attrs and FLAG_BOLD) != 0,
+                    italic = (attrs and FLAG_ITALIC) != 0,
+                    underline = (attrs shr 8) and 0xF,
+                    blink = (attrs and FLAG_BLINK) != 0,
+                    reverse = (attrs and FLAG_REVERSE) != 0,
+                    strike = (attrs and FLAG_STRIKE) != 0,
+                    width = if (width == 2) 2 else 1
+                )
+            )
+            col += if (width == 2) 2 else 1
+        }
+
+        return true
+    }
+
+    private fun loadStyle(mapped: ByteBuffer, id: Int) {
+        if (id == styleId) return
+        if (id >= styleCount) throw IndexOutOfBoundsException("style $id of $styleCount")
+
+        val entry = stylesOffset + id * STYLE_BYTES
+        val fg = mapped.getInt(entry)
+        val bg = mapped.getInt(entry + 4)
+        fgColor = Color((fg shr 16) and 0xFF, (fg shr 8) and 0xFF, fg and 0xFF)
+        bgColor = Color((bg shr 16) and 0xFF, (bg shr 8) and 0xFF, bg and 0xFF)
+        fgIndex = mapped.getShort(entry + 8).toInt()
+        bgIndex = mapped.getShort(entry + 10).toInt()
+        attrs = mapped.getInt(entry + 12)
+        styleId = id
+    }
+
+    private companion object {
+        // Header words, in the order of GridMirror::HeaderField
+        const val HEADER_ROWS = 2
+        const val HEADER_COLS = 3
+        const val HEADER_ROW_STRIDE = 4
+        const val HEADER_ROWS_OFFSET = 5
+        const val HEADER_TEXT_OFFSET = 6
+        const val HEADER_STYLES_OFFSET = 7
+        const val HEADER_STYLE_COUNT = 8
+        const val HEADER_RETIRED = 9
+
+        const val STYLE_BYTES = 16
+        const val CELL_BYTES = 4
+        const val TEXT_UNITS_PER_CELL = 12
+
+        // Terminal::CellRunFlags, in the low bits of a style's attrs
+        const val FLAG_BOLD = 1 shl 0
+        const val FLAG_ITALIC = 1 shl 1
+        const val FLAG_BLINK = 1 shl 2
+        const val FLAG_REVERSE = 1 shl 3
+        const val FLAG_STRIKE = 1 shl 4
+
+        // Frames published faster than this fall back to cell runs
+        const val MAX_ATTEMPTS = 4
+    }
+}
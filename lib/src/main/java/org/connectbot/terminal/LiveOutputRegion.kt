@@ -29,48 +29,53 @@ import kotlinx.coroutines.delay
 /**
  * Invisible live region that announces new terminal output to screen readers.
  *
- * This component monitors the last few lines of terminal output and announces
- * changes using ARIA-style live regions. It includes debouncing to prevent
- * overwhelming the screen reader with rapid updates.
+ * New output is read from the emulator's native output text stream, so each
+ * snapshot only costs the text written since the last one; prompts and typed
+ * input are left out when the shell reports OSC 133 marks. Debouncing batches
+ * rapid updates so the screen reader is not overwhelmed.
  *
- * @param screenState Terminal screen state
+ * @param terminalEmulator Emulator whose output is announced
+ * @param screenState Terminal screen state, whose snapshots signal new output
  * @param enabled Whether live announcements are active (typically only in Input Mode)
  * @param debounceMs Milliseconds to wait before announcing (batches rapid updates)
- * @param linesToMonitor Number of bottom lines to monitor for changes
+ * @param linesToAnnounce Number of trailing lines of the new output to announce
  * @param modifier Modifier for the invisible container
  */
 @Composable
 internal fun LiveOutputRegion(
+    terminalEmulator: TerminalEmulatorImpl,
     screenState: TerminalScreenState,
     enabled: Boolean = true,
     debounceMs: Long = 300L,
-    linesToMonitor: Int = 3,
+    linesToAnnounce: Int = 3,
     modifier: Modifier = Modifier
 ) {
     val snapshot = screenState.snapshot
 
-    // Track the last announced content to detect changes
+    // Stream offset of the next unread output; -1 skips what was written before
+    val cursor = remember(terminalEmulator) { LongArray(1) { -1L } }
+    val pendingText = remember(terminalEmulator) { StringBuilder() }
     var lastAnnouncedText by remember { mutableStateOf("") }
-    var pendingText by remember { mutableStateOf("") }
 
     // Debounced announcement effect
-    LaunchedEffect(snapshot.lines, enabled) {
+    LaunchedEffect(snapshot, enabled) {
         if (!enabled) return@LaunchedEffect
 
-        // Get the last N lines
-        val recentLines = snapshot.lines.takeLast(linesToMonitor)
-        val currentText = recentLines.joinToString("\n") { it.text }
-
-        if (currentText != lastAnnouncedText) {
-            // New content detected - set pending
-            pendingText = currentText
+        pendingText.append(terminalEmulator.readNewOutput(cursor))
+        if (pendingText.length > MAX_PENDING_LENGTH) {
+            pendingText.delete(0, pendingText.length - MAX_PENDING_LENGTH)
+        }
+        if (pendingText.isBlank()) return@LaunchedEffect
 
-            // Wait for debounce period
-            delay(debounceMs)
+        // Wait for debounce period; a newer snapshot restarts the wait
+        delay(debounceMs)
 
-            // Announce the accumulated changes
-            lastAnnouncedText = pendingText
-        }
+        // Announce the tail of the accumulated output
+        lastAnnouncedText = pendingText.lines()
+            .filter { it.isNotBlank() }
+            .takeLast(linesToAnnounce)
+            .joinToString("\n")
+        pendingText.clear()
     }
 
     // Invisible box with live region semantics
@@ -81,3 +86,5 @@ internal fun LiveOutputRegion(
         }
     )
 }
+
+private const val MAX_PENDING_LENGTH = 4096
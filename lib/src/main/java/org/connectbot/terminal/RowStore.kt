@@ -0,0 +1,88 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+/**
+ * Visible screen rows with structurally shared snapshots.
+ *
+ * Rows are kept in fixed-size chunks behind a small chunk table. [snapshot]
+ * hands out the current table as an immutable list, and a later [set] copies
+ * only the chunk it touches (and the table, once) instead of the whole
+ * screen. Unchanged rows and chunks are shared between consecutive
+ * snapshots, so a frame allocates in proportion to the rows that changed.
+ */
+internal class RowStore(lines: List<TerminalLine>) {
+    val size = lines.size
+
+    private var chunks: Array<Array<TerminalLine>> =
+        Array((size + CHUNK_SIZE - 1) shr CHUNK_SHIFT) { chunk ->
+            val start = chunk shl CHUNK_SHIFT
+            Array(minOf(CHUNK_SIZE, size - start)) { lines[start + it] }
+        }
+
+    // Whether the table and each chunk may be written in place, i.e. no
+    // snapshot has been handed out since they were last copied
+    private var tableOwned = true
+    private val chunkOwned = BooleanArray(chunks.size) { true }
+
+    operator fun get(row: Int): TerminalLine =
+        chunks[row shr CHUNK_SHIFT][row and CHUNK_MASK]
+
+    operator fun set(row: Int, line: TerminalLine) {
+        if (row !in 0..<size) {
+            throw IndexOutOfBoundsException("row $row, size $size")
+        }
+
+        val chunk = row shr CHUNK_SHIFT
+        if (!tableOwned) {
+            chunks = chunks.copyOf()
+            tableOwned = true
+        }
+        if (!chunkOwned[chunk]) {
+            chunks[chunk] = chunks[chunk].copyOf()
+            chunkOwned[chunk] = true
+        }
+        chunks[chunk][row and CHUNK_MASK] = line
+    }
+
+    /**
+     * The rows as they are now. Later writes do not show through.
+     */
+    fun snapshot(): List<TerminalLine> {
+        tableOwned = false
+        chunkOwned.fill(false)
+        return Snapshot(chunks, size)
+    }
+
+    private class Snapshot(
+        private val chunks: Array<Array<TerminalLine>>,
+        override val size: Int
+    ) : AbstractList<TerminalLine>(), RandomAccess {
+        override fun get(index: Int): TerminalLine {
+            if (index !in 0..<size) {
+                throw IndexOutOfBoundsException("index $index, size $size")
+            }
+            return chunks[index shr CHUNK_SHIFT][index and CHUNK_MASK]
+        }
+    }
+
+    companion object {
+        private const val CHUNK_SHIFT = 4
+        private const val CHUNK_SIZE = 1 shl CHUNK_SHIFT
+        private const val CHUNK_MASK = CHUNK_SIZE - 1
+    }
+}
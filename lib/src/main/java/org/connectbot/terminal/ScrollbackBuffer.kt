@@ -0,0 +1,313 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+import androidx.compose.ui.graphics.Color
+
+/**
+ * Scrollback history kept as logical lines.
+ *
+ * Rows the terminal wrapped are joined back together as they are pushed, and
+ * only split into rows again for the width they are viewed at. A width change
+ * does not touch the stored lines: each line is rewrapped the first time it
+ * is counted or shown at the new width, and the result is kept on the line,
+ * so snapshots taken at the same width share it.
+ *
+ * Lines are stored in blocks of [BLOCK_SIZE], each with its row count at the
+ * width it was last counted at. Pushes and evictions keep those counts up to
+ * date, so a snapshot only recounts the blocks that changed, or all of them
+ * once after a width change.
+ *
+ * Not thread safe; callers hold their own lock. Snapshots are immutable.
+ */
+internal class ScrollbackBuffer(private val maxLines: Int) {
+    private val blocks = ArrayDeque<Block>()
+    private var lineCount = 0
+
+    /**
+     * Add a row that scrolled off the top of the screen.
+     *
+     * @param cells Cells of the row, as wide as the screen was
+     * @param continuation Whether the row was wrapped onto from the previous row
+     * @param defaultBg Background of blank cells that may be dropped from the end of a line
+     */
+    fun push(cells: List<TerminalLine.Cell>, continuation: Boolean, defaultBg: Color) {
+        var blankTail = 0
+        while (blankTail < cells.size && isBlank(cells[cells.size - 1 - blankTail], defaultBg)) {
+            blankTail++
+        }
+
+        val tail = blocks.lastOrNull()
+        if (continuation && tail != null && tail.end > tail.start) {
+            val last = tail.lines[tail.end - 1]!!
+            if (last.cellCount + cells.size <= MAX_LINE_CELLS) {
+                val line = last.append(cells, blankTail)
+                tail.lines[tail.end - 1] = line
+                tail.remove(last)
+                tail.add(line)
+                return
+            }
+        }
+
+        val block = if (tail == null || tail.end == BLOCK_SIZE) Block().also { blocks.addLast(it) } else tail
+        val line = LogicalLine.of(cells, blankTail)
+        block.lines[block.end++] = line
+        block.add(line)
+        lineCount++
+
+        if (lineCount > maxLines) {
+            val head = blocks.first()
+            // The slot is left as is; snapshots may still be reading it
+            head.remove(head.lines[head.start++]!!)
+            if (head.start == head.end) {
+                blocks.removeFirst()
+            }
+            lineCount--
+        }
+    }
+
+    fun clear() {
+        blocks.clear()
+        lineCount = 0
+    }
+
+    /**
+     * The history as rows of at most [cols] columns, oldest first.
+     */
+    fun snapshot(cols: Int): List<TerminalLine> {
+        val width = cols.coerceAtLeast(1)
+        val count = blocks.size
+        // Only the tail block's last slot is ever replaced, so it is copied
+        val lines = Array(count) { i -> if (i == count - 1) blocks[i].lines.copyOf() else blocks[i].lines }
+        val starts = IntArray(count)
+        val ends = IntArray(count)
+        val rowStarts = IntArray(count + 1)
+
+        var total = 0
+        for (i in 0 until count) {
+            val block = blocks[i]
+            starts[i] = block.start
+            ends[i] = block.end
+            rowStarts[i] = total
+            total += block.rowCount(width)
+        }
+        rowStarts[count] = total
+
+        return WrappedRows(lines, starts, ends, rowStarts, width)
+    }
+
+    private fun isBlank(cell: TerminalLine.Cell, defaultBg: Color): Boolean =
+        (cell.char == ' ' || cell.char == '\u0000') && cell.combiningChars.isEmpty() &&
+            cell.bgColor == defaultBg && !cell.reverse && cell.underline == 0 && !cell.strike
+
+    /**
+     * Up to [BLOCK_SIZE] consecutive lines. Slots before [start] were evicted
+     * and slots are only filled at [end], so a snapshot can share the array.
+     */
+    private class Block {
+        val lines = arrayOfNulls<LogicalLine>(BLOCK_SIZE)
+        var start = 0
+        var end = 0
+
+        // Rows of the kept lines at countedCols, or 0 if they need counting
+        private var countedCols = 0
+        private var rows = 0
+
+        fun rowCount(cols: Int): Int {
+            if (countedCols != cols) {
+                var count = 0
+                for (i in start until end) {
+                    count += lines[i]!!.rowCount(cols)
+                }
+                rows = count
+                countedCols = cols
+            }
+            return rows
+        }
+
+        fun add(line: LogicalLine) = adjust(line, 1)
+
+        fun remove(line: LogicalLine) = adjust(line, -1)
+
+        // Keep the count if the line's rows are known without a cell walk
+        private fun adjust(line: LogicalLine, sign: Int) {
+            if (countedCols == 0) {
+                return
+            }
+            val count = line.knownRowCount(countedCols)
+            if (count < 0) {
+                countedCols = 0
+            } else {
+                rows += sign * count
+            }
+        }
+    }
+
+    /**
+     * One unwrapped line: the rows it was pushed as, with the trailing blanks
+     * of the last row left out of its content.
+     *
+     * A wrapped row is added with [append], which stores it in the line's
+     * segment array in place and returns a view one segment longer. Views
+     * handed out earlier, e.g. in snapshots, never look past their own
+     * [segmentCount], so they are unaffected.
+     */
+    private class LogicalLine private constructor(
+        private val segments: Array<List<TerminalLine.Cell>?>,
+        private val segmentCount: Int,
+        val cellCount: Int,
+        private val blankTail: Int,
+        // Whether every cell is one column wide
+        private val narrow: Boolean
+    ) {
+        fun append(cells: List<TerminalLine.Cell>, blankTail: Int): LogicalLine {
+            val storage = if (segmentCount < segments.size) segments else segments.copyOf(segmentCount * 2)
+            storage[segmentCount] = cells
+            return LogicalLine(
+                storage, segmentCount + 1, cellCount + cells.size, blankTail,
+                narrow && isNarrow(cells)
+            )
+        }
+
+        // Row count and rows at the width they were last computed for
+        @Volatile private var counted = 0L  // cols shl 32 or count
+        @Volatile private var wrapped: Wrapped? = null
+
+        private class Wrapped(val cols: Int, val rows: List<TerminalLine>)
+
+        /** Rows at [cols] if they can be had without walking the cells, else -1. */
+        fun knownRowCount(cols: Int): Int {
+            if (narrow) {
+                return narrowRowCount(cols)
+            }
+            val memo = counted
+            return if ((memo ushr 32).toInt() == cols) memo.toInt() else -1
+        }
+
+        fun rowCount(cols: Int): Int {
+            if (narrow) {
+                return narrowRowCount(cols)
+            }
+            val memo = counted
+            if ((memo ushr 32).toInt() == cols) {
+                return memo.toInt()
+            }
+
+            var count = 1
+            var col = 0
+            forEachCell { cell ->
+                if (col + cell.width > cols && col > 0) {
+                    count++
+                    col = 0
+                }
+                col += cell.width
+            }
+            counted = (cols.toLong() shl 32) or count.toLong()
+            return count
+        }
+
+        private fun narrowRowCount(cols: Int): Int =
+            ((cellCount - blankTail + cols - 1) / cols).coerceAtLeast(1)
+
+        fun rows(cols: Int): List<TerminalLine> {
+            wrapped?.let { if (it.cols == cols) return it.rows }
+
+            val rows = ArrayList<TerminalLine>(rowCount(cols))
+            var row = ArrayList<TerminalLine.Cell>(cols)
+            var col = 0
+            forEachCell { cell ->
+                if (col + cell.width > cols && col > 0) {
+                    rows.add(TerminalLine(row = -1, cells = row))
+                    row = ArrayList(cols)
+                    col = 0
+                }
+                row.add(cell)
+                col += cell.width
+            }
+            rows.add(TerminalLine(row = -1, cells = row))
+
+            wrapped = Wrapped(cols, rows)
+            return rows
+        }
+
+        private inline fun forEachCell(action: (TerminalLine.Cell) -> Unit) {
+            val lastSegment = segmentCount - 1
+            for (index in 0 until segmentCount) {
+                val cells = segments[index]!!
+                val end = if (index == lastSegment) cells.size - blankTail else cells.size
+                for (i in 0 until end) {
+                    action(cells[i])
+                }
+            }
+        }
+
+        companion object {
+            fun of(cells: List<TerminalLine.Cell>, blankTail: Int) =
+                LogicalLine(arrayOf<List<TerminalLine.Cell>?>(cells), 1, cells.size, blankTail, isNarrow(cells))
+
+            private fun isNarrow(cells: List<TerminalLine.Cell>): Boolean = cells.all { it.width == 1 }
+        }
+    }
+
+    /**
+     * Rows of the blocks of lines a snapshot was taken of, at one width. Row
+     * counts per block come from the buffer; the rows themselves are only
+     * built on access.
+     */
+    private class WrappedRows(
+        private val blocks: Array<Array<LogicalLine?>>,
+        private val starts: IntArray,
+        private val ends: IntArray,
+        // First row of each block, plus the total at the end
+        private val rowStarts: IntArray,
+        private val cols: Int
+    ) : AbstractList<TerminalLine>(), RandomAccess {
+        override val size: Int = rowStarts[rowStarts.size - 1]
+
+        override fun get(index: Int): TerminalLine {
+            if (index !in 0..<size) {
+                throw IndexOutOfBoundsException("index $index, size $size")
+            }
+
+            // Last block starting at or before index
+            var low = 0
+            var high = blocks.size - 1
+            while (low < high) {
+                val mid = (low + high + 1) ushr 1
+                if (rowStarts[mid] <= index) low = mid else high = mid - 1
+            }
+
+            val lines = blocks[low]
+            var row = rowStarts[low]
+            for (i in starts[low] until ends[low]) {
+                val line = lines[i]!!
+                val count = line.rowCount(cols)
+                if (index < row + count) {
+                    return line.rows(cols)[index - row]
+                }
+                row += count
+            }
+            throw IllegalStateException("row $index not in block $low")
+        }
+    }
+
+    companion object {
+        // Longer runs of wrapped rows are split into several lines
+        private const val MAX_LINE_CELLS = 64 * 1024
+        private const val BLOCK_SIZE = 64
+    }
+}
@@ -89,6 +89,26 @@ enum class SelectionMode {
     LINE
 }
 
+/**
+ * Unit of text picked by a double tap. The order matches libvterm's VTermSelectMode.
+ */
+enum class SelectionUnit {
+    /** Letters, digits and underscores */
+    WORD,
+
+    /** Everything up to whitespace */
+    TOKEN,
+
+    /** File names and paths */
+    PATH,
+
+    /** URLs, without surrounding brackets or trailing punctuation */
+    URL,
+
+    /** Cells sharing the same attributes and colors */
+    STYLE
+}
+
 internal data class SelectionRange(
     val startRow: Int,
     val startCol: Int,
@@ -137,12 +157,31 @@ internal class SelectionManager {
     var isSelecting by mutableStateOf(false)
         private set
 
+    // The range came from selectRange() and only spans rows joined by soft
+    // wraps, so it is copied as one run of text. Any other change to the
+    // range ends this.
+    private var wrappedRun = false
+
     fun startSelection(row: Int, col: Int, mode: SelectionMode = SelectionMode.BLOCK) {
         this.mode = mode
         isSelecting = true
+        wrappedRun = false
         selectionRange = SelectionRange(row, col, row, col)
     }
 
+    /**
+     * Select a finished range in one step, as a double tap does. Rows of the
+     * range must be joined by soft wraps, as they are in the extents from
+     * [TerminalEmulator.selectionExtent]: the text runs from the start to the
+     * end position without a line break.
+     */
+    fun selectRange(startRow: Int, startCol: Int, endRow: Int, endCol: Int) {
+        mode = SelectionMode.BLOCK
+        isSelecting = false
+        wrappedRun = true
+        selectionRange = SelectionRange(startRow, startCol, endRow, endCol)
+    }
+
     fun updateSelection(row: Int, col: Int) {
         if (!isSelecting) return
 
@@ -152,16 +191,19 @@ internal class SelectionManager {
 
     fun updateSelectionStart(row: Int, col: Int) {
         val range = selectionRange ?: return
+        wrappedRun = false
         selectionRange = range.copy(startRow = row, startCol = col)
     }
 
     fun updateSelectionEnd(row: Int, col: Int) {
         val range = selectionRange ?: return
+        wrappedRun = false
         selectionRange = range.copy(endRow = row, endCol = col)
     }
 
     fun moveSelectionUp(maxRow: Int) {
         val range = selectionRange ?: return
+        wrappedRun = false
         if (isSelecting) {
             // During selection, move the end point up
             val newRow = (range.endRow - 1).coerceAtLeast(0)
@@ -176,6 +218,7 @@ internal class SelectionManager {
 
     fun moveSelectionDown(maxRow: Int) {
         val range = selectionRange ?: return
+        wrappedRun = false
         if (isSelecting) {
             // During selection, move the end point down
             val newRow = (range.endRow + 1).coerceAtMost(maxRow - 1)
@@ -190,6 +233,7 @@ internal class SelectionManager {
 
     fun moveSelectionLeft(maxCol: Int) {
         val range = selectionRange ?: return
+        wrappedRun = false
         if (isSelecting) {
             // During selection, move the end point left
             val newCol = (range.endCol - 1).coerceAtLeast(0)
@@ -204,6 +248,7 @@ internal class SelectionManager {
 
     fun moveSelectionRight(maxCol: Int) {
         val range = selectionRange ?: return
+        wrappedRun = false
         if (isSelecting) {
             // During selection, move the end point right
             val newCol = (range.endCol + 1).coerceAtMost(maxCol - 1)
@@ -224,9 +269,11 @@ internal class SelectionManager {
         mode = SelectionMode.NONE
         selectionRange = null
         isSelecting = false
+        wrappedRun = false
     }
 
     fun toggleMode(cols: Int) {
+        wrappedRun = false
         mode = when (mode) {
             SelectionMode.BLOCK -> SelectionMode.LINE
             SelectionMode.LINE -> SelectionMode.BLOCK
@@ -272,13 +319,17 @@ internal class SelectionManager {
                         if (row < maxRow) append('\n')
                     }
                     SelectionMode.BLOCK -> {
-                        val startCol = when (row) {
-                            minRow -> minOf(range.startCol, range.endCol)
-                            else -> 0
+                        // A wrapped run starts at its start position, not
+                        // its leftmost column
+                        val startCol = when {
+                            row != minRow -> 0
+                            wrappedRun -> range.getStartPosition().second
+                            else -> minOf(range.startCol, range.endCol)
                         }
-                        val endCol = when (row) {
-                            maxRow -> maxOf(range.startCol, range.endCol)
-                            else -> line.cells.size - 1
+                        val endCol = when {
+                            row != maxRow -> line.cells.size - 1
+                            wrappedRun -> range.getEndPosition().second
+                            else -> maxOf(range.startCol, range.endCol)
                         }
 
                         for (col in startCol..minOf(endCol, line.cells.lastIndex)) {
@@ -286,7 +337,7 @@ internal class SelectionManager {
                             append(cell.char)
                             cell.combiningChars.forEach { append(it) }
                         }
-                        if (row < maxRow) append('\n')
+                        if (row < maxRow && !wrappedRun) append('\n')
                     }
                     SelectionMode.NONE -> {}
                 }
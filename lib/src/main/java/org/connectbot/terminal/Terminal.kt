@@ -49,6 +49,7 @@ import androidx.compose.runtime.mutableStateOf
 import androidx.compose.runtime.remember
 import androidx.compose.runtime.rememberCoroutineScope
 import androidx.compose.runtime.setValue
+import androidx.compose.runtime.snapshotFlow
 import androidx.compose.ui.Modifier
 import androidx.compose.ui.draw.clip
 import androidx.compose.ui.focus.FocusRequester
@@ -86,6 +87,7 @@ import androidx.compose.ui.unit.sp
 import androidx.compose.ui.viewinterop.AndroidView
 import kotlinx.coroutines.coroutineScope
 import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.first
 import kotlinx.coroutines.launch
 
 /**
@@ -104,6 +106,11 @@ private enum class GestureType {
  */
 private const val CURSOR_BLINK_RATE_MS = 500L
 
+/**
+ * The rate at which text with the blink attribute blinks in milliseconds.
+ */
+private const val TEXT_BLINK_RATE_MS = 500L
+
 /**
  * Amount of time to wait for second touch to detect multitouch gesture in milliseconds.
  */
@@ -369,6 +376,10 @@ fun TerminalWithAccessibility(
     var showMagnifier by remember(terminalEmulator) { mutableStateOf(false) }
     var magnifierPosition by remember(terminalEmulator) { mutableStateOf(Offset.Zero) }
 
+    // Double tap state - time and cell of the previous tap
+    var lastTapTime by remember(terminalEmulator) { mutableStateOf(0L) }
+    var lastTapCell by remember(terminalEmulator) { mutableStateOf(Pair(-1, -1)) }
+
     // Cursor blink state
     var cursorBlinkVisible by remember(terminalEmulator) { mutableStateOf(true) }
 
@@ -459,6 +470,18 @@ fun TerminalWithAccessibility(
         }
     }
 
+    // Text blink timer - runs while the screen has blinking text, and after a
+    // tick finds none waits for the next snapshot before ticking again
+    LaunchedEffect(terminalEmulator) {
+        while (true) {
+            delay(TEXT_BLINK_RATE_MS)
+            if (terminalEmulator.blinkTick() == 0) {
+                val idle = screenState.snapshot.sequenceNumber
+                snapshotFlow { screenState.snapshot.sequenceNumber }.first { it != idle }
+            }
+        }
+    }
+
     // Create TextPaint for measuring and drawing (base size)
     val textPaint = remember(typeface, calculatedFontSize) {
         TextPaint().apply {
@@ -692,7 +715,7 @@ fun TerminalWithAccessibility(
                     )
             } else {
                 Modifier.fillMaxSize()
-            }).pointerInput(terminalEmulator, baseCharHeight) {
+            }).pointerInput(terminalEmulator, baseCharHeight, forcedSize) {
                 val touchSlopSquared =
                     viewConfiguration.touchSlop * viewConfiguration.touchSlop
                 coroutineScope {
@@ -784,8 +807,11 @@ fun TerminalWithAccessibility(
                             longPressJob.cancel()
                             gestureType = GestureType.Zoom
 
-                            // Handle zoom using Compose's built-in gesture calculations
+                            // Handle zoom using Compose's built-in gesture calculations.
+                            // The zoom is only a layer scale until the gesture ends, and
+                            // the size stays locked so nothing reflows mid-pinch.
                             isZooming = true
+                            terminalEmulator.setSizeLocked(true)
 
                             val centerX = (down.position.x + secondPointer.position.x) / 2f
                             val centerY = (down.position.y + secondPointer.position.y) / 2f
@@ -794,33 +820,43 @@ fun TerminalWithAccessibility(
                                 pivotFractionY = centerY / size.height
                             )
 
-                            while (true) {
-                                val event = awaitPointerEvent()
-                                if (event.changes.all { !it.pressed }) break
+                            try {
+                                while (true) {
+                                    val event = awaitPointerEvent()
+                                    if (event.changes.all { !it.pressed }) break
 
-                                if (event.changes.size > 1) {
-                                    val gestureZoom = event.calculateZoom()
-                                    val gesturePan = event.calculatePan()
+                                    if (event.changes.size > 1) {
+                                        val gestureZoom = event.calculateZoom()
+                                        val gesturePan = event.calculatePan()
 
-                                    val oldScale = zoomScale
-                                    val newScale =
-                                        (oldScale * gestureZoom).coerceIn(
-                                            MIN_ZOOM_SCALE,
-                                            MAX_ZOOM_SCALE
-                                        )
+                                        val oldScale = zoomScale
+                                        val newScale =
+                                            (oldScale * gestureZoom).coerceIn(
+                                                MIN_ZOOM_SCALE,
+                                                MAX_ZOOM_SCALE
+                                            )
+
+                                        zoomOffset += gesturePan
+                                        zoomScale = newScale
 
-                                    zoomOffset += gesturePan
-                                    zoomScale = newScale
+                                        event.changes.forEach { it.consume() }
+                                    }
+                                }
 
-                                    event.changes.forEach { it.consume() }
+                                // Keep the zoom as a font size; this costs one resize.
+                                // A forced size picks its own font, so it snaps back.
+                                if (forcedSize == null && zoomScale != 1f) {
+                                    calculatedFontSize = (calculatedFontSize.value * zoomScale)
+                                        .coerceIn(minFontSize.value, maxFontSize.value).sp
                                 }
+                            } finally {
+                                // Gesture ended - reset
+                                isZooming = false
+                                zoomScale = 1f
+                                zoomOffset = Offset.Zero
+                                terminalEmulator.setSizeLocked(false)
                             }
 
-                            // Gesture ended - reset
-                            isZooming = false
-                            zoomScale = 1f
-                            zoomOffset = Offset.Zero
-
                             return@awaitEachGesture
                         }
 
@@ -932,9 +968,31 @@ fun TerminalWithAccessibility(
                             }
 
                             GestureType.Undetermined -> {
-                                // This is a tap. If a selection is active, clear it.
-                                // Otherwise, forward the tap.
-                                if (selectionManager.mode != SelectionMode.NONE) {
+                                // This is a tap. A second tap on the same cell selects the
+                                // word under it; the native screen only covers the live
+                                // screen, so not while scrolled back.
+                                val col = (down.position.x / baseCharWidth).toInt()
+                                    .coerceIn(0, screenState.snapshot.cols - 1)
+                                val row = (down.position.y / baseCharHeight).toInt()
+                                    .coerceIn(0, screenState.snapshot.rows - 1)
+                                val isDoubleTap = lastTapCell == Pair(row, col) &&
+                                    down.uptimeMillis - lastTapTime <= viewConfiguration.doubleTapTimeoutMillis
+                                lastTapTime = down.uptimeMillis
+                                lastTapCell = Pair(row, col)
+
+                                val extent = if (isDoubleTap && screenState.scrollbackPosition == 0) {
+                                    terminalEmulator.selectionExtent(row, col)
+                                } else {
+                                    null
+                                }
+
+                                // Otherwise, if a selection is active, clear it; else forward the tap.
+                                if (extent != null) {
+                                    // SelectionRange ends are inclusive
+                                    val (startRow, startCol, endRow, endCol) = extent
+                                    selectionManager.selectRange(startRow, startCol, endRow, endCol - 1)
+                                    lastTapTime = 0L
+                                } else if (selectionManager.mode != SelectionMode.NONE) {
                                     selectionManager.clearSelection()
                                 } else {
                                     // Request focus when terminal is tapped to show keyboard
@@ -983,6 +1041,8 @@ fun TerminalWithAccessibility(
                         textPaint = textPaint,
                         defaultFg = foregroundColor,
                         defaultBg = backgroundColor,
+                        palette = screenState.snapshot.palette,
+                        blinkVisible = screenState.snapshot.textBlinkVisible,
                         selectionManager = selectionManager
                     )
                 }
@@ -1040,6 +1100,7 @@ fun TerminalWithAccessibility(
 
                 if (!isReviewMode && keyboardEnabled) {
                     LiveOutputRegion(
+                        terminalEmulator = terminalEmulator,
                         screenState = screenState,
                         enabled = true,
                         modifier = Modifier.fillMaxSize()
@@ -1135,6 +1196,8 @@ private fun DrawScope.drawLine(
     textPaint: TextPaint,
     defaultFg: Color,
     defaultBg: Color,
+    palette: TerminalPalette,
+    blinkVisible: Boolean,
     selectionManager: SelectionManager
 ) {
     val y = row * charHeight
@@ -1146,9 +1209,11 @@ private fun DrawScope.drawLine(
         // Check if this cell is selected
         val isSelected = selectionManager.isCellSelected(row, col)
 
-        // Determine colors (handle reverse video and selection)
-        val fgColor = if (cell.reverse) cell.bgColor else cell.fgColor
-        val bgColor = if (cell.reverse) cell.fgColor else cell.bgColor
+        // Determine colors (resolve palette slots, handle reverse video and selection)
+        val cellFg = palette.resolve(cell.fgIndex, cell.fgColor)
+        val cellBg = palette.resolve(cell.bgIndex, cell.bgColor)
+        val fgColor = if (cell.reverse) cellBg else cellFg
+        val bgColor = if (cell.reverse) cellFg else cellBg
 
         // Draw background (with selection highlight)
         val finalBgColor = if (isSelected) SELECTION_HIGHLIGHT_COLOR else bgColor
@@ -1160,8 +1225,8 @@ private fun DrawScope.drawLine(
             )
         }
 
-        // Draw character
-        if (cell.char != ' ' || cell.combiningChars.isNotEmpty()) {
+        // Draw character, unless it blinks and is in the hidden phase
+        if ((cell.char != ' ' || cell.combiningChars.isNotEmpty()) && (blinkVisible || !cell.blink)) {
             val text = buildString {
                 append(cell.char)
                 cell.combiningChars.forEach { append(it) }
@@ -1401,6 +1466,8 @@ private fun MagnifyingGlass(
                             textPaint = textPaint,
                             defaultFg = foregroundColor,
                             defaultBg = backgroundColor,
+                            palette = screenState.snapshot.palette,
+                            blinkVisible = screenState.snapshot.textBlinkVisible,
                             selectionManager = selectionManager
                         )
                     }
@@ -57,6 +57,8 @@ internal interface TerminalCallbacks {
 
     /**
      * Called when a terminal property changes (title, cursor shape, etc.).
+     * Changes are coalesced per write: only the final value of each changed
+     * property is reported.
      *
      * @param prop Property identifier
      * @param value Property value
@@ -65,20 +67,22 @@ internal interface TerminalCallbacks {
     fun setTermProp(prop: Int, value: TerminalProperty): Int
 
     /**
-     * Called when the terminal bell should be triggered.
+     * Called when the terminal bell should be triggered, at most once per write.
      *
+     * @param count Number of bells rung during the write
      * @return 0 on success
      */
-    fun bell(): Int
+    fun bell(count: Int): Int
 
     /**
      * Called when a line is pushed to scrollback buffer.
      *
      * @param cols Number of columns in the line
      * @param cells Array of screen cells
+     * @param continuation Whether the line was wrapped onto from the line pushed before it
      * @return 0 on success
      */
-    fun pushScrollbackLine(cols: Int, cells: Array<ScreenCell>): Int
+    fun pushScrollbackLine(cols: Int, cells: Array<ScreenCell>, continuation: Boolean): Int
 
     /**
      * Called when a line should be popped from scrollback buffer.
@@ -89,6 +93,14 @@ internal interface TerminalCallbacks {
      */
     fun popScrollbackLine(cols: Int, cells: Array<ScreenCell>): Int
 
+    /**
+     * Called when the scrollback buffer should be discarded (CSI 3 J, as
+     * sent by `clear`). Lines pushed afterwards belong to the new scrollback.
+     *
+     * @return 0 on success
+     */
+    fun clearScrollback(): Int
+
     /**
      * Called when keyboard input is generated (user types, terminal generates escape sequences).
      * The caller should write this data to the PTY/transport.
@@ -107,6 +119,17 @@ internal interface TerminalCallbacks {
      * @return 1 if handled, 0 otherwise
      */
     fun onOscSequence(command: Int, payload: String): Int
+
+    /**
+     * Called on the native transport thread when the bound transport reaches
+     * the end of its stream, e.g. when a process started with
+     * [TerminalNative.startProcess] exits.
+     *
+     * @param exitCode Process exit status (128 + signal if it was killed, -1 if
+     *                 unknown), or 0 for transports without one
+     * @return 0 on success
+     */
+    fun onTransportClosed(exitCode: Int): Int
 }
 
 /**
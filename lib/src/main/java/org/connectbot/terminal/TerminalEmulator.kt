@@ -20,11 +20,13 @@ import android.icu.lang.UCharacter
 import android.icu.lang.UProperty
 import android.os.Handler
 import android.os.Looper
+import android.os.ParcelFileDescriptor
 import androidx.annotation.VisibleForTesting
 import androidx.compose.ui.graphics.Color
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.asStateFlow
+import java.io.IOException
 import java.nio.ByteBuffer
 
 /**
@@ -48,6 +50,47 @@ sealed interface TerminalEmulator {
      */
     fun resize(newRows: Int, newCols: Int)
 
+    /**
+     * Run a local process on a native PTY attached to this terminal.
+     *
+     * The process output is parsed natively without passing through [writeInput],
+     * and keyboard input goes straight to the PTY instead of onKeyboardInput.
+     * The PTY follows [resize]. Only one process can run at a time.
+     *
+     * @param command Program (searched on PATH) and its arguments
+     * @param environment Environment as NAME=value strings, or null to inherit
+     * @param workingDirectory Working directory, or null to inherit
+     * @param onExit Called on the Looper thread with the exit status
+     * @return Process ID
+     * @throws IOException if the process could not be started
+     */
+    fun startProcess(
+        command: List<String>,
+        environment: List<String>? = null,
+        workingDirectory: String? = null,
+        onExit: ((Int) -> Unit)? = null
+    ): Int
+
+    /**
+     * Send keyboard output and terminal replies straight to a descriptor,
+     * such as the transport's socket, instead of onKeyboardInput.
+     *
+     * This skips a byte array allocation and a Looper hop per key. The
+     * descriptor stays owned by the caller, who must keep it open while it
+     * is set; its blocking mode is not changed.
+     *
+     * @param descriptor Descriptor to write to, or null to use onKeyboardInput again
+     * @throws IOException if the descriptor cannot be used
+     */
+    fun setOutputDescriptor(descriptor: ParcelFileDescriptor?)
+
+    /**
+     * Select how output passed to writeInput is decoded. UTF-8 by default.
+     *
+     * A character split across writeInput calls is still decoded whole.
+     */
+    fun setEncoding(encoding: TerminalEncoding)
+
     /**
      * Dispatch a key event to the terminal.
      */
@@ -63,6 +106,47 @@ sealed interface TerminalEmulator {
      */
     fun clearScreen()
 
+    /**
+     * Find the word, path or URL around a cell of the visible screen.
+     *
+     * @param row Row index (0-based)
+     * @param col Column index (0-based)
+     * @param unit What counts as one unit of text
+     * @return startRow, startCol, endRow, endCol with the end exclusive, or null
+     *         if the position is off the screen
+     */
+    fun selectionExtent(row: Int, col: Int, unit: SelectionUnit = SelectionUnit.WORD): IntArray?
+
+    /**
+     * Enable per-command profiling of the escape sequences this terminal processes.
+     *
+     * @param sampleEvery Time one in every N commands; 0 disables profiling
+     */
+    fun setCommandProfiling(sampleEvery: Int)
+
+    /**
+     * Per-command counts and sampled timings, most expensive first.
+     *
+     * @return One line per command, or an empty string when profiling is disabled
+     */
+    fun commandProfile(): String
+
+    /**
+     * Lay out long runs of plain text within a single write on worker
+     * threads, e.g. a large paste echoed back or a file dumped over a fast
+     * link. The screen and scrollback end up the same as without it.
+     *
+     * @param threads Worker threads, e.g. the number of cores; 0 disables it
+     */
+    fun setParallelParsing(threads: Int)
+
+    /**
+     * Costs of recent shell commands, delimited by OSC 133 shell integration marks.
+     *
+     * @return Oldest first, with the running command (if any) last
+     */
+    fun recentCommandCosts(): List<CommandCost>
+
     /**
      * Set ANSI palette colors (indices 0-15).
      *
@@ -145,6 +229,21 @@ class TerminalEmulatorFactory {
                 onClipboardCopy = onClipboardCopy
             )
         }
+
+        /**
+         * Prepare native terminals ahead of time, so that [create] with the
+         * same size skips the native allocation and setup.
+         *
+         * Call this off the main thread, e.g. at startup or after a session
+         * opens, to keep the next one ready. At most 8 are kept.
+         *
+         * @param rows Rows of the terminals to prepare
+         * @param cols Columns of the terminals to prepare
+         * @param count How many to prepare
+         * @return Number of terminals actually added
+         */
+        fun prewarm(rows: Int = 24, cols: Int = 80, count: Int = 1): Int =
+            TerminalNative.prewarm(rows, cols, count)
     }
 }
 
@@ -203,6 +302,9 @@ internal class TerminalEmulatorImpl(
     private var cursorMoved = false
     private var propertyChanged = false
 
+    // Palette that cell palette slots resolve to; replaced on theme changes
+    private var palette = TerminalPalette.EMPTY
+
     // Pending semantic segments to apply during processPendingUpdates
     private val pendingSemanticSegments = mutableListOf<PendingSemanticSegment>()
 
@@ -222,6 +324,10 @@ internal class TerminalEmulatorImpl(
     private var rows = initialRows
     private var cols = initialCols
 
+    // Size requested while the size was locked
+    private var pendingRows = 0
+    private var pendingCols = 0
+
     // Cursor state
     private var cursorRow = 0
     private var cursorCol = 0
@@ -229,34 +335,47 @@ internal class TerminalEmulatorImpl(
     private var cursorShape = CursorShape.BLOCK
     private var cursorBlink = false
 
+    // Text blink phase - blinking text is hidden while false. Flipped by
+    // blinkTick() and read when the next snapshot is built.
+    @Volatile
+    private var textBlinkVisible = true
+
     // Terminal properties
     private var terminalTitle = ""
 
-    // Scrollback buffer
-    private val scrollback = mutableListOf<TerminalLine>()
+    // Scrollback buffer, as unwrapped lines
     private val maxScrollbackLines = 1000
-    // Cached immutable copy of scrollback - only recreate when scrollback changes
+    private val scrollback = ScrollbackBuffer(maxScrollbackLines)
+    // Cached rows of the scrollback - only rebuilt when it or the width changes
     private var scrollbackSnapshot: List<TerminalLine> = emptyList()
     private var scrollbackDirty = false
 
     // Reusable CellRun for fetching cell data
     private val cellRun = CellRun()
 
-    // Current screen lines cache
-    private var currentLines = List(initialRows) { row ->
+    // Shared copy of the screen that rows are read from without native calls
+    private val gridMirror by lazy { GridMirror(terminalNative) }
+
+    // Current screen lines cache, shared with the snapshots built from it
+    private var currentLines = RowStore(List(initialRows) { row ->
         TerminalLine.empty(row, initialCols, currentDefaultForeground, currentDefaultBackground)
-    }
+    })
 
     // Native terminal instance - MUST be initialized AFTER damageLock and other state
     private val terminalNative by lazy {
-        TerminalNative(this).apply {
-            resize(initialRows, initialCols)
+        TerminalNative(this, initialRows, initialCols).also {
+            // Rows of huge dumps that would not survive in the history are skipped
+            it.setScrollbackLimit(maxScrollbackLines)
         }
     }
 
     // Parser for OSC sequences
     private val oscParser = OscParser()
 
+    // Exit listener for the process started by startProcess
+    @Volatile
+    private var processExitListener: ((Int) -> Unit)? = null
+
     // ================================================================================
     // Public API
     // ================================================================================
@@ -279,9 +398,33 @@ internal class TerminalEmulatorImpl(
      * Resize the terminal.
      */
     override fun resize(newRows: Int, newCols: Int) {
+        if (terminalNative.resize(newRows, newCols) == 1) {
+            // Size is locked; native applies it on unlock
+            pendingRows = newRows
+            pendingCols = newCols
+            return
+        }
+        applyResize(newRows, newCols)
+    }
+
+    /**
+     * Hold the current size while the view zooms, so a pinch gesture does not
+     * reflow the screen or send a window size change per frame. Unlocking
+     * applies the last size passed to [resize] while locked, if any.
+     */
+    internal fun setSizeLocked(locked: Boolean) {
+        if (terminalNative.setSizeLocked(locked) == 1) {
+            applyResize(pendingRows, pendingCols)
+        }
+        if (!locked) {
+            pendingRows = 0
+            pendingCols = 0
+        }
+    }
+
+    private fun applyResize(newRows: Int, newCols: Int) {
         rows = newRows
         cols = newCols
-        terminalNative.resize(newRows, newCols)
 
         // Capture current default colors (thread-safe)
         val currentDefaultFg: Color
@@ -289,12 +432,14 @@ internal class TerminalEmulatorImpl(
         synchronized(damageLock) {
             currentDefaultFg = currentDefaultForeground
             currentDefaultBg = currentDefaultBackground
+            // Scrollback rewraps lazily at the new width
+            scrollbackDirty = true
         }
 
         // Resize currentLines to match new dimensions
-        currentLines = List(newRows) { row ->
+        currentLines = RowStore(List(newRows) { row ->
             TerminalLine.empty(row, newCols, currentDefaultFg, currentDefaultBg)
-        }
+        })
 
         // Rebuild all lines after resize
         invalidateDisplay()
@@ -305,6 +450,46 @@ internal class TerminalEmulatorImpl(
         }
     }
 
+    /**
+     * Run a local process on a native PTY.
+     */
+    override fun startProcess(
+        command: List<String>,
+        environment: List<String>?,
+        workingDirectory: String?,
+        onExit: ((Int) -> Unit)?
+    ): Int {
+        require(command.isNotEmpty()) { "command must not be empty" }
+
+        processExitListener = onExit
+        val pid = terminalNative.startProcess(
+            command.toTypedArray(),
+            environment?.toTypedArray(),
+            workingDirectory
+        )
+        if (pid < 0) {
+            throw IOException("Failed to start ${command[0]}: errno ${-pid}")
+        }
+        return pid
+    }
+
+    /**
+     * Send keyboard output straight to a descriptor.
+     */
+    override fun setOutputDescriptor(descriptor: ParcelFileDescriptor?) {
+        val result = terminalNative.setOutputFd(descriptor?.fd ?: -1)
+        if (result < 0) {
+            throw IOException("Cannot write terminal output to descriptor: errno ${-result}")
+        }
+    }
+
+    /**
+     * Select the output character encoding.
+     */
+    override fun setEncoding(encoding: TerminalEncoding) {
+        terminalNative.setEncoding(encoding.ordinal)
+    }
+
     /**
      * Dispatch a key event to the terminal.
      */
@@ -324,6 +509,55 @@ internal class TerminalEmulatorImpl(
      */
     override fun clearScreen() = writeInput("\u001B[2J\u001B[H".toByteArray())
 
+    /**
+     * Flip the text blink phase and redraw only the rows with blinking text.
+     * Called by the Terminal composable's blink timer.
+     *
+     * @return Number of rows with blinking text; 0 means the blink timer can stop
+     */
+    internal fun blinkTick(): Int {
+        textBlinkVisible = !textBlinkVisible
+        val rows = terminalNative.blinkTick()
+        if (rows == 0) {
+            // Nothing blinks, so the next blinking text starts out shown
+            textBlinkVisible = true
+        }
+        return rows
+    }
+
+    /**
+     * Find the word, path or URL around a cell of the visible screen.
+     */
+    override fun selectionExtent(row: Int, col: Int, unit: SelectionUnit): IntArray? {
+        val extent = IntArray(4)
+        return if (terminalNative.getSelectExtent(row, col, unit, extent)) extent else null
+    }
+
+    /**
+     * Enable per-command profiling of the escape sequences this terminal processes.
+     */
+    override fun setCommandProfiling(sampleEvery: Int) = terminalNative.setProfiling(sampleEvery)
+
+    /**
+     * Per-command counts and sampled timings, most expensive first.
+     */
+    override fun commandProfile(): String = terminalNative.getProfileReport()
+
+    /**
+     * Lay out long runs of plain text within a single write on worker threads.
+     */
+    override fun setParallelParsing(threads: Int) = terminalNative.setParallelParsing(threads)
+
+    /**
+     * Costs of recent shell commands, delimited by OSC 133 shell integration marks.
+     */
+    override fun recentCommandCosts(): List<CommandCost> = terminalNative.getCommandStats().toList()
+
+    /**
+     * Output text written since the cursor, for screen reader announcements.
+     */
+    internal fun readNewOutput(cursor: LongArray): String = terminalNative.readOutputText(cursor)
+
     /**
      * Set ANSI palette colors (indices 0-15).
      *
@@ -338,7 +572,7 @@ internal class TerminalEmulatorImpl(
             "ANSI palette must contain 16 colors"
         }
         val result = terminalNative.setPaletteColors(ansiColors, 16)
-        invalidateDisplay()
+        refreshPalette()
         return result
     }
 
@@ -359,7 +593,7 @@ internal class TerminalEmulatorImpl(
             currentDefaultBackground = Color(background)
         }
         val result = terminalNative.setDefaultColors(foreground, background)
-        invalidateDisplay()
+        refreshPalette()
         return result
     }
 
@@ -469,15 +703,16 @@ internal class TerminalEmulatorImpl(
         return 0
     }
 
-    override fun bell(): Int {
-        // Bell callback - post to handler to avoid blocking native thread
+    override fun bell(count: Int): Int {
+        // Bell callback - post to handler to avoid blocking native thread.
+        // A burst of bells in one write rings once.
         handler.post {
             onBell?.invoke()
         }
         return 0
     }
 
-    override fun pushScrollbackLine(cols: Int, cells: Array<ScreenCell>): Int {
+    override fun pushScrollbackLine(cols: Int, cells: Array<ScreenCell>, continuation: Boolean): Int {
         // Convert ScreenCell array to TerminalLine
         val cellList = cells.take(cols).map { screenCell ->
             TerminalLine.Cell(
@@ -493,13 +728,9 @@ internal class TerminalEmulatorImpl(
                 width = screenCell.width
             )
         }
-        val line = TerminalLine(row = -1, cells = cellList)
 
         synchronized(damageLock) {
-            scrollback.add(line)
-            if (scrollback.size > maxScrollbackLines) {
-                scrollback.removeAt(0)
-            }
+            scrollback.push(cellList, continuation, currentDefaultBackground)
             scrollbackDirty = true
             propertyChanged = true
             if (!damagePosted) {
@@ -515,6 +746,22 @@ internal class TerminalEmulatorImpl(
         return 0
     }
 
+    override fun clearScrollback(): Int {
+        synchronized(damageLock) {
+            // Drop the lines and the cached copy now rather than at the next
+            // frame, so the memory can be reclaimed right away
+            scrollback.clear()
+            scrollbackSnapshot = emptyList()
+            scrollbackDirty = true
+            propertyChanged = true
+            if (!damagePosted) {
+                handler.post { processPendingUpdates() }
+                damagePosted = true
+            }
+        }
+        return 0
+    }
+
     override fun onKeyboardInput(data: ByteArray): Int {
         // Keyboard output callback - post to handler
         handler.post {
@@ -523,6 +770,14 @@ internal class TerminalEmulatorImpl(
         return 0
     }
 
+    override fun onTransportClosed(exitCode: Int): Int {
+        // Runs on the native transport thread - post to handler
+        handler.post {
+            processExitListener?.invoke(exitCode)
+        }
+        return 0
+    }
+
     override fun onOscSequence(command: Int, payload: String): Int {
         val actions = synchronized(damageLock) {
             oscParser.parse(command, payload, cursorRow, cursorCol, cols)
@@ -611,13 +866,12 @@ internal class TerminalEmulatorImpl(
 
         if (!needsUpdate) return
 
-        // Update damaged lines (safe to call getCellRun now - not in callback)
-        for (region in damageRegions) {
-            // Ensure row is within bounds [0, rows)
-            val startRow = region.startRow.coerceIn(0, rows - 1)
-            val endRow = region.endRow.coerceIn(startRow, rows)  // endRow is exclusive
-            for (row in startRow until endRow) {
-                updateLine(row)
+        // Update damaged lines from one frame of the grid mirror, or through
+        // getCellRun if the frames change too fast to read one
+        if (damageRegions.isNotEmpty()) {
+            val grid = gridMirror
+            if (!grid.read { updateLines(damageRegions, grid) }) {
+                updateLines(damageRegions, null)
             }
         }
 
@@ -663,15 +917,31 @@ internal class TerminalEmulatorImpl(
             .sortedBy { it.startCol }
 
         // Update the line with new segments
-        currentLines = currentLines.toMutableList().apply {
-            this[row] = line.copy(semanticSegments = updatedSegments)
+        currentLines[row] = line.copy(semanticSegments = updatedSegments)
+    }
+
+    private fun updateLines(damageRegions: List<DamageRegion>, grid: GridMirror?) {
+        for (region in damageRegions) {
+            // Ensure row is within bounds [0, rows)
+            val startRow = region.startRow.coerceIn(0, rows - 1)
+            val endRow = region.endRow.coerceIn(startRow, rows)  // endRow is exclusive
+            for (row in startRow until endRow) {
+                updateLine(row, region.startCol, region.endCol, grid)
+            }
         }
     }
 
     /**
      * Update a single line by fetching cell data from the terminal.
+     *
+     * Only the damaged columns are fetched when the cached line still covers
+     * the full width, so a small change on a very wide line costs about as
+     * much as it would on a narrow one.
+     *
+     * Cells come from [grid] while a frame of it is being read, and through
+     * getCellRun otherwise or where the frame does not cover them.
      */
-    private fun updateLine(row: Int) {
+    private fun updateLine(row: Int, startCol: Int = 0, endCol: Int = cols, grid: GridMirror? = null) {
         // Safety check: ensure row is within bounds
         if (row !in 0..<rows) {
             return
@@ -685,21 +955,85 @@ internal class TerminalEmulatorImpl(
             currentDefaultBg = currentDefaultBackground
         }
 
-        val cells = mutableListOf<TerminalLine.Cell>()
-        var col = 0
+        // Widen the damage to whole cached cells, so a wide character is never split
+        val oldCells = if (row < currentLines.size) currentLines[row].cells else null
+        var firstIndex = 0
+        var lastIndex = 0
+        var fromCol = 0
+        var toCol = cols
+        if (oldCells != null && (startCol > 0 || endCol < cols)) {
+            var col = 0
+            var index = 0
+            while (index < oldCells.size && col + oldCells[index].width <= startCol) {
+                col += oldCells[index].width
+                index++
+            }
+            firstIndex = index
+            fromCol = col
+            while (index < oldCells.size && col < endCol) {
+                col += oldCells[index].width
+                index++
+            }
+            lastIndex = index
+            toCol = col
+            while (index < oldCells.size) {
+                col += oldCells[index].width
+                index++
+            }
+            if (col != cols) {
+                // Cached line is stale (e.g. from before a resize); fetch it all
+                fromCol = 0
+                toCol = cols
+            }
+        }
+
+        val cells = ArrayList<TerminalLine.Cell>(toCol - fromCol)
+        if (grid == null || !grid.readCells(row, fromCol, toCol, cells)) {
+            fetchCellRuns(row, fromCol, toCol, cells, currentDefaultFg, currentDefaultBg)
+        }
+
+        // Splice the fetched cells between the untouched ends of the cached line
+        val lineCells = if (oldCells != null && (fromCol > 0 || toCol < cols)) {
+            ArrayList<TerminalLine.Cell>(oldCells.size - (lastIndex - firstIndex) + cells.size).apply {
+                addAll(oldCells.subList(0, firstIndex))
+                addAll(cells)
+                addAll(oldCells.subList(lastIndex, oldCells.size))
+            }
+        } else {
+            cells
+        }
+
+        // Update cached line (segments will be added later in processPendingUpdates)
+        currentLines[row] = TerminalLine(row, lineCells)
+    }
+
+    /**
+     * Fetch cells in [fromCol, toCol) of [row] one run at a time.
+     */
+    private fun fetchCellRuns(
+        row: Int,
+        fromCol: Int,
+        toCol: Int,
+        cells: MutableList<TerminalLine.Cell>,
+        currentDefaultFg: Color,
+        currentDefaultBg: Color
+    ) {
+        var col = fromCol
 
-        while (col < cols) {
+        while (col < toCol) {
             cellRun.reset()
-            val runLength = terminalNative.getCellRun(row, col, cellRun)
+            val runLength = terminalNative.getCellRun(row, col, toCol, cellRun)
 
             if (runLength <= 0) {
                 // Fill remaining with empty cells
-                while (col < cols) {
+                while (col < toCol) {
                     cells.add(
                         TerminalLine.Cell(
                             char = ' ',
                             fgColor = currentDefaultFg,
-                            bgColor = currentDefaultBg
+                            bgColor = currentDefaultBg,
+                            fgIndex = TerminalPalette.DEFAULT_FG,
+                            bgIndex = TerminalPalette.DEFAULT_BG
                         )
                     )
                     col++
@@ -712,19 +1046,20 @@ internal class TerminalEmulatorImpl(
             val bgColor = Color(cellRun.bgRed, cellRun.bgGreen, cellRun.bgBlue)
 
             // Process characters in the run
+            val chars = cellRun.chars
+            val charCount = cellRun.charCount
             var charIndex = 0
-            var cellsInRun = 0
 
-            while (charIndex < cellRun.chars.size && cellsInRun < runLength) {
-                val char = cellRun.chars[charIndex]
+            while (charIndex < charCount) {
+                val char = chars[charIndex]
                 if (char == 0.toChar()) break
 
                 val combiningChars = mutableListOf<Char>()
                 charIndex++
 
                 // Handle surrogate pairs (characters > U+FFFF like emoji)
-                if (char.isHighSurrogate() && charIndex < cellRun.chars.size) {
-                    val nextChar = cellRun.chars[charIndex]
+                if (char.isHighSurrogate() && charIndex < charCount) {
+                    val nextChar = chars[charIndex]
                     if (nextChar.isLowSurrogate()) {
                         combiningChars.add(nextChar)
                         charIndex++
@@ -732,8 +1067,8 @@ internal class TerminalEmulatorImpl(
                 }
 
                 // Collect combining characters
-                while (charIndex < cellRun.chars.size && isCombiningCharacter(cellRun.chars[charIndex])) {
-                    combiningChars.add(cellRun.chars[charIndex])
+                while (charIndex < charCount && isCombiningCharacter(chars[charIndex])) {
+                    combiningChars.add(chars[charIndex])
                     charIndex++
                 }
 
@@ -751,6 +1086,8 @@ internal class TerminalEmulatorImpl(
                         combiningChars = combiningChars,
                         fgColor = fgColor,
                         bgColor = bgColor,
+                        fgIndex = cellRun.fgIndex,
+                        bgIndex = cellRun.bgIndex,
                         bold = cellRun.bold,
                         italic = cellRun.italic,
                         underline = cellRun.underline,
@@ -760,19 +1097,9 @@ internal class TerminalEmulatorImpl(
                         width = width
                     )
                 )
-
-                cellsInRun++
-                if (width == 2) {
-                    cellsInRun++
-                }
             }
 
-            col += cellsInRun
-        }
-
-        // Update cached line (segments will be added later in processPendingUpdates)
-        currentLines = currentLines.toMutableList().apply {
-            this[row] = TerminalLine(row, cells)
+            col += runLength
         }
     }
 
@@ -781,26 +1108,30 @@ internal class TerminalEmulatorImpl(
      */
     private fun buildSnapshot(): TerminalSnapshot {
         // Only copy scrollback if it changed (avoid copying 10K references every frame!)
+        val currentPalette: TerminalPalette
         synchronized(damageLock) {
             if (scrollbackDirty) {
-                scrollbackSnapshot = scrollback.toList()
+                scrollbackSnapshot = scrollback.snapshot(cols)
                 scrollbackDirty = false
             }
+            currentPalette = palette
         }
 
         return TerminalSnapshot(
-            lines = currentLines.toList(),  // Immutable copy (24 references)
+            lines = currentLines.snapshot(),  // Shares unchanged rows with the last snapshot
             scrollback = scrollbackSnapshot,  // Reuse cached immutable copy
             cursorRow = cursorRow,
             cursorCol = cursorCol,
             cursorVisible = cursorVisible,
             cursorShape = cursorShape,
             cursorBlink = cursorBlink,
+            textBlinkVisible = textBlinkVisible,
             terminalTitle = terminalTitle,
             rows = rows,
             cols = cols,
             timestamp = System.currentTimeMillis(),
-            sequenceNumber = sequenceNumber++
+            sequenceNumber = sequenceNumber++,
+            palette = currentPalette
         )
     }
 
@@ -823,6 +1154,28 @@ internal class TerminalEmulatorImpl(
         }
     }
 
+    /**
+     * Fetch the palette after a color change and publish it with the next snapshot.
+     * Cells refer to palette slots, so no rows need to be re-fetched.
+     */
+    private fun refreshPalette() {
+        val argb = IntArray(TerminalPalette.SIZE)
+        if (terminalNative.getPalette(argb) != TerminalPalette.SIZE) {
+            // Fall back to re-fetching every row with resolved colors
+            invalidateDisplay()
+            return
+        }
+
+        synchronized(damageLock) {
+            palette = TerminalPalette.fromArgb(argb)
+            propertyChanged = true
+            if (!damagePosted) {
+                handler.post { processPendingUpdates() }
+                damagePosted = true
+            }
+        }
+    }
+
     /**
      * Add a damage region, coalescing with existing regions where possible.
      *
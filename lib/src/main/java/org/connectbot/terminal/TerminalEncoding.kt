@@ -0,0 +1,35 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+/**
+ * Character encoding of the bytes passed to [TerminalEmulator.writeInput].
+ * The order matches libvterm's VTermLegacyEncoding.
+ *
+ * Legacy encodings are decoded natively as the output is parsed, so a host
+ * that does not speak UTF-8 needs no transcoding pass in front of the terminal.
+ * C1 controls are only recognized in their 7-bit form while one is selected,
+ * since those bytes are lead bytes in these encodings.
+ */
+enum class TerminalEncoding {
+    UTF_8,
+    SHIFT_JIS,
+    EUC_JP,
+    GBK,
+    BIG5,
+    EUC_KR
+}
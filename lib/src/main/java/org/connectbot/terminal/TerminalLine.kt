@@ -77,6 +77,8 @@ internal data class TerminalLine(
         val combiningChars: List<Char> = emptyList(),
         val fgColor: Color,
         val bgColor: Color,
+        val fgIndex: Int = TerminalPalette.DIRECT,  // palette slot that overrides fgColor
+        val bgIndex: Int = TerminalPalette.DIRECT,  // palette slot that overrides bgColor
         val bold: Boolean = false,
         val italic: Boolean = false,
         val underline: Int = 0,  // 0=none, 1=single, 2=double, 3=curly
@@ -103,7 +105,9 @@ internal data class TerminalLine(
                     Cell(
                         char = '\u0000',
                         fgColor = defaultFg,
-                        bgColor = defaultBg
+                        bgColor = defaultBg,
+                        fgIndex = TerminalPalette.DEFAULT_FG,
+                        bgIndex = TerminalPalette.DEFAULT_BG
                     )
                 }
             )
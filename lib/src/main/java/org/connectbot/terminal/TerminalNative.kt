@@ -16,7 +16,9 @@
  */
 package org.connectbot.terminal
 
+import dalvik.annotation.optimization.CriticalNative
 import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
 /**
  * Terminal emulator using libvterm via JNI.
@@ -27,16 +29,26 @@ import java.nio.ByteBuffer
  * - Reading data from PTY and feeding to writeInput()
  * - Handling onKeyboardInput() callback and writing to PTY
  *
+ * The exception is a native transport, such as a local process started with
+ * startProcess(), which is read and written entirely in native code.
+ *
  * Thread Safety:
  * - All native calls are protected by a non-reentrant mutex
  * - Callbacks MUST NOT call back into Terminal methods (will deadlock)
  * - Safe to call from multiple threads (serialized by native mutex)
  */
-internal class TerminalNative(callbacks: TerminalCallbacks) : AutoCloseable {
+internal class TerminalNative(
+    callbacks: TerminalCallbacks,
+    rows: Int = 24,
+    cols: Int = 80
+) : AutoCloseable {
     private var nativePtr: Long = 0
 
+    // Buffer native code writes cell runs to; held here so it outlives its use
+    private var cellRunBuffer: ByteBuffer? = null
+
     init {
-        nativePtr = nativeInit(callbacks)
+        nativePtr = nativeInit(callbacks, rows, cols)
         if (nativePtr == 0L) {
             throw RuntimeException("Failed to initialize native terminal")
         }
@@ -74,13 +86,87 @@ internal class TerminalNative(callbacks: TerminalCallbacks) : AutoCloseable {
      *
      * @param rows Number of rows
      * @param cols Number of columns
-     * @return 0 on success
+     * @return 0 on success, 1 if the size is locked and the resize was deferred
      */
     fun resize(rows: Int, cols: Int): Int {
         checkNotClosed()
         return nativeResize(nativePtr, rows, cols)
     }
 
+    /**
+     * Hold the terminal at its current size.
+     *
+     * While locked, [resize] only records the requested size: the screen is
+     * not reflowed and the remote side is not told. Unlocking applies the
+     * last requested size once, if it differs from the current one.
+     *
+     * @param locked true to lock, false to unlock
+     * @return 1 if unlocking applied a deferred resize, 0 otherwise
+     */
+    fun setSizeLocked(locked: Boolean): Int {
+        checkNotClosed()
+        return nativeSetSizeLocked(nativePtr, locked)
+    }
+
+    /**
+     * Run a local process on a native PTY bound to this terminal.
+     *
+     * A native thread reads the PTY and parses its output directly, and
+     * keyboard output goes straight to the PTY instead of onKeyboardInput().
+     * The PTY follows [resize]. [TerminalCallbacks.onTransportClosed] is called
+     * when the process exits; it is hung up when the terminal is closed.
+     *
+     * @param argv Program (searched on PATH) and its arguments
+     * @param env Environment as NAME=value strings, or null to inherit
+     * @param cwd Working directory, or null to inherit
+     * @return Process ID, or a negative errno on failure
+     */
+    fun startProcess(argv: Array<String>, env: Array<String>?, cwd: String?): Int {
+        checkNotClosed()
+        return nativeStartProcess(nativePtr, argv, env, cwd)
+    }
+
+    /**
+     * Bind a socketpair loopback transport, for tests and benchmarks.
+     *
+     * Bytes written to the returned descriptor are parsed as terminal input
+     * on the native transport thread, and keyboard output and terminal
+     * replies can be read back from it. The caller owns the descriptor.
+     *
+     * @return File descriptor of the caller's end, or a negative errno on failure
+     */
+    fun bindLoopback(): Int {
+        checkNotClosed()
+        return nativeBindLoopback(nativePtr)
+    }
+
+    /**
+     * Write keyboard output and terminal replies straight to a descriptor
+     * instead of the onKeyboardInput() callback.
+     *
+     * The caller keeps ownership of the descriptor and must keep it open
+     * until it is unregistered or the terminal is closed. Its blocking mode
+     * is not changed; output it cannot take yet is queued natively.
+     *
+     * @param fd Descriptor to write to, or -1 to go back to onKeyboardInput()
+     * @return 0 on success, or a negative errno
+     */
+    fun setOutputFd(fd: Int): Int {
+        checkNotClosed()
+        return nativeSetOutputFd(nativePtr, fd)
+    }
+
+    /**
+     * Select the character encoding used to decode terminal output.
+     *
+     * @param encoding A TerminalEncoding ordinal
+     * @return 0 on success, -1 if the encoding is unknown
+     */
+    fun setEncoding(encoding: Int): Int {
+        checkNotClosed()
+        return nativeSetEncoding(nativePtr, encoding)
+    }
+
     /**
      * Dispatch a keyboard key event to the terminal.
      * This generates appropriate escape sequences via onKeyboardInput() callback.
@@ -113,12 +199,150 @@ internal class TerminalNative(callbacks: TerminalCallbacks) : AutoCloseable {
      *
      * @param row Row index (0-based)
      * @param col Column index (0-based)
+     * @param endCol Column the run must stop before
      * @param run CellRun object to fill (reusable, call reset() first)
      * @return Number of cells in the run
      */
-    fun getCellRun(row: Int, col: Int, run: CellRun): Int {
+    fun getCellRun(row: Int, col: Int, endCol: Int, run: CellRun): Int {
+        checkNotClosed()
+        if (run.buffer !== cellRunBuffer) {
+            if (nativeSetCellRunBuffer(nativePtr, run.buffer) != 0) {
+                throw IllegalArgumentException("Cell run buffer was rejected")
+            }
+            cellRunBuffer = run.buffer
+        }
+
+        val runLength = nativeGetCellRun(nativePtr, row, col, endCol)
+        if (runLength > 0) {
+            run.load()
+        }
+        return runLength
+    }
+
+    /**
+     * Map the grid mirror native code keeps of the screen, creating it on
+     * first use. From then on damage is reported only once the damaged rows
+     * are in the mirror. See [GridMirror].
+     *
+     * @return The mirror's memory, or null if it could not be allocated
+     */
+    fun getGridBuffer(): ByteBuffer? {
+        checkNotClosed()
+        return nativeGetGridBuffer(nativePtr)?.order(ByteOrder.nativeOrder())
+    }
+
+    /**
+     * Start reading a frame from the grid mirror.
+     *
+     * @return The frame's sequence number; odd while a frame is being written
+     */
+    fun gridReadBegin(): Long {
+        checkNotClosed()
+        return nativeGridReadBegin(nativePtr)
+    }
+
+    /**
+     * Check that rows read since [gridReadBegin] belong to one frame.
+     */
+    fun gridReadValidate(sequence: Long): Boolean {
+        checkNotClosed()
+        return nativeGridReadValidate(nativePtr, sequence)
+    }
+
+    /**
+     * Emit damage for the rows that contain blinking cells, so the caller
+     * can redraw them after flipping its blink phase. The phase itself is
+     * kept by the caller; nothing else changes here.
+     *
+     * @return Number of rows with blinking cells; 0 means no blink timer is needed
+     */
+    fun blinkTick(): Int {
+        checkNotClosed()
+        return nativeBlinkTick(nativePtr)
+    }
+
+    /**
+     * Find the unit of text around a cell, following soft-wrapped lines.
+     *
+     * @param row Row index (0-based)
+     * @param col Column index (0-based)
+     * @param unit What counts as one unit of text
+     * @param extent Receives startRow, startCol, endRow, endCol (end exclusive)
+     * @return false if the position is off the screen
+     */
+    fun getSelectExtent(row: Int, col: Int, unit: SelectionUnit, extent: IntArray): Boolean {
+        checkNotClosed()
+        return nativeGetSelectExtent(nativePtr, row, col, unit.ordinal, extent)
+    }
+
+    /**
+     * Enable the native command profiler, which counts every escape sequence
+     * and text run and times one in every [sampleEvery] of them.
+     *
+     * @param sampleEvery Sampling interval; 0 disables profiling and discards the data
+     */
+    fun setProfiling(sampleEvery: Int) {
+        checkNotClosed()
+        nativeSetProfiling(nativePtr, sampleEvery)
+    }
+
+    /**
+     * Lay out long runs of plain text lines within one [writeInput] on
+     * [threads] worker threads, then hand the rows to scrollback in order.
+     * Escape sequences and other control characters are still parsed in order.
+     *
+     * @param threads Worker threads; 0 parses everything on the calling thread
+     */
+    fun setParallelParsing(threads: Int) {
+        checkNotClosed()
+        nativeSetParallelParsing(nativePtr, threads)
+    }
+
+    /**
+     * Tell the terminal how many logical lines of history are kept. Within a
+     * long run of plain text lines in one [writeInput], rows that would be
+     * evicted again before it returns are not passed to
+     * [TerminalCallbacks.pushScrollbackLine], and are not laid out at all
+     * when nothing else needs them.
+     *
+     * @param lines Lines kept; 0 passes every row
+     */
+    fun setScrollbackLimit(lines: Int) {
+        checkNotClosed()
+        nativeSetScrollbackLimit(nativePtr, lines)
+    }
+
+    /**
+     * Dump the command profile, one line per command with the most expensive first.
+     *
+     * @return Report text, empty when profiling is disabled
+     */
+    fun getProfileReport(): String {
         checkNotClosed()
-        return nativeGetCellRun(nativePtr, row, col, run)
+        return nativeGetProfileReport(nativePtr)
+    }
+
+    /**
+     * Costs of recent shell commands, oldest first, followed by the running
+     * command if there is one. Only the most recent 64 are kept.
+     */
+    fun getCommandStats(): Array<CommandCost> {
+        checkNotClosed()
+        return nativeGetCommandStats(nativePtr) ?: emptyArray()
+    }
+
+    /**
+     * New output text for accessibility: finalized lines and the current line
+     * up to the cursor, without OSC 133 prompts and input. Only the last 16K
+     * characters are kept, and only after the first call.
+     *
+     * @param cursor Stream offset to read from, updated to the end of the
+     *               returned text; start with -1 to skip existing output
+     * @return Text written since the cursor
+     */
+    fun readOutputText(cursor: LongArray): String {
+        checkNotClosed()
+        return nativeReadOutputText(nativePtr, cursor) ?: ""
     }
 
     /**
@@ -138,6 +362,20 @@ internal class TerminalNative(callbacks: TerminalCallbacks) : AutoCloseable {
         return nativeSetPaletteColors(nativePtr, colors, count)
     }
 
+    /**
+     * Export the palette that cell palette slots refer to.
+     *
+     * Fills up to [TerminalPalette.SIZE] ARGB colors: the 256 indexed colors
+     * followed by the default foreground and background.
+     *
+     * @param colors IntArray to receive the ARGB colors
+     * @return Number of colors written, or -1 on error
+     */
+    fun getPalette(colors: IntArray): Int {
+        checkNotClosed()
+        return nativeGetPalette(nativePtr, colors)
+    }
+
     /**
      * Set default foreground and background colors.
      *
@@ -177,15 +415,33 @@ internal class TerminalNative(callbacks: TerminalCallbacks) : AutoCloseable {
     }
 
     // Native method declarations
-    private external fun nativeInit(callbacks: TerminalCallbacks): Long
+    private external fun nativeInit(callbacks: TerminalCallbacks, rows: Int, cols: Int): Long
     private external fun nativeDestroy(ptr: Long): Int
     private external fun nativeWriteInputBuffer(ptr: Long, buffer: ByteBuffer, length: Int): Int
     private external fun nativeWriteInputArray(ptr: Long, data: ByteArray, offset: Int, length: Int): Int
     private external fun nativeResize(ptr: Long, rows: Int, cols: Int): Int
+    private external fun nativeSetSizeLocked(ptr: Long, locked: Boolean): Int
+    private external fun nativeStartProcess(ptr: Long, argv: Array<String>, env: Array<String>?, cwd: String?): Int
+    private external fun nativeBindLoopback(ptr: Long): Int
+    private external fun nativeSetOutputFd(ptr: Long, fd: Int): Int
+    private external fun nativeSetEncoding(ptr: Long, encoding: Int): Int
     private external fun nativeDispatchKey(ptr: Long, modifiers: Int, key: Int): Boolean
     private external fun nativeDispatchCharacter(ptr: Long, modifiers: Int, character: Int): Boolean
-    private external fun nativeGetCellRun(ptr: Long, row: Int, col: Int, run: CellRun): Int
+    private external fun nativeSetCellRunBuffer(ptr: Long, buffer: ByteBuffer?): Int
+    // Not @CriticalNative: it waits on the terminal lock, and a thread blocked
+    // there would hold up garbage collection. The run lands in the registered buffer.
+    private external fun nativeGetCellRun(ptr: Long, row: Int, col: Int, endCol: Int): Int
+    private external fun nativeGetGridBuffer(ptr: Long): ByteBuffer?
+    private external fun nativeBlinkTick(ptr: Long): Int
+    private external fun nativeGetSelectExtent(ptr: Long, row: Int, col: Int, mode: Int, extent: IntArray): Boolean
+    private external fun nativeSetProfiling(ptr: Long, sampleEvery: Int)
+    private external fun nativeGetProfileReport(ptr: Long): String
+    private external fun nativeSetParallelParsing(ptr: Long, threads: Int)
+    private external fun nativeSetScrollbackLimit(ptr: Long, lines: Int)
+    private external fun nativeGetCommandStats(ptr: Long): Array<CommandCost>?
+    private external fun nativeReadOutputText(ptr: Long, cursor: LongArray): String?
     private external fun nativeSetPaletteColors(ptr: Long, colors: IntArray, count: Int): Int
+    private external fun nativeGetPalette(ptr: Long, colors: IntArray): Int
     private external fun nativeSetDefaultColors(ptr: Long, fgColor: Int, bgColor: Int): Int
 
     companion object {
@@ -196,5 +452,24 @@ internal class TerminalNative(callbacks: TerminalCallbacks) : AutoCloseable {
                 System.err.println("Failed to load JNI library: ${e.message}")
             }
         }
+
+        /**
+         * Build native terminals ahead of time, so creating a terminal of this
+         * size later skips allocation and setup. The pool holds at most 8.
+         *
+         * @return Number of terminals added to the pool
+         */
+        fun prewarm(rows: Int, cols: Int, count: Int): Int = nativePrewarm(rows, cols, count)
+
+        @JvmStatic
+        private external fun nativePrewarm(rows: Int, cols: Int, count: Int): Int
+
+        // The seqlock reads never block on a frame being written
+        @JvmStatic
+        @CriticalNative
+        private external fun nativeGridReadBegin(ptr: Long): Long
+        @JvmStatic
+        @CriticalNative
+        private external fun nativeGridReadValidate(ptr: Long, sequence: Long): Boolean
     }
 }
@@ -0,0 +1,60 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+import androidx.compose.ui.graphics.Color
+
+/**
+ * The colors that symbolic cell colors refer to: the 256-color palette
+ * followed by the default foreground and background.
+ *
+ * Cells keep a palette slot rather than a resolved color, so a theme change
+ * only needs a new palette and a repaint instead of re-fetching every row.
+ */
+internal class TerminalPalette(private val colors: Array<Color>) {
+    /**
+     * Resolve a cell color. Slots outside the palette, including [DIRECT],
+     * use the color the cell was exported with.
+     */
+    fun resolve(index: Int, direct: Color): Color {
+        return if (index in colors.indices) colors[index] else direct
+    }
+
+    companion object {
+        /** Number of palette slots: 256 indexed colors plus default fg and bg. */
+        const val SIZE = 258
+
+        /** Slot of the default foreground color. */
+        const val DEFAULT_FG = 256
+
+        /** Slot of the default background color. */
+        const val DEFAULT_BG = 257
+
+        /** Marks a direct RGB color that does not follow the palette. */
+        const val DIRECT = -1
+
+        /** Palette used before one has been exported; every cell uses its own color. */
+        val EMPTY = TerminalPalette(emptyArray())
+
+        /**
+         * Build a palette from ARGB values as exported by [TerminalNative.getPalette].
+         */
+        fun fromArgb(argb: IntArray): TerminalPalette {
+            return TerminalPalette(Array(argb.size) { Color(argb[it]) })
+        }
+    }
+}
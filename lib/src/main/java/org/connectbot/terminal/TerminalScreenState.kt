@@ -147,6 +147,10 @@ internal class TerminalScreenState(
      */
     internal fun updateSnapshot(newSnapshot: TerminalSnapshot) {
         snapshot = newSnapshot
+        // Scrollback can shrink, e.g. when it is cleared
+        if (scrollbackPosition > newSnapshot.scrollback.size) {
+            scrollbackPosition = newSnapshot.scrollback.size
+        }
     }
 }
 
@@ -45,11 +45,13 @@ internal enum class CursorShape {
  * @property cursorCol Current cursor column position (0-based)
  * @property cursorVisible Whether the cursor is currently visible
  * @property cursorShape The shape of the cursor (block, underline, or bar)
+ * @property textBlinkVisible Whether text with the blink attribute is shown in this blink phase
  * @property terminalTitle The terminal window title (set by escape sequences)
  * @property rows Number of rows in the visible terminal
  * @property cols Number of columns in the visible terminal
  * @property timestamp Timestamp when this snapshot was created (System.currentTimeMillis())
  * @property sequenceNumber Monotonically increasing sequence number for ordering snapshots
+ * @property palette Colors that the palette slots of cells resolve to
  */
 internal data class TerminalSnapshot(
     val lines: List<TerminalLine>,
@@ -59,11 +61,13 @@ internal data class TerminalSnapshot(
     val cursorVisible: Boolean,
     val cursorBlink: Boolean,
     val cursorShape: CursorShape,
+    val textBlinkVisible: Boolean = true,
     val terminalTitle: String,
     val rows: Int,
     val cols: Int,
     val timestamp: Long,
-    val sequenceNumber: Long
+    val sequenceNumber: Long,
+    val palette: TerminalPalette = TerminalPalette.EMPTY
 ) {
     companion object {
         /**
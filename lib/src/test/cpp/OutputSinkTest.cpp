@@ -0,0 +1,183 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "HostTest.h"
+#include "OutputSink.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string pushString(OutputRing& ring, const std::string& data) {
+    ring.push(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    return data;
+}
+
+// Everything queued, front span by front span
+std::string drain(OutputRing& ring) {
+    std::string result;
+    while (!ring.empty()) {
+        size_t length;
+        const uint8_t* data = ring.front(&length);
+        CHECK(length > 0);
+        result.append(reinterpret_cast<const char*>(data), length);
+        ring.consume(length);
+    }
+    return result;
+}
+
+std::string pattern(size_t length) {
+    std::string result;
+    for (int i = 0; result.size() < length; i++) {
+        result += "line " + std::to_string(i) + "\n";
+    }
+    result.resize(length);
+    return result;
+}
+
+// Reads `length` bytes from fd; fails if they stop coming
+std::string readAll(int fd, size_t length) {
+    std::string result;
+    char buffer[64 * 1024];
+    while (result.size() < length) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        CHECK(poll(&pfd, 1, 5000) == 1);
+        ssize_t n = ::read(fd, buffer, std::min(sizeof(buffer), length - result.size()));
+        CHECK(n > 0);
+        result.append(buffer, static_cast<size_t>(n));
+    }
+    return result;
+}
+
+void testRingWraps() {
+    OutputRing ring;
+    pushString(ring, "0123456789abcdef");
+
+    // Free the start of the buffer, then queue past its end
+    size_t length;
+    ring.front(&length);
+    CHECK(length == 16);
+    ring.consume(10);
+    pushString(ring, "ghijkl");
+    CHECK(ring.size() == 12);
+
+    // The first span stops at the end of the buffer
+    const uint8_t* data = ring.front(&length);
+    CHECK(length == 6);
+    CHECK(std::string(reinterpret_cast<const char*>(data), length) == "abcdef");
+    CHECK(drain(ring) == "abcdefghijkl");
+}
+
+void testRingGrowsWhileWrapped() {
+    OutputRing ring;
+    pushString(ring, "0123456789abcdef");
+    ring.consume(12);
+    std::string expected = "cdef" + pushString(ring, "ghijkl");
+
+    // Growing unwraps, so the queued bytes come out as one span
+    expected += pushString(ring, pattern(1000));
+    size_t length;
+    ring.front(&length);
+    CHECK(length == expected.size());
+    CHECK(drain(ring) == expected);
+
+    pushString(ring, "xyz");
+    ring.clear();
+    CHECK(ring.empty());
+    CHECK(drain(ring).empty());
+}
+
+void testRingConsumesPastEnd() {
+    OutputRing ring;
+    pushString(ring, "abc");
+    ring.consume(10);
+    CHECK(ring.empty());
+    pushString(ring, "def");
+    CHECK(drain(ring) == "def");
+}
+
+void checkBacklogFlushes(int writeFd, int readFd) {
+    int flags = fcntl(writeFd, F_GETFL);
+
+    std::string expected = pattern(4 * 1024 * 1024);
+    {
+        auto sink = OutputSink::create(writeFd);
+        CHECK(sink != nullptr);
+
+        // Far more than the descriptor buffers, in small writes like keys
+        for (size_t done = 0; done < expected.size(); done += 4096) {
+            size_t length = std::min<size_t>(4096, expected.size() - done);
+            CHECK(sink->write(reinterpret_cast<const uint8_t*>(expected.data()) + done, length));
+        }
+        CHECK(readAll(readFd, expected.size()) == expected);
+    }
+
+    // The descriptor stays the caller's, blocking mode and all
+    CHECK(fcntl(writeFd, F_GETFL) == flags);
+    CHECK(::write(writeFd, "x", 1) == 1);
+    CHECK(readAll(readFd, 1) == "x");
+}
+
+void testSocket() {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    checkBacklogFlushes(fds[0], fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void testPipe() {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    checkBacklogFlushes(fds[1], fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void testPipeReaderGone() {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    close(fds[0]);
+
+    auto sink = OutputSink::create(fds[1]);
+    CHECK(sink != nullptr);
+    CHECK(!sink->write(reinterpret_cast<const uint8_t*>("x"), 1));
+    CHECK(!sink->write(reinterpret_cast<const uint8_t*>("y"), 1));
+    sink.reset();
+    close(fds[1]);
+}
+
+void testBadDescriptor() {
+    CHECK(OutputSink::create(-1) == nullptr);
+    CHECK(OutputSink::create(1 << 20) == nullptr);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testRingWraps);
+    RUN_TEST(testRingGrowsWhileWrapped);
+    RUN_TEST(testRingConsumesPastEnd);
+    RUN_TEST(testSocket);
+    RUN_TEST(testPipe);
+    RUN_TEST(testPipeReaderGone);
+    RUN_TEST(testBadDescriptor);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "HostTest.h"
+#include "PtyTransport.h"
+#include <atomic>
+#include <csignal>
+#include <mutex>
+#include <string>
+
+namespace {
+
+// A shell command bound the way a session binds it, recording what it prints
+struct Session {
+    std::mutex lock;
+    std::string output;
+    std::atomic<int> exitCode{-1000};
+    std::unique_ptr<TransportBinding> binding;
+
+    explicit Session(const std::string& command, int rows = 24, int cols = 80) {
+        auto pty = PtyTransport::spawn({"/bin/sh", "-c", command}, {}, "", rows, cols);
+        CHECK(pty != nullptr);
+        binding = TransportBinding::start(
+            std::move(pty),
+            [this](const uint8_t* data, size_t length) {
+                std::lock_guard<std::mutex> guard(lock);
+                output.append(reinterpret_cast<const char*>(data), length);
+            },
+            [this](int code) { exitCode = code; });
+        CHECK(binding != nullptr);
+    }
+
+    std::string text() {
+        std::lock_guard<std::mutex> guard(lock);
+        return output;
+    }
+
+    bool exited() { return waitFor([this] { return exitCode != -1000; }); }
+};
+
+void testExitCode() {
+    Session session("printf hello; exit 3");
+    CHECK(session.exited());
+    CHECK(session.exitCode == 3);
+    CHECK(session.text() == "hello");
+}
+
+void testKilledBySignal() {
+    Session session("kill -TERM $$");
+    CHECK(session.exited());
+    CHECK(session.exitCode == 128 + SIGTERM);
+}
+
+void testInputReachesChild() {
+    Session session("read line; printf '<%s>' \"$line\"");
+    const char* input = "typed\r";
+    CHECK(session.binding->write(reinterpret_cast<const uint8_t*>(input), 6));
+    CHECK(session.exited());
+    CHECK(session.exitCode == 0);
+    CHECK(session.text().find("<typed>") != std::string::npos);
+}
+
+void testWindowSize() {
+    Session session("read go; stty size", 24, 80);
+    session.binding->transport().setWindowSize(40, 132);
+    CHECK(session.binding->write(reinterpret_cast<const uint8_t*>("\r"), 1));
+    CHECK(session.exited());
+    CHECK(session.text().find("40 132") != std::string::npos);
+}
+
+// Closing the terminal without exiting ends the stream but leaves nothing
+// to reap; finish() must not wait on it forever
+void testChildOutlivesTerminal() {
+    Session session("trap '' HUP; exec >/dev/null 2>&1 </dev/null; sleep 30");
+    auto start = std::chrono::steady_clock::now();
+    CHECK(session.exited());
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(3));
+    CHECK(session.exitCode == 128 + SIGKILL);
+}
+
+// Tearing down a binding whose child is still running returns promptly
+void testDestroyWhileRunning() {
+    auto session = std::make_unique<Session>("sleep 30");
+    auto start = std::chrono::steady_clock::now();
+    session->binding.reset();
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    CHECK(session->exitCode == -1000);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testExitCode);
+    RUN_TEST(testKilledBySignal);
+    RUN_TEST(testInputReachesChild);
+    RUN_TEST(testWindowSize);
+    RUN_TEST(testChildOutlivesTerminal);
+    RUN_TEST(testDestroyWhileRunning);
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "HostTest.h"
+#include "Transport.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+struct Loopback {
+    std::mutex lock;
+    std::string input;
+    std::atomic<int> exitCode{-1000};
+    std::unique_ptr<TransportBinding> binding;
+    int peerFd;
+
+    Loopback() {
+        auto transport = LoopbackTransport::create();
+        CHECK(transport != nullptr);
+        peerFd = transport->takePeerFd();
+        CHECK(peerFd >= 0);
+        binding = TransportBinding::start(
+            std::move(transport),
+            [this](const uint8_t* data, size_t length) {
+                std::lock_guard<std::mutex> guard(lock);
+                input.append(reinterpret_cast<const char*>(data), length);
+            },
+            [this](int code) { exitCode = code; });
+        CHECK(binding != nullptr);
+    }
+
+    ~Loopback() {
+        binding.reset();
+        if (peerFd >= 0) {
+            close(peerFd);
+        }
+    }
+
+    std::string received() {
+        std::lock_guard<std::mutex> guard(lock);
+        return input;
+    }
+
+    void send(const std::string& data) {
+        CHECK(::write(peerFd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    }
+
+    bool output(const std::string& data) {
+        return binding->write(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    }
+
+    // Reads `length` bytes from the peer; fails if they stop coming
+    std::string readPeer(size_t length) {
+        std::string result;
+        char buffer[64 * 1024];
+        while (result.size() < length) {
+            struct pollfd pfd = {peerFd, POLLIN, 0};
+            CHECK(poll(&pfd, 1, 5000) == 1);
+            ssize_t n = ::read(peerFd, buffer, std::min(sizeof(buffer), length - result.size()));
+            CHECK(n > 0);
+            result.append(buffer, static_cast<size_t>(n));
+        }
+        return result;
+    }
+};
+
+void testRoundTrip() {
+    Loopback loopback;
+    loopback.send("from the peer");
+    CHECK(waitFor([&] { return loopback.received() == "from the peer"; }));
+
+    CHECK(loopback.output("to the peer"));
+    CHECK(loopback.readPeer(11) == "to the peer");
+}
+
+// Output the socket will not take waits in the ring and is written out,
+// in order, once the peer reads again
+void testBacklogDrains() {
+    Loopback loopback;
+
+    std::string expected;
+    for (int i = 0; expected.size() < 4 * 1024 * 1024; i++) {
+        std::string chunk = "chunk " + std::to_string(i) + "\n";
+        CHECK(loopback.output(chunk));
+        expected += chunk;
+    }
+
+    CHECK(loopback.readPeer(expected.size()) == expected);
+
+    // Nothing left queued: new output goes straight through
+    CHECK(loopback.output("after"));
+    CHECK(loopback.readPeer(5) == "after");
+}
+
+void testPeerClose() {
+    Loopback loopback;
+    close(loopback.peerFd);
+    loopback.peerFd = -1;
+
+    CHECK(waitFor([&] { return loopback.binding->closed(); }));
+    CHECK(loopback.exitCode == 0);
+    CHECK(!loopback.output("late"));
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(testRoundTrip);
+    RUN_TEST(testBacklogDrains);
+    RUN_TEST(testPeerClose);
+    return 0;
+}
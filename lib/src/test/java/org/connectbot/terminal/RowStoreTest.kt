@@ -0,0 +1,79 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+import org.junit.Assert.*
+import org.junit.Test
+
+class RowStoreTest {
+    private fun lines(count: Int) = List(count) { TerminalLine.empty(it, 4) }
+
+    @Test
+    fun testSnapshotKeepsRowsAfterLaterWrites() {
+        val store = RowStore(lines(40))
+        val first = store.snapshot()
+        val replaced = TerminalLine.empty(5, 8)
+
+        store[5] = replaced
+
+        assertNotSame(replaced, first[5])
+        assertSame(replaced, store.snapshot()[5])
+    }
+
+    @Test
+    fun testUnchangedRowsAreShared() {
+        val store = RowStore(lines(40))
+        val first = store.snapshot()
+
+        store[33] = TerminalLine.empty(33, 8)
+        val second = store.snapshot()
+
+        for (row in 0 until 40) {
+            if (row != 33) {
+                assertSame(first[row], second[row])
+            }
+        }
+        assertNotSame(first[33], second[33])
+    }
+
+    @Test
+    fun testWritesBetweenSnapshotsAllLand() {
+        val store = RowStore(lines(20))
+        val updated = List(20) { TerminalLine.empty(it, 2) }
+
+        for (row in 0 until 20) {
+            store[row] = updated[row]
+        }
+
+        assertEquals(updated, store.snapshot())
+    }
+
+    @Test
+    fun testSnapshotBehavesAsList() {
+        val initial = lines(17)
+        val snapshot = RowStore(initial).snapshot()
+
+        assertEquals(17, snapshot.size)
+        assertEquals(initial, snapshot)
+        assertEquals(initial.last(), snapshot.last())
+    }
+
+    @Test(expected = IndexOutOfBoundsException::class)
+    fun testSetOutOfRange() {
+        RowStore(lines(3))[3] = TerminalLine.empty(3, 4)
+    }
+}
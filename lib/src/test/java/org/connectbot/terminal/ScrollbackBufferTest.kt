@@ -0,0 +1,168 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+import androidx.compose.ui.graphics.Color
+import org.junit.Assert.*
+import org.junit.Test
+
+class ScrollbackBufferTest {
+    private fun row(text: String, width: Int): List<TerminalLine.Cell> =
+        text.padEnd(width).map { TerminalLine.Cell(char = it, fgColor = Color.White, bgColor = Color.Black) }
+
+    private fun ScrollbackBuffer.pushRow(text: String, width: Int, continuation: Boolean = false) =
+        push(row(text, width), continuation, Color.Black)
+
+    private fun List<TerminalLine>.texts() = map { it.text }
+
+    @Test
+    fun testRowsAtPushedWidth() {
+        val buffer = ScrollbackBuffer(100)
+        buffer.pushRow("abcde", 5)
+        buffer.pushRow("fg", 5, continuation = true)
+        buffer.pushRow("xy", 5)
+
+        assertEquals(listOf("abcde", "fg", "xy"), buffer.snapshot(5).texts())
+    }
+
+    @Test
+    fun testWrappedLinesRewrapAtNewWidth() {
+        val buffer = ScrollbackBuffer(100)
+        buffer.pushRow("abcde", 5)
+        buffer.pushRow("fg", 5, continuation = true)
+        buffer.pushRow("xy", 5)
+
+        assertEquals(listOf("abcdefg", "xy"), buffer.snapshot(10).texts())
+        assertEquals(listOf("abc", "def", "g", "xy"), buffer.snapshot(3).texts())
+    }
+
+    @Test
+    fun testBlankLineKeepsOneRow() {
+        val buffer = ScrollbackBuffer(100)
+        buffer.pushRow("", 5)
+
+        val rows = buffer.snapshot(2)
+        assertEquals(1, rows.size)
+        assertEquals("", rows[0].text)
+    }
+
+    @Test
+    fun testColoredBlanksAreKept() {
+        val buffer = ScrollbackBuffer(100)
+        val cells = row("ab", 2) + List(3) {
+            TerminalLine.Cell(char = ' ', fgColor = Color.White, bgColor = Color.Red)
+        }
+        buffer.push(cells, false, Color.Black)
+
+        assertEquals(listOf("ab   "), buffer.snapshot(5).texts())
+    }
+
+    @Test
+    fun testWideCharacterMovesToNextRow() {
+        val buffer = ScrollbackBuffer(100)
+        val cells = row("ab", 2) + TerminalLine.Cell(char = '\u4E2D', fgColor = Color.White, bgColor = Color.Black, width = 2)
+        buffer.push(cells, false, Color.Black)
+
+        assertEquals(listOf("ab", "\u4E2D"), buffer.snapshot(3).texts())
+    }
+
+    @Test
+    fun testOldestLinesAreDropped() {
+        val buffer = ScrollbackBuffer(2)
+        buffer.pushRow("one", 5)
+        buffer.pushRow("two", 5)
+        buffer.pushRow("three", 5)
+
+        assertEquals(listOf("two", "three"), buffer.snapshot(5).texts())
+    }
+
+    @Test
+    fun testSnapshotIgnoresLaterPushes() {
+        val buffer = ScrollbackBuffer(100)
+        buffer.pushRow("abcde", 5)
+        val snapshot = buffer.snapshot(5)
+
+        buffer.pushRow("fg", 5, continuation = true)
+        buffer.clear()
+
+        assertEquals(listOf("abcde"), snapshot.texts())
+        assertTrue(buffer.snapshot(5).isEmpty())
+    }
+
+    @Test
+    fun testIndexingAcrossBlocks() {
+        val buffer = ScrollbackBuffer(1000)
+        for (i in 0 until 300) {
+            buffer.pushRow("%04d".format(i) + "x", 5)
+            buffer.pushRow("y", 5, continuation = true)
+        }
+
+        val rows = buffer.snapshot(5)
+        assertEquals(600, rows.size)
+        assertEquals("0150x", rows[300].text)
+        assertEquals("y", rows[599].text)
+        assertEquals(300, buffer.snapshot(10).size)
+        assertEquals("0299xy", buffer.snapshot(10)[299].text)
+    }
+
+    @Test
+    fun testLongWrappedRunAcrossSnapshots() {
+        val buffer = ScrollbackBuffer(100)
+        buffer.pushRow("r0000", 5)
+        var snapshot = buffer.snapshot(5)
+        for (i in 1 until 2000) {
+            buffer.pushRow("r%04d".format(i), 5, continuation = true)
+            if (i == 700) {
+                snapshot = buffer.snapshot(5)
+            }
+        }
+
+        // One line, and the snapshot taken midway still ends where it was
+        assertEquals(1, buffer.snapshot(10_000).size)
+        assertEquals(2000, buffer.snapshot(5).size)
+        assertEquals("r1999", buffer.snapshot(5)[1999].text)
+        assertEquals(701, snapshot.size)
+        assertEquals("r0700", snapshot[700].text)
+    }
+
+    @Test
+    fun testCountsKeptAcrossPushesAndEvictions() {
+        val wide = TerminalLine.Cell(char = '\u4E2D', fgColor = Color.White, bgColor = Color.Black, width = 2)
+        fun ScrollbackBuffer.pushLine(i: Int) {
+            if (i % 7 == 0) {
+                push(row("ab", 2) + wide, false, Color.Black)
+            } else {
+                pushRow("%04d".format(i) + "x", 5, continuation = i % 5 == 0)
+            }
+        }
+
+        // One buffer counted as it goes, one only at the end
+        val watched = ScrollbackBuffer(150)
+        val fresh = ScrollbackBuffer(150)
+        for (i in 0 until 500) {
+            watched.pushLine(i)
+            fresh.pushLine(i)
+            if (i % 3 == 0) {
+                watched.snapshot(if (i % 2 == 0) 5 else 3)
+            }
+        }
+
+        for (cols in listOf(3, 5, 10)) {
+            assertEquals(fresh.snapshot(cols).texts(), watched.snapshot(cols).texts())
+        }
+    }
+}
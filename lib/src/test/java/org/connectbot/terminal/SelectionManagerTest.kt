@@ -16,6 +16,7 @@
  */
 package org.connectbot.terminal
 
+import androidx.compose.ui.graphics.Color
 import org.junit.Assert.*
 import org.junit.Before
 import org.junit.Test
@@ -50,6 +51,35 @@ class SelectionManagerTest {
         assertEquals(10, range.endCol)
     }
 
+    @Test
+    fun testSelectRange() {
+        selectionManager.selectRange(2, 75, 3, 4)
+
+        assertEquals(SelectionMode.BLOCK, selectionManager.mode)
+        assertFalse(selectionManager.isSelecting)
+        assertTrue(selectionManager.isCellSelected(2, 79))
+        assertTrue(selectionManager.isCellSelected(3, 4))
+        assertFalse(selectionManager.isCellSelected(3, 5))
+    }
+
+    @Test
+    fun testSelectRangeCopiesWrappedRun() {
+        // A URL soft-wrapped from the end of row 0 onto row 1
+        val snapshot = snapshotOf("see http:/", "/x.org/a b")
+        selectionManager.selectRange(0, 4, 1, 7)
+
+        assertEquals("http://x.org/a", selectionManager.getSelectedText(snapshot))
+    }
+
+    @Test
+    fun testDraggedRangeKeepsLineBreaks() {
+        val snapshot = snapshotOf("see http:/", "/x.org/a b")
+        selectionManager.selectRange(0, 4, 1, 7)
+        selectionManager.updateSelectionEnd(1, 9)
+
+        assertEquals("http:/\n/x.org/a b", selectionManager.getSelectedText(snapshot))
+    }
+
     @Test
     fun testMoveSelectionUpWhileSelecting() {
         selectionManager.startSelection(5, 10, SelectionMode.BLOCK)
@@ -367,4 +397,25 @@ class SelectionManagerTest {
         selectionManager.clearSelection()
         assertEquals(SelectionMode.NONE, selectionManager.mode)
     }
+
+    // One line per string, one cell per character
+    private fun snapshotOf(vararg rows: String): TerminalSnapshot {
+        val lines = rows.mapIndexed { row, text ->
+            TerminalLine(row, text.map { TerminalLine.Cell(char = it, fgColor = Color.White, bgColor = Color.Black) })
+        }
+        return TerminalSnapshot(
+            lines = lines,
+            scrollback = emptyList(),
+            cursorRow = 0,
+            cursorCol = 0,
+            cursorVisible = true,
+            cursorBlink = false,
+            cursorShape = CursorShape.BLOCK,
+            terminalTitle = "",
+            rows = rows.size,
+            cols = rows[0].length,
+            timestamp = 0L,
+            sequenceNumber = 0L
+        )
+    }
 }
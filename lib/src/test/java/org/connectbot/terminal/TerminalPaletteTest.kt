@@ -0,0 +1,77 @@
+/*
+ * ConnectBot Terminal
+ * Copyright 2025 Kenny Root
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.connectbot.terminal
+
+import androidx.compose.ui.graphics.Color
+import org.junit.Assert.*
+import org.junit.Test
+
+class TerminalPaletteTest {
+    private fun buildPalette(defaultFg: Color, defaultBg: Color): TerminalPalette {
+        val argb = IntArray(TerminalPalette.SIZE) { 0xFF000000.toInt() or it }
+        argb[TerminalPalette.DEFAULT_FG] = defaultFg.toArgbInt()
+        argb[TerminalPalette.DEFAULT_BG] = defaultBg.toArgbInt()
+        return TerminalPalette.fromArgb(argb)
+    }
+
+    private fun Color.toArgbInt(): Int =
+        (0xFF shl 24) or ((red * 255).toInt() shl 16) or ((green * 255).toInt() shl 8) or (blue * 255).toInt()
+
+    @Test
+    fun testEmptyPaletteUsesDirectColor() {
+        assertEquals(Color.Red, TerminalPalette.EMPTY.resolve(1, Color.Red))
+        assertEquals(Color.Red, TerminalPalette.EMPTY.resolve(TerminalPalette.DEFAULT_FG, Color.Red))
+    }
+
+    @Test
+    fun testDirectColorIgnoresPalette() {
+        val palette = buildPalette(Color.White, Color.Black)
+        assertEquals(Color.Red, palette.resolve(TerminalPalette.DIRECT, Color.Red))
+    }
+
+    @Test
+    fun testIndexedAndDefaultSlotsResolveThroughPalette() {
+        val palette = buildPalette(Color.White, Color.Black)
+        assertEquals(Color(0xFF000005.toInt()), palette.resolve(5, Color.Red))
+        assertEquals(Color.White, palette.resolve(TerminalPalette.DEFAULT_FG, Color.Red))
+        assertEquals(Color.Black, palette.resolve(TerminalPalette.DEFAULT_BG, Color.Red))
+    }
+
+    @Test
+    fun testThemeSwitchNeedsOnlyNewPalette() {
+        val cell = TerminalLine.Cell(
+            char = 'A',
+            fgColor = Color.White,
+            bgColor = Color.Black,
+            fgIndex = TerminalPalette.DEFAULT_FG,
+            bgIndex = TerminalPalette.DEFAULT_BG
+        )
+
+        val light = buildPalette(Color.Black, Color.White)
+        assertEquals(Color.Black, light.resolve(cell.fgIndex, cell.fgColor))
+        assertEquals(Color.White, light.resolve(cell.bgIndex, cell.bgColor))
+    }
+
+    @Test
+    fun testEmptyLineFollowsDefaultSlots() {
+        val line = TerminalLine.empty(0, 4)
+        line.cells.forEach { cell ->
+            assertEquals(TerminalPalette.DEFAULT_FG, cell.fgIndex)
+            assertEquals(TerminalPalette.DEFAULT_BG, cell.bgIndex)
+        }
+    }
+}